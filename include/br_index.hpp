@@ -10,98 +10,200 @@
 #include "rle_string.hpp"
 #include "sparse_sd_vector.hpp"
 #include "permuted_lcp.hpp"
+#include "move_structure.hpp"
+#include "lcp_psv.hpp"
+#include "qgram_table.hpp"
+#include "ms_thresholds.hpp"
 
 namespace bri {
 
+template<class task_t> class work_stealing_pool;
+
 class br_index {
     
 public:
     using triple = std::tuple<range_t, ulint, ulint>;
     using sparse_bitvector_t = sparse_sd_vector;
+#ifdef BRI_RUN_DIRECTORY
+    using rle_string_t = rle_string<sparse_bitvector_t, huffman_string, true>;
+#else
     using rle_string_t = rle_string<>;
+#endif
 
     friend class br_index_builder;
 
+    /*
+     * load profiles: which components load() reads
+     * queries needing a component outside the profile exit with an error
+     */
+    enum load_profile : uchar {
+        LOAD_COUNT,         // count(P): bwtR
+        LOAD_LOCATE,        // count(P), search, locate & right_extension: + SA samples, Phi/PhiI
+        LOAD_BIDIRECTIONAL, // + bwt: left_extension too (no contractions)
+        LOAD_FULL           // everything: contractions, MEMs, suffix tree operations
+    };
+
+
+    /*
+     * lazy enumeration of the occurrences of a sample:
+     * the toehold, then the Phi chain, then the PhiI chain (same order as locate_sample)
+     * keeps a pointer to the index, which must outlive the cursor
+     */
+    class locate_cursor {
+    public:
+        locate_cursor() {}
+        locate_cursor(br_index const* idx, br_sample const& sample);
+        locate_cursor(br_index const* idx, ulint sa, ulint len); // from a toehold SA[i] of a pattern of length len
+
+        bool next(ulint& occ); // false if exhausted
+        ulint next(std::vector<ulint>& out, ulint n); // append at most n occurrences, return #appended
+        inline bool done() const { return state == DONE; }
+        inline ulint reported() const { return cnt; }
+
+    private:
+        enum : uchar { TOEHOLD, PHI, PHII, DONE };
+
+        br_index const* idx = nullptr;
+        ulint len = 0;
+        ulint sa = 0; // toehold
+        ulint pos = 0;
+        ulint t = 0; // interval of pos in the move structure
+        ulint cnt = 0;
+        uchar state = DONE;
+    };
 
     br_index() {}
     br_index(std::string const& input, ulint length=8, bool sais = true);
 
-    range_t full_range();
-    ulint LF(ulint i);
-    range_t LF(range_t rn, uchar c); // c: remapped char
-    ulint LFR(ulint i);
-    range_t LFR(range_t rn, uchar c); // c: remapped char
-    ulint FL(ulint i);
-    ulint FLR(ulint i);
-    ulint Phi(ulint i);
-    ulint PhiR(ulint i);
-    ulint PhiI(ulint i);
-    ulint PhiIR(ulint i);
-
-    uchar F_at(ulint i);
-    range_t get_char_range(uchar c); // c: remapped char
+    range_t full_range() const;
+    ulint LF(ulint i) const;
+    range_t LF(range_t rn, uchar c) const; // c: remapped char
+    ulint LFR(ulint i) const;
+    range_t LFR(range_t rn, uchar c) const; // c: remapped char
+    ulint FL(ulint i) const;
+    ulint FLR(ulint i) const;
+    ulint Phi(ulint i) const;
+    ulint PhiR(ulint i) const;
+    ulint PhiI(ulint i) const;
+    ulint PhiIR(ulint i) const;
+
+    // Phi/PhiI backend: move structures (built here if absent) or predecessor search
+    void use_move_structures(bool use);
+    inline bool has_move_structures() const { return phi_move.size() > 0; }
+
+    // contractions beyond bl: LCP (LCPR) smaller value samples, built here if absent
+    // block: LCP positions per block, 0: n/r (O(r) words)
+    void use_lcp_psv(bool use, ulint block = 0);
+    inline bool has_lcp_psv() const { return psv.size() > 0; }
+
+    // search, count & locate start at depth q from a table of the q-gram samples
+    // q = 0 drops the table
+    void use_qgram_table(ulint q);
+    inline ulint qgram_length() const { return qgrams.length(); }
+
+    // matching statistics thresholds (MONI) and the LCP smaller values they need, built here if absent
+    void use_ms_thresholds(bool use);
+    inline bool has_ms_thresholds() const { return thresholds.size() > 0; }
+
+    uchar F_at(ulint i) const;
+    range_t get_char_range(uchar c) const; // c: remapped char
+    ulint count_smaller(range_t rn, uchar c, bool reversed=false) const; // c: remapped char
 
 
     // search initialization
-    br_sample get_initial_sample();
-    inline br_sample get_invalid_sample();
+    br_sample get_initial_sample() const;
+    inline br_sample get_invalid_sample() const;
     inline bool is_invalid(br_sample const& sample) const { return sample.is_invalid(); }
 
 
     // br-index functionality
-    br_sample left_extension(br_sample const& prev_sample, uchar c);
-    br_sample right_extension(br_sample const& prev_sample, uchar c);
-    br_sample left_contraction(br_sample const& prev_sample);
-    br_sample right_contraction(br_sample const& prev_sample);
-
-    br_sample search(std::string const& pattern);
-    ulint count_sample(br_sample const& sample);
-    ulint count_samples(std::unordered_map<range_t,br_sample,range_hash> const& samples);
-    std::vector<ulint> locate_sample(br_sample const& sample);
-    std::vector<ulint> locate_samples(std::vector<br_sample> const& samples);
-    std::vector<ulint> locate_samples(std::unordered_map<range_t,br_sample,range_hash> const& samples);
-
-    ulint count(std::string const& pattern); // count(P)
-    std::vector<ulint> locate(std::string const& pattern); // locate(P)
-    ulint maximal_exact_match(std::string const& pattern); // MEMs
-    ulint full_task(ulint k, ulint t); // #substrings with length<=k & frequency>=t
+    br_sample left_extension(br_sample const& prev_sample, uchar c) const;
+    br_sample right_extension(br_sample const& prev_sample, uchar c) const;
+    br_sample left_contraction(br_sample const& prev_sample) const;
+    br_sample right_contraction(br_sample const& prev_sample) const;
+
+    // all non-empty extensions <a, aP> / <a, Pa> at once, in increasing order of a
+    // toehold=false skips updating j & d (enough for counting)
+    std::vector<std::pair<uchar,br_sample> > left_extensions(br_sample const& prev_sample, bool toehold=true) const;
+    std::vector<std::pair<uchar,br_sample> > right_extensions(br_sample const& prev_sample, bool toehold=true) const;
+
+    br_sample search(std::string const& pattern) const;
+    // backward search on BWT^R keeping only what locate needs:
+    // returns #occ and sets sa to one of them (the toehold), no SA range
+    ulint search_toehold(std::string const& pattern, ulint& sa) const;
+    ulint count_sample(br_sample const& sample) const;
+    ulint count_samples(std::unordered_map<range_t,br_sample,range_hash> const& samples) const;
+    std::vector<ulint> locate_sample(br_sample const& sample) const;
+    std::vector<ulint> locate_samples(std::vector<br_sample> const& samples) const;
+    std::vector<ulint> locate_samples(std::unordered_map<range_t,br_sample,range_hash> const& samples) const;
+
+    // streaming locate: visit(occ) is called per occurrence until it returns false
+    // return the number of visited occurrences
+    locate_cursor get_locate_cursor(br_sample const& sample) const { return locate_cursor(this, sample); }
+    template<class visitor_t>
+    ulint locate_sample(br_sample const& sample, visitor_t&& visit) const;
+
+    // occurrences in SA order: the SA range is split at BWT run boundaries (SA values known
+    // from the run samples) into segments located by a pool of threads, interleaved in each
+    std::vector<ulint> locate_sample_sa_order(br_sample const& sample, ulint threads = 1) const;
+
+    ulint count(std::string const& pattern) const; // count(P)
+    std::vector<ulint> locate(std::string const& pattern) const; // locate(P)
+    template<class visitor_t>
+    ulint locate(std::string const& pattern, visitor_t&& visit) const; // streaming locate(P)
+    std::vector<ulint> locate_sa_order(std::string const& pattern, ulint threads = 1) const; // locate(P) in SA order
+    // count(P) & locate(P) of many patterns, group searches (Phi/PhiI chains) advance in lockstep,
+    // prefetching what their next step reads, so that the cache misses of a thread overlap
+    std::vector<ulint> count_batch(std::vector<std::string> const& patterns, ulint group = 16) const;
+    std::vector<std::vector<ulint> > locate_batch(std::vector<std::string> const& patterns, ulint group = 16) const;
+    ulint maximal_exact_match(std::string const& pattern) const; // MEMs
+    template<class visitor_t>
+    ulint sliding_window(std::string const& query, ulint k, visitor_t&& visit) const; // k-mers of the query
+    template<class visitor_t>
+    ulint maximal_exact_matches(std::string const& pattern, ulint min_len, ulint min_occ, visitor_t&& visit) const; // streaming MEMs
+    ulint full_task(ulint k, ulint t, ulint threads = 1) const; // #substrings with length<=k & frequency>=t
+    // matching statistics: P[i,i+lengths[i]) is the longest prefix of P[i,m) occurring in the text,
+    // at text position pointers[i] (0 if lengths[i] = 0); one backward pass with the thresholds
+    void matching_statistics(std::string const& pattern, std::vector<ulint>& lengths, std::vector<ulint>& pointers) const;
 
     // suffix tree operations
-    inline br_sample root() { return get_initial_sample(); }
-    br_sample parent(br_sample const& sample);
-    br_sample child(br_sample const& sample, uchar c);
-    br_sample slink(br_sample const& sample);
-    br_sample wlink(br_sample const& sample, uchar c);
-    br_sample lca(br_sample const& left, br_sample const& right);
-    ulint sdepth(br_sample const& sample);
-    br_sample fchild(br_sample const& sample);
-    br_sample nsibling(br_sample const& sample);
-    std::vector<br_sample> children(br_sample const& sample);
-    std::vector<uchar> child_chars(br_sample const& sample);
-    uchar letter(br_sample const& sample, ulint i);
-    std::string label(br_sample const& sample);
+    inline br_sample root() const { return get_initial_sample(); }
+    br_sample parent(br_sample const& sample) const;
+    br_sample child(br_sample const& sample, uchar c) const;
+    br_sample slink(br_sample const& sample) const;
+    br_sample wlink(br_sample const& sample, uchar c) const;
+    br_sample lca(br_sample const& left, br_sample const& right) const;
+    ulint sdepth(br_sample const& sample) const;
+    br_sample fchild(br_sample const& sample) const;
+    br_sample nsibling(br_sample const& sample) const;
+    std::vector<br_sample> children(br_sample const& sample) const;
+    std::vector<uchar> child_chars(br_sample const& sample) const;
+    uchar letter(br_sample const& sample, ulint i) const;
+    std::string label(br_sample const& sample) const;
     bool ancestor(br_sample const& v, br_sample const& w) const { return v.contains(w); }
     inline bool is_leaf(br_sample const& sample) const { return sample.is_leaf(); }
 
 
     // I/O
-    ulint serialize(std::ostream& out);
+    ulint serialize(std::ostream& out) const;
     void load(std::istream& in);
     void load(std::istream& in, ulint bl);
-    void save_to_file(std::string const& path_prefix);
+    void load(std::istream& in, load_profile profile, int bl = -1); // bl = -1: index file's bl
+    void save_to_file(std::string const& path_prefix) const;
     void load_from_file(std::string const& path);
-    ulint print_space(ulint fix);
-    ulint print_space() { return print_space(length); }
-    ulint get_space();
+    ulint print_space(ulint fix) const;
+    ulint print_space() const { return print_space(length); }
+    ulint get_space() const;
 
 
     // stats
-    inline ulint text_size() { return bwt.size()-1; }
-    inline ulint bwt_size() { return bwt.size(); }
-    inline ulint border_length() { return length; }
-    ulint number_of_runs(bool reversed=false) { return reversed ? bwtR.number_of_runs() : bwt.number_of_runs(); } // get the number of runs in the BWT
-    uchar bwt_at(ulint i, bool reversed=false) { return reversed ? remap_inv[bwtR[i]] : remap_inv[bwt[i]]; }
-    std::string get_bwt(bool reversed=false);
+    inline ulint text_size() const { return n-1; }
+    inline ulint bwt_size() const { return n; }
+    inline ulint border_length() const { return length; }
+    inline ulint alphabet_size() const { return sigma; }
+    ulint number_of_runs(bool reversed=false) const { return reversed ? bwtR.number_of_runs() : bwt.number_of_runs(); } // get the number of runs in the BWT
+    uchar bwt_at(ulint i, bool reversed=false) const { return reversed ? remap_inv[bwtR[i]] : remap_inv[bwt[i]]; }
+    std::string get_bwt(bool reversed=false) const;
     
 
 
@@ -109,7 +211,80 @@ private:
     std::tuple<std::string, std::vector<range_t>, std::vector<range_t> > 
     sufsort(sdsl::int_vector<8>& text, sdsl::int_vector_buffer<>& sa);
 
-    ulint _full_task_dfs(ulint k, ulint t, br_sample const& sample);
+    void build_plcp_samples();
+
+    // sections of the index file, ids in the section table
+    // kmer[k] & kmerR[k] are sections SEC_KMER+2k & SEC_KMER+2k+1
+    enum : ulint {
+        SEC_HEADER, SEC_BWT, SEC_BWTR,
+        SEC_SAMPLES_FIRST, SEC_SAMPLES_LAST, SEC_FIRST, SEC_FIRST_TO_RUN, SEC_LAST, SEC_LAST_TO_RUN,
+        SEC_SAMPLES_FIRSTR, SEC_SAMPLES_LASTR, SEC_FIRSTR, SEC_FIRST_TO_RUNR, SEC_LASTR, SEC_LAST_TO_RUNR,
+        SEC_PLCP, SEC_PLCPR,
+        SEC_PHI_MOVE, SEC_PHII_MOVE,
+        SEC_FIRST_PLCP, SEC_LAST_PLCP, SEC_FIRSTR_PLCP, SEC_LASTR_PLCP, SEC_PHI_MOVE_PLCP, SEC_PHII_MOVE_PLCP,
+        SEC_LCP_PSV, SEC_LCP_PSVR,
+        SEC_QGRAM,
+        SEC_MS_THRESHOLDS,
+        SEC_KMER
+    };
+
+    // sets of sections as bitmasks, bit SEC_KMER (SEC_KMER+1) stands for all kmer (kmerR) levels
+    static constexpr ulint section_bit(ulint sec) { return ulint(1) << sec; }
+    static ulint profile_sections(load_profile profile);
+
+    // sections read by the Phi/PhiI (PhiR/PhiIR) chains
+    static const ulint PHI_SECTIONS;
+    static const ulint PHIR_SECTIONS;
+
+    // magic number closing the section table
+    static const ulint SECTION_TABLE_MAGIC = 0x4c42545345495242; // "BRIESTBL"
+
+    std::vector<ulint> read_section_table(std::istream& in);
+    ulint load_header(std::istream& in, int bl);
+    void load_sequential(std::istream& in, ulint file_length);
+    void release_sections(ulint sections);
+
+    // exit with an error if op needs sections that were not loaded
+    inline void require(ulint sections, const char* op) const
+    {
+        if ((loaded_sections & sections) != sections) missing_sections(op);
+    }
+    void missing_sections(const char* op) const;
+
+    // one step of the Phi (PhiI) chain of locate & left_contraction:
+    // if plcp[i] >= len (plcp[PhiI(i)] >= len), i moves to Phi(i) (PhiI(i)) and true is returned
+    // t: interval of i in phi_move (phiI_move), used only with move structures
+    bool phi_step(ulint& i, ulint& t, ulint len) const;
+    bool phiI_step(ulint& i, ulint& t, ulint len) const;
+    // same for PhiR (PhiIR) and plcpR in right_contraction
+    bool phiR_step(ulint& i, ulint len) const;
+    bool phiIR_step(ulint& i, ulint len) const;
+
+    // contractions beyond bl: widen SA (SAR) range boundaries while LCP >= len
+    // pos: SA[first] (SA[second]), psv/psvR skip the blocks in between if built
+    ulint widen_first(ulint first, ulint pos, ulint len, bool reversed) const;
+    ulint widen_second(ulint second, ulint pos, ulint len, bool reversed) const;
+
+    // suffix tree navigation with psv/psvR (has_lcp_psv()):
+    // SA[i] (SAR[i]) by Phi (PhiR) from the SA sample at the end of the block of i
+    ulint sa_at(ulint i, bool reversed) const;
+    // min LCP[lo..hi]
+    ulint lcp_min(ulint lo, ulint hi) const;
+    // ancestor of the sample with string depth len (the result of |P|-len right contractions)
+    br_sample contract_to(br_sample const& sample, ulint len) const;
+
+    // toehold SA[i] of a pattern whose last narrowing search step extended P[0,len) (SAR range prevR) with c
+    ulint toehold_of(range_t prevR, uchar c, ulint len) const;
+    // backward searches on BWT^R of count_batch & locate_batch: #occ (and toeholds if not null) of each pattern
+    void search_batch(std::vector<std::string> const& patterns, ulint group, std::vector<ulint>& counts, std::vector<ulint>* toeholds) const;
+
+    // sample of the first q characters of the pattern from the q-gram table
+    // false if there is no table or the pattern is shorter than q
+    bool qgram_prefix(std::string const& pattern, br_sample& sample) const;
+
+    // full-task below a counted sample, hands shallow stack entries to the idle workers of pool (if any)
+    ulint _full_task_dfs(ulint k, ulint t, br_sample const& sample, work_stealing_pool<br_sample>* pool = nullptr, ulint worker = 0) const;
+    br_sample descend_edge(br_sample sample) const;
 
     static const uchar TERMINATOR = 1;
     
@@ -121,6 +296,9 @@ private:
     // accumulated number of characters in lex order
     std::vector<ulint> F;
     
+    // BWT length (text length + 1)
+    ulint n = 0;
+
     // RLBWT
     rle_string_t bwt;
     ulint last_SA_val = 0;
@@ -142,6 +320,10 @@ private:
     sparse_bitvector_t last;
     sdsl::int_vector<> last_to_run;
 
+    // Phi & PhiI as move structures (optional)
+    move_structure phi_move;
+    move_structure phiI_move;
+
     // right_extension
     sdsl::int_vector<> samples_firstR;
     sdsl::int_vector<> samples_lastR;
@@ -160,9 +342,32 @@ private:
     // right_contraction
     permuted_lcp<> plcpR;
 
+    // plcp[i] (plcp[PhiI(i)]) decreases by one along each Phi (PhiI) interval,
+    // so one PLCP value per interval replaces the rank & select of plcp[]
+    // intervals: (first[jr], first[jr+1]] and so on, or those of the move structures
+    sdsl::int_vector<> first_plcp;
+    sdsl::int_vector<> last_plcp;
+    sdsl::int_vector<> firstR_plcp;
+    sdsl::int_vector<> lastR_plcp;
+    sdsl::int_vector<> phi_move_plcp;
+    sdsl::int_vector<> phiI_move_plcp;
+
+    // previous/next smaller values of LCP (LCPR) for contractions beyond bl (optional)
+    lcp_psv psv;
+    lcp_psv psvR;
+
+    // samples of the occurring q-grams (optional)
+    qgram_table qgrams;
+
+    // thresholds of the BWT runs for matching statistics (optional)
+    ms_thresholds thresholds;
+
     // fixed length (parameter bl)
     ulint length;
 
+    // sections present in memory (all of them unless loaded with a profile)
+    ulint loaded_sections = ~ulint(0);
+
     // left_contraction shorcut for |P|<=bl+1
     std::vector<sparse_bitvector_t> kmer;
 
@@ -171,6 +376,133 @@ private:
 
 };
 
+inline br_sample br_index::get_invalid_sample() const
+{
+        return br_sample({1,0},   // empty SA range
+                    {1,0},        // empty SAR range
+                    0,            // arbitrary sample
+                    0,            // offset 0
+                    0);           // null pattern
+}
+
+template<class visitor_t>
+ulint br_index::locate_sample(br_sample const& sample, visitor_t&& visit) const
+{
+    locate_cursor cursor(this, sample);
+    ulint occ;
+    while (cursor.next(occ))
+    {
+        if (!visit(occ)) break;
+    }
+    return cursor.reported();
+}
+
+template<class visitor_t>
+ulint br_index::locate(std::string const& pattern, visitor_t&& visit) const
+{
+    ulint sa;
+    if (search_toehold(pattern, sa) == 0) return 0;
+
+    locate_cursor cursor(this, sa, pattern.size());
+    ulint occ;
+    while (cursor.next(occ))
+    {
+        if (!visit(occ)) break;
+    }
+    return cursor.reported();
+}
+
+/*
+ * maximal exact matches: P[i,j) occurring >= min_occ times in the text while
+ * P[i-1,j) and P[i,j+1) do not (j-i is the longest such match starting at i).
+ * No two of them nest, so they are also the super-maximal ones (SMEMs).
+ * visit(i, sample) is called by increasing i for those of length >= min_len;
+ * sample.len is the length, count_sample & locate_sample give the occurrences.
+ * returns the number of visited MEMs
+ */
+template<class visitor_t>
+ulint br_index::maximal_exact_matches(std::string const& pattern, ulint min_len, ulint min_occ, visitor_t&& visit) const
+{
+    ulint m = pattern.size();
+    ulint j = 0, reported = 0;
+    bool extended = false;
+    if (min_occ == 0) min_occ = 1;
+
+    br_sample init(get_initial_sample());
+    br_sample sample(init);
+
+    for (ulint i = 0; i < m; ++i)
+    {
+        while (j < m)
+        {
+            br_sample new_sample = right_extension(sample, (uchar)pattern[j]);
+            if (new_sample.is_invalid() || count_sample(new_sample) < min_occ) break;
+            extended = true;
+            sample = new_sample;
+            j++;
+        }
+        // j moved, so P[i-1,j) is not frequent enough
+        if (extended && sample.len >= min_len)
+        {
+            visit(i, static_cast<br_sample const&>(sample));
+            reported++;
+        }
+
+        if (i == j)
+        {
+            sample = init;
+            j++;
+        }
+        else sample = left_contraction(sample);
+        extended = false;
+    }
+    return reported;
+}
+
+/*
+ * all the length-k windows Q[i,i+k) of the query, sliding to the right with
+ * left_contraction & right_extension (the kmer shortcut for k <= bl+1)
+ * instead of searching each one; a mismatch contracts until the next
+ * character extends the window's longest occurring suffix again.
+ * visit(i, count, sample) is called by increasing i, with the invalid
+ * sample if count = 0; the sample gives a toehold (locate_cursor)
+ * returns the number of windows occurring in the text
+ */
+template<class visitor_t>
+ulint br_index::sliding_window(std::string const& query, ulint k, visitor_t&& visit) const
+{
+    ulint m = query.size();
+    if (k == 0 || k > m) return 0;
+
+    br_sample init(get_initial_sample());
+    br_sample invalid(get_invalid_sample());
+    // longest occurring suffix of Q[0,j) of length <= k
+    br_sample sample(init);
+    ulint found = 0;
+
+    for (ulint j = 0; j < m; ++j)
+    {
+        if (sample.len == k) sample = left_contraction(sample);
+
+        br_sample ext = right_extension(sample, (uchar)query[j]);
+        while (ext.is_invalid() && sample.len > 0)
+        {
+            sample = sample.len == 1 ? init : left_contraction(sample);
+            ext = right_extension(sample, (uchar)query[j]);
+        }
+        sample = ext.is_invalid() ? init : ext;
+
+        if (j + 1 < k) continue;
+        if (sample.len == k)
+        {
+            visit(j + 1 - k, count_sample(sample), static_cast<br_sample const&>(sample));
+            found++;
+        }
+        else visit(j + 1 - k, (ulint)0, static_cast<br_sample const&>(invalid));
+    }
+    return found;
+}
+
 }; // namespace bri
 
 #endif // INCLUDED_BR_INDEX_FULL_HPP
\ No newline at end of file
@@ -99,12 +99,25 @@ struct br_sample {
     
 };
 
+/*
+ * prefetch the word holding v[i] of a bit-packed int_vector
+ * a hint for interleaved queries, no effect on the results
+ */
+template<class int_vector_t>
+inline void prefetch_entry(int_vector_t const& v, ulint i)
+{
+    __builtin_prefetch(v.data() + ((i * v.width()) >> 6));
+}
+
 std::string get_time(ulint time);
 uchar bitsize(ulint x);
 void header_error();
 ulint get_number_of_patterns(std::string header);
 ulint get_patterns_length(std::string header);
 
+// read a pattern file of the given format: lines, fasta, fastq, pizza (Pizza&Chili) or auto
+std::vector<std::string> read_patterns(std::string const& path, std::string format = "auto");
+
 };
 
 #endif /* INCLUDED_DEFINITIONS_HPP */
\ No newline at end of file
@@ -21,7 +21,7 @@ public:
      */
     huffman_string(std::string& s);
 
-    inline uchar operator[](size_t i) 
+    inline uchar operator[](size_t i) const 
     {
         assert(i<wt.size());
         return wt[i];
@@ -30,12 +30,12 @@ public:
     /*
      * length of the string
      */
-    inline size_t size() { return wt.size(); }
+    inline size_t size() const { return wt.size(); }
 
     /*
      * number of character c in S[0...i-1]
      */
-    inline ulint rank(size_t i, uchar c) {
+    inline ulint rank(size_t i, uchar c) const {
         assert(i<=wt.size());
         return wt.rank(i,c);
     }
@@ -44,14 +44,33 @@ public:
      * position of i-th character c
      * i starts from 0
      */
-    inline ulint select(ulint i, uchar c) {
+    inline ulint select(ulint i, uchar c) const {
         return wt.select(i+1,c);
     }
 
+    /*
+     * distinct characters in S[i...j-1] in one traversal of the wavelet tree
+     * k: number of distinct characters found
+     * cs[t]: t-th character, rank_c_i[t]/rank_c_j[t]: its ranks at i and j
+     * the vectors must have at least sigma() entries
+     */
+    inline void interval_symbols(size_t i, size_t j, ulint& k,
+                                 std::vector<uchar>& cs,
+                                 std::vector<ulint>& rank_c_i,
+                                 std::vector<ulint>& rank_c_j) const {
+        assert(i<=j && j<=wt.size());
+        wt.interval_symbols(i,j,k,cs,rank_c_i,rank_c_j);
+    }
+
+    /*
+     * number of distinct characters in the string
+     */
+    inline ulint sigma() const { return wt.sigma; }
+
     /*
      * serialize the index to the ostream
      */
-    inline ulint serialize(std::ostream& out) {
+    inline ulint serialize(std::ostream& out) const {
         return wt.serialize(out);
     }
 
@@ -0,0 +1,207 @@
+/*
+ * lcp_psv: previous/next smaller value queries over an LCP array (SA order)
+ * in O(n/b) words, used by the contractions beyond bl.
+ *
+ * The LCP array is cut into blocks of b positions. Each block keeps its
+ * minimum and the SA value at its last position; a complete binary tree
+ * over the block minima finds the nearest block holding a value < len in
+ * O(log(n/b)). Only the boundary blocks are scanned (with Phi or PhiI),
+ * so a contraction costs O(b + log(n/b)) steps instead of O(occ).
+ *
+ * With b = n/r the structure takes O(r) words.
+ */
+
+#ifndef INCLUDED_LCP_PSV_HPP
+#define INCLUDED_LCP_PSV_HPP
+
+#include "definitions.hpp"
+
+namespace bri {
+
+class lcp_psv {
+
+public:
+    lcp_psv() {}
+
+    /*
+     * constructor
+     * \param n length of the LCP array
+     * \param b block size
+     * \param block_min minimum LCP value of each block
+     * \param last_sa SA value at the last position of each block
+     */
+    lcp_psv(ulint n, ulint b, std::vector<ulint> const& block_min, std::vector<ulint> const& last_sa)
+    {
+        assert(b >= 1);
+        assert(block_min.size() == (n + b - 1) / b);
+        assert(last_sa.size() == block_min.size());
+
+        this->n = n;
+        this->b = b;
+
+        ulint m = block_min.size();
+        leaves = 1;
+        while (leaves < m) leaves *= 2;
+
+        // padding leaves hold n, larger than any LCP value
+        uchar log_n = bitsize(n);
+        tree = sdsl::int_vector<>(2*leaves,n,log_n);
+        for (ulint B = 0; B < m; ++B) tree[leaves+B] = block_min[B];
+        for (ulint v = leaves-1; v > 0; --v)
+            tree[v] = std::min<ulint>(tree[2*v],tree[2*v+1]);
+
+        this->last_sa = sdsl::int_vector<>(m,0,log_n);
+        for (ulint B = 0; B < m; ++B) this->last_sa[B] = last_sa[B];
+    }
+
+    inline ulint size() const { return n; }
+
+    inline ulint block_size() const { return b; }
+
+    inline ulint number_of_blocks() const { return last_sa.size(); }
+
+    // SA value at the last position of block B
+    inline ulint last_sa_of(ulint B) const { return last_sa[B]; }
+
+    /*
+     * nearest block B' < B holding an LCP value < len
+     * returns false if there is none
+     */
+    bool prev_smaller_block(ulint B, ulint len, ulint& res) const
+    {
+        ulint v = leaves + B;
+        while (v > 1)
+        {
+            // the left sibling covers the blocks right before v's
+            if ((v & 1) && tree[v-1] < len)
+            {
+                v--;
+                while (v < leaves) v = tree[2*v+1] < len ? 2*v+1 : 2*v;
+                res = v - leaves;
+                return true;
+            }
+            v /= 2;
+        }
+        return false;
+    }
+
+    /*
+     * nearest block B' > B holding an LCP value < len
+     * returns false if there is none
+     */
+    bool next_smaller_block(ulint B, ulint len, ulint& res) const
+    {
+        ulint v = leaves + B;
+        while (v > 1)
+        {
+            // the right sibling covers the blocks right after v's
+            if (!(v & 1) && tree[v+1] < len)
+            {
+                v++;
+                while (v < leaves) v = tree[2*v] < len ? 2*v : 2*v+1;
+                res = v - leaves;
+                return true;
+            }
+            v /= 2;
+        }
+        return false;
+    }
+
+    /*
+     * minimum LCP value of the blocks B1..B2
+     */
+    ulint min_of_blocks(ulint B1, ulint B2) const
+    {
+        assert(B1 <= B2 && B2 < number_of_blocks());
+
+        ulint res = n;
+        ulint lo = leaves + B1, hi = leaves + B2 + 1;
+        while (lo < hi)
+        {
+            if (lo & 1) res = std::min<ulint>(res, tree[lo++]);
+            if (hi & 1) res = std::min<ulint>(res, tree[--hi]);
+            lo /= 2;
+            hi /= 2;
+        }
+        return res;
+    }
+
+    ulint serialize(std::ostream& out) const
+    {
+        ulint w_bytes = 0;
+
+        out.write((char*)&n,sizeof(n));
+        w_bytes += sizeof(n);
+
+        if (n == 0) return w_bytes;
+
+        out.write((char*)&b,sizeof(b));
+        out.write((char*)&leaves,sizeof(leaves));
+        w_bytes += sizeof(b) + sizeof(leaves);
+
+        w_bytes += tree.serialize(out);
+        w_bytes += last_sa.serialize(out);
+
+        return w_bytes;
+    }
+
+    /*
+     * an exhausted stream leaves the structure empty
+     */
+    void load(std::istream& in)
+    {
+        n = 0;
+        in.read((char*)&n,sizeof(n));
+
+        if (in.gcount() != sizeof(n))
+        {
+            n = 0;
+            in.clear();
+            return;
+        }
+
+        if (n == 0) return;
+
+        in.read((char*)&b,sizeof(b));
+        in.read((char*)&leaves,sizeof(leaves));
+
+        tree.load(in);
+        last_sa.load(in);
+    }
+
+    ulint get_space() const
+    {
+        ulint tot_bytes = 0;
+
+        if (n == 0) return tot_bytes;
+
+        std::ofstream out("/dev/null");
+
+        tot_bytes += tree.serialize(out);
+        tot_bytes += last_sa.serialize(out);
+
+        return tot_bytes;
+    }
+
+private:
+
+    // length of the LCP array
+    ulint n = 0;
+
+    // block size
+    ulint b = 1;
+
+    // number of leaves of the tree (power of two >= #blocks)
+    ulint leaves = 0;
+
+    // min-tree over the block minima, node v has children 2v & 2v+1, leaves from index leaves
+    sdsl::int_vector<> tree;
+
+    // SA value at the last position of each block
+    sdsl::int_vector<> last_sa;
+
+};
+
+};
+
+#endif /* INCLUDED_LCP_PSV_HPP */
@@ -0,0 +1,302 @@
+/*
+ * move_structure: run-length representation of a permutation f on [0,n)
+ * which is piecewise linear (f(i+1) = f(i)+1 inside each input interval).
+ *
+ * Each input interval t = [starts[t], starts[t+1]) is stored with the image
+ * of its first position and the index of the input interval containing that
+ * image. Applying f to a pair <i, t> (position, interval of i) is a table
+ * lookup plus a forward scan over the following input intervals.
+ *
+ * Intervals are split during construction so that no output interval
+ * overlaps 2*d or more input intervals, which bounds the forward scan.
+ *
+ * From the paper
+ *
+ * Takaaki Nishimoto and Yasuo Tabei. Optimal-Time Queries on BWT-runs
+ * Compressed Indexes. ICALP 2021.
+ */
+
+#ifndef INCLUDED_MOVE_STRUCTURE_HPP
+#define INCLUDED_MOVE_STRUCTURE_HPP
+
+#include <map>
+
+#include "definitions.hpp"
+
+namespace bri {
+
+class move_structure {
+
+public:
+    move_structure() {}
+
+    /*
+     * constructor
+     * \param n domain size
+     * \param intervals <start, image of start> of every input interval,
+     *        sorted by start, the first start must be 0
+     * \param d balancing parameter
+     */
+    move_structure(ulint n, std::vector<range_t> const& intervals, ulint d = 4)
+    {
+        assert(intervals.size() > 0 && intervals[0].first == 0);
+        assert(d >= 1);
+
+        this->n = n;
+
+        // input start -> image of the start
+        std::map<ulint,ulint> in_map;
+        // image of the start -> input start
+        std::map<ulint,ulint> out_map;
+
+        for (ulint t = 0; t < intervals.size(); ++t)
+        {
+            ulint s = intervals[t].first;
+            ulint q = intervals[t].second % n;
+            ulint e = t+1 < intervals.size() ? intervals[t+1].first : n;
+
+            // split images wrapping around n
+            if (q + (e - s) > n)
+            {
+                ulint o = n - q;
+                in_map[s] = q; out_map[q] = s;
+                in_map[s+o] = 0; out_map[0] = s+o;
+            }
+            else
+            {
+                in_map[s] = q; out_map[q] = s;
+            }
+        }
+
+        // balancing: split input intervals whose image contains >= 2d input starts
+        std::vector<ulint> worklist;
+        for (auto const& p : in_map) worklist.push_back(p.first);
+
+        while (!worklist.empty())
+        {
+            ulint s = worklist.back();
+            worklist.pop_back();
+
+            auto it = in_map.find(s);
+            assert(it != in_map.end());
+
+            ulint q = it->second;
+            auto next = std::next(it);
+            ulint e = next == in_map.end() ? n : next->first;
+            ulint len = e - s;
+
+            // input starts inside the image [q, q+len)
+            auto jt = in_map.lower_bound(q);
+            ulint cnt = 0;
+            ulint split = 0;
+            while (jt != in_map.end() && jt->first < q + len && cnt < 2*d)
+            {
+                if (cnt == d) split = jt->first;
+                ++cnt;
+                ++jt;
+            }
+            if (cnt < 2*d) continue;
+
+            // the first half [s, s+o) now maps onto exactly d input starts
+            ulint o = split - q;
+            assert(o > 0 && o < len);
+
+            ulint s2 = s + o;
+            in_map[s2] = split;
+            out_map[split] = s2;
+
+            // the second half may still be heavy
+            worklist.push_back(s2);
+
+            // the new input start may make its covering output interval heavy
+            auto ot = out_map.upper_bound(s2);
+            assert(ot != out_map.begin());
+            --ot;
+            worklist.push_back(ot->second);
+        }
+
+        ulint m = in_map.size();
+        ulint log_n = bitsize(n);
+
+        starts = sdsl::int_vector<>(m+1,0,log_n);
+        images = sdsl::int_vector<>(m,0,log_n);
+        dest = sdsl::int_vector<>(m,0,bitsize(m));
+
+        ulint t = 0;
+        for (auto const& p : in_map)
+        {
+            starts[t] = p.first;
+            images[t] = p.second;
+            ++t;
+        }
+        starts[m] = n; // sentinel
+
+        for (t = 0; t < m; ++t) dest[t] = interval_of(images[t]);
+    }
+
+    /*
+     * index of the input interval containing position i
+     */
+    ulint interval_of(ulint i) const
+    {
+        assert(i < n);
+
+        // last start <= i
+        ulint lo = 0, hi = number_of_intervals();
+        while (hi - lo > 1)
+        {
+            ulint mid = (lo + hi) / 2;
+            if (starts[mid] <= i) lo = mid;
+            else hi = mid;
+        }
+        return lo;
+    }
+
+    /*
+     * f(i) for i inside the t-th input interval
+     * updates i to f(i) and t to the interval containing f(i)
+     */
+    inline void move(ulint& i, ulint& t) const
+    {
+        jump(i,t);
+        settle(i,t);
+    }
+
+    /*
+     * move in two halves, so that interleaved callers can prefetch in between:
+     * jump maps i with the t-th interval and sets t to the interval of its image start,
+     * settle scans forward from there to the interval containing i
+     */
+    inline void jump(ulint& i, ulint& t) const
+    {
+        assert(starts[t] <= i && i < starts[t+1]);
+
+        i = images[t] + (i - starts[t]);
+        t = dest[t];
+    }
+
+    inline void settle(ulint i, ulint& t) const
+    {
+        while (starts[t+1] <= i) ++t;
+    }
+
+    // prefetch what settle & the next move read for interval t
+    inline void prefetch(ulint t) const
+    {
+        prefetch_entry(starts, t+1);
+        prefetch_entry(images, t);
+        prefetch_entry(dest, t);
+    }
+
+    /*
+     * f(i)
+     */
+    ulint operator[](ulint i) const
+    {
+        ulint t = interval_of(i);
+        move(i,t);
+        return i;
+    }
+
+    inline ulint start(ulint t) const { return starts[t]; }
+
+    inline ulint image(ulint t) const { return images[t]; }
+
+    inline ulint size() const { return n; }
+
+    inline ulint number_of_intervals() const { return images.size(); }
+
+    ulint serialize(std::ostream& out) const
+    {
+        ulint w_bytes = 0;
+
+        out.write((char*)&n,sizeof(n));
+        w_bytes += sizeof(n);
+
+        if (n == 0) return w_bytes;
+
+        w_bytes += starts.serialize(out);
+        w_bytes += images.serialize(out);
+        w_bytes += dest.serialize(out);
+
+        return w_bytes;
+    }
+
+    /*
+     * an exhausted stream leaves the structure empty
+     */
+    void load(std::istream& in)
+    {
+        n = 0;
+        in.read((char*)&n,sizeof(n));
+
+        if (in.gcount() != sizeof(n))
+        {
+            n = 0;
+            in.clear();
+            return;
+        }
+
+        if (n == 0) return;
+
+        starts.load(in);
+        images.load(in);
+        dest.load(in);
+    }
+
+    ulint print_space() const
+    {
+        ulint tot_bytes = 0;
+
+        std::ofstream out("/dev/null");
+        std::cout << "space for move_structure (" << number_of_intervals() << " intervals):" << std::endl;
+
+        auto bytes = starts.serialize(out);
+        tot_bytes += bytes;
+        std::cout << "- starts: " << bytes << " bytes" << std::endl;
+
+        bytes = images.serialize(out);
+        tot_bytes += bytes;
+        std::cout << "- images: " << bytes << " bytes" << std::endl;
+
+        bytes = dest.serialize(out);
+        tot_bytes += bytes;
+        std::cout << "- dest: " << bytes << " bytes" << std::endl;
+
+        return tot_bytes;
+    }
+
+    ulint get_space() const
+    {
+        ulint tot_bytes = 0;
+
+        if (n == 0) return tot_bytes;
+
+        std::ofstream out("/dev/null");
+
+        tot_bytes += starts.serialize(out);
+        tot_bytes += images.serialize(out);
+        tot_bytes += dest.serialize(out);
+
+        return tot_bytes;
+    }
+
+private:
+
+    // domain size
+    ulint n = 0;
+
+    // first position of each input interval (+ sentinel n)
+    sdsl::int_vector<> starts;
+
+    // image of the first position of each input interval
+    sdsl::int_vector<> images;
+
+    // input interval containing images[t]
+    sdsl::int_vector<> dest;
+
+};
+
+};
+
+#endif /* INCLUDED_MOVE_STRUCTURE_HPP */
@@ -0,0 +1,115 @@
+/*
+ * ms_thresholds: the thresholds of MONI for matching statistics, O(r) words.
+ *
+ * For each BWT run of character c that has a c-run before it, the position
+ * of a minimum of LCP between the end of that c-run and the start of this
+ * run, and the minimum itself. A position q in between that does not hold c
+ * shares the longest common prefix with the c above it if q < threshold,
+ * with the c below it otherwise; the other one shares exactly the minimum.
+ */
+
+#ifndef INCLUDED_MS_THRESHOLDS_HPP
+#define INCLUDED_MS_THRESHOLDS_HPP
+
+#include "definitions.hpp"
+
+namespace bri {
+
+class ms_thresholds {
+
+public:
+    ms_thresholds() {}
+
+    /*
+     * constructor
+     * \param n BWT length
+     * \param threshold threshold position of each run (0 if no run of its character precedes it)
+     * \param min_lcp LCP minimum between the run and the previous run of its character
+     */
+    ms_thresholds(ulint n, std::vector<ulint> const& threshold, std::vector<ulint> const& min_lcp)
+    {
+        assert(threshold.size() == min_lcp.size());
+
+        this->n = n;
+
+        uchar log_n = bitsize(n);
+        ulint r = threshold.size();
+        this->threshold = sdsl::int_vector<>(r,0,log_n);
+        this->min_lcp = sdsl::int_vector<>(r,0,log_n);
+        for (ulint k = 0; k < r; ++k)
+        {
+            this->threshold[k] = threshold[k];
+            this->min_lcp[k] = min_lcp[k];
+        }
+    }
+
+    // number of runs, 0 if there are no thresholds
+    inline ulint size() const { return threshold.size(); }
+
+    inline ulint threshold_of(ulint k) const { return threshold[k]; }
+
+    inline ulint min_lcp_of(ulint k) const { return min_lcp[k]; }
+
+    ulint serialize(std::ostream& out) const
+    {
+        ulint w_bytes = 0;
+
+        out.write((char*)&n,sizeof(n));
+        w_bytes += sizeof(n);
+
+        if (n == 0) return w_bytes;
+
+        w_bytes += threshold.serialize(out);
+        w_bytes += min_lcp.serialize(out);
+
+        return w_bytes;
+    }
+
+    /*
+     * an exhausted stream leaves the structure empty
+     */
+    void load(std::istream& in)
+    {
+        n = 0;
+        in.read((char*)&n,sizeof(n));
+
+        if (in.gcount() != sizeof(n))
+        {
+            n = 0;
+            in.clear();
+            return;
+        }
+
+        if (n == 0) return;
+
+        threshold.load(in);
+        min_lcp.load(in);
+    }
+
+    ulint get_space() const
+    {
+        ulint tot_bytes = 0;
+
+        if (n == 0) return tot_bytes;
+
+        std::ofstream out("/dev/null");
+
+        tot_bytes += threshold.serialize(out);
+        tot_bytes += min_lcp.serialize(out);
+
+        return tot_bytes;
+    }
+
+private:
+
+    // BWT length, 0 if there are no thresholds
+    ulint n = 0;
+
+    sdsl::int_vector<> threshold;
+    sdsl::int_vector<> min_lcp;
+
+};
+
+};
+
+#endif /* INCLUDED_MS_THRESHOLDS_HPP */
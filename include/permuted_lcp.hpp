@@ -104,7 +104,7 @@ public:
     /*
      * get PLCP[i]
      */
-    ulint operator[](size_t i)
+    ulint operator[](size_t i) const
     {
         assert(i < n);
         ulint rank_0 = ones.rank(i+1);
@@ -116,7 +116,7 @@ public:
         return 0;
     }
 
-    ulint get_value(size_t i)
+    ulint get_value(size_t i) const
     {
         return operator[](i);
     }
@@ -124,7 +124,7 @@ public:
     /*
      * serialize PLCP to the ostream
      */
-    ulint serialize(std::ostream& out)
+    ulint serialize(std::ostream& out) const
     {
         ulint w_bytes = 0;
 
@@ -155,7 +155,7 @@ public:
         zeros.load(in);
     }
 
-    ulint print_space()
+    ulint print_space() const
     {
         ulint tot_bytes = 0;
 
@@ -173,7 +173,7 @@ public:
         return tot_bytes;
     }
 
-    ulint get_space()
+    ulint get_space() const
     {
         ulint tot_bytes = 0;
 
@@ -185,7 +185,7 @@ public:
         return tot_bytes;
     }
 
-    ulint size()
+    ulint size() const
     {
         return n;
     }
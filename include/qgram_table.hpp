@@ -0,0 +1,181 @@
+/*
+ * qgram_table: the br_sample of every q-gram occurring in the text, so
+ * that searches start at depth q with one lookup instead of q extensions.
+ *
+ * A q-gram is keyed by its remapped characters packed into one integer
+ * (bits per character each), which keeps lexicographic order; the keys
+ * are sorted and looked up by binary search. Only occurring q-grams are
+ * stored.
+ */
+
+#ifndef INCLUDED_QGRAM_TABLE_HPP
+#define INCLUDED_QGRAM_TABLE_HPP
+
+#include "definitions.hpp"
+
+namespace bri {
+
+class qgram_table {
+
+public:
+    qgram_table() {}
+
+    /*
+     * constructor
+     * \param q length of the q-grams
+     * \param bits bits per remapped character in the keys
+     * \param n BWT length
+     * \param entries <key, sample> of each occurring q-gram, sorted by key
+     */
+    qgram_table(ulint q, uchar bits, ulint n, std::vector<std::pair<ulint,br_sample> > const& entries)
+    {
+        assert(q > 0 && q * bits <= 64);
+
+        this->q = q;
+        this->bits = bits;
+
+        ulint m = entries.size();
+        uchar log_n = bitsize(n);
+
+        keys = sdsl::int_vector<>(m,0,q*bits);
+        range_first = sdsl::int_vector<>(m,0,log_n);
+        rangeR_first = sdsl::int_vector<>(m,0,log_n);
+        sizes = sdsl::int_vector<>(m,0,log_n);
+        j = sdsl::int_vector<>(m,0,log_n);
+        d = sdsl::int_vector<>(m,0,bitsize(q));
+
+        for (ulint i = 0; i < m; ++i)
+        {
+            assert(i == 0 || entries[i-1].first < entries[i].first);
+
+            br_sample const& s = entries[i].second;
+            keys[i] = entries[i].first;
+            range_first[i] = s.range.first;
+            rangeR_first[i] = s.rangeR.first;
+            sizes[i] = s.size();
+            j[i] = s.j;
+            d[i] = s.d;
+        }
+    }
+
+    inline ulint length() const { return q; }
+
+    inline uchar bits_per_char() const { return bits; }
+
+    // number of occurring q-grams
+    inline ulint size() const { return keys.size(); }
+
+    /*
+     * sample of the q-gram with the given key
+     * returns false if it does not occur
+     */
+    bool find(ulint key, br_sample& sample) const
+    {
+        ulint lo = 0, hi = keys.size();
+        while (lo < hi)
+        {
+            ulint mid = lo + (hi - lo) / 2;
+            if (keys[mid] < key) lo = mid + 1;
+            else hi = mid;
+        }
+        if (lo == keys.size() || keys[lo] != key) return false;
+
+        ulint size = sizes[lo];
+        sample.range = range_t(range_first[lo], range_first[lo] + size - 1);
+        sample.rangeR = range_t(rangeR_first[lo], rangeR_first[lo] + size - 1);
+        sample.j = j[lo];
+        sample.d = d[lo];
+        sample.len = q;
+        return true;
+    }
+
+    ulint serialize(std::ostream& out) const
+    {
+        ulint w_bytes = 0;
+
+        out.write((char*)&q,sizeof(q));
+        w_bytes += sizeof(q);
+
+        if (q == 0) return w_bytes;
+
+        out.write((char*)&bits,sizeof(bits));
+        w_bytes += sizeof(bits);
+
+        w_bytes += keys.serialize(out);
+        w_bytes += range_first.serialize(out);
+        w_bytes += rangeR_first.serialize(out);
+        w_bytes += sizes.serialize(out);
+        w_bytes += j.serialize(out);
+        w_bytes += d.serialize(out);
+
+        return w_bytes;
+    }
+
+    /*
+     * an exhausted stream leaves the table empty
+     */
+    void load(std::istream& in)
+    {
+        q = 0;
+        in.read((char*)&q,sizeof(q));
+
+        if (in.gcount() != sizeof(q))
+        {
+            q = 0;
+            in.clear();
+            return;
+        }
+
+        if (q == 0) return;
+
+        in.read((char*)&bits,sizeof(bits));
+
+        keys.load(in);
+        range_first.load(in);
+        rangeR_first.load(in);
+        sizes.load(in);
+        j.load(in);
+        d.load(in);
+    }
+
+    ulint get_space() const
+    {
+        ulint tot_bytes = 0;
+
+        if (q == 0) return tot_bytes;
+
+        std::ofstream out("/dev/null");
+
+        tot_bytes += keys.serialize(out);
+        tot_bytes += range_first.serialize(out);
+        tot_bytes += rangeR_first.serialize(out);
+        tot_bytes += sizes.serialize(out);
+        tot_bytes += j.serialize(out);
+        tot_bytes += d.serialize(out);
+
+        return tot_bytes;
+    }
+
+private:
+
+    // length of the q-grams, 0 if there is no table
+    ulint q = 0;
+
+    // bits per remapped character in the keys
+    uchar bits = 0;
+
+    // packed q-grams, sorted
+    sdsl::int_vector<> keys;
+
+    // SA & SAR ranges (first position & size) and toehold j, d of each q-gram
+    sdsl::int_vector<> range_first;
+    sdsl::int_vector<> rangeR_first;
+    sdsl::int_vector<> sizes;
+    sdsl::int_vector<> j;
+    sdsl::int_vector<> d;
+
+};
+
+};
+
+#endif /* INCLUDED_QGRAM_TABLE_HPP */
@@ -11,6 +11,11 @@
  *
  *  Time for all operations: O( B*(log(n/R)+H0) )
  *
+ *  With run_directory, the run starts are also stored in a bit-packed array
+ *  (r log n bits, rebuilt on load): the runs of a block are contiguous there,
+ *  so finding the run of a position is runs.rank plus a scan of one cache line,
+ *  and run_at/run_start/run_end are one or two loads instead of selects.
+ *
  *  From the paper
  *
  *  Djamal Belazzougui, Fabio Cunial, Travis Gagie, Nicola Prezza and Mathieu Raffinot.
@@ -29,7 +34,8 @@ namespace bri {
 
 template<
     class sparse_bitvector_t = sparse_sd_vector,
-    class string_t = huffman_string
+    class string_t = huffman_string,
+    bool run_directory = false
 >
 class rle_string {
 
@@ -101,9 +107,11 @@ public:
 
         assert(run_heads.size() == r);
 
+        build_directory();
+
     }
 
-    uchar operator[](size_t i)
+    uchar operator[](size_t i) const
     {
         assert(i < n);
         return run_heads[run_of(i).first];
@@ -112,7 +120,7 @@ public:
     /*
      * index of i-th character c 
      */
-    size_t select(ulint i, uchar c)
+    size_t select(ulint i, uchar c) const
     {
         assert(i<runs_per_letter[c].size());
 
@@ -127,21 +135,13 @@ public:
         // position in run_heads
         ulint p = run_heads.select(j,c);
 
-        // k = number of bits before position of interest in the main string
-        // k is initialized looking at the sampled runs
-        assert(p/B==0 || p/B - 1 < runs.number_of_1());
-        ulint k = (p/B == 0 ? 0 : runs.select(p/B-1)+1);
-
-        // add remaining run length to k
-        for (ulint t = (p/B)*B; t < p; ++t) k += run_at(t);
-
-        return k + before;
+        return run_start(p) + before;
     }
 
     /*
      * number of c before position i
      */
-    ulint rank(size_t i, uchar c)
+    ulint rank(size_t i, uchar c) const
     {
 
         assert(i <= n);
@@ -152,110 +152,174 @@ public:
         // number of all c
         if (i == n) return runs_per_letter[c].size();
 
-        ulint last_block = runs.rank(i);
-        ulint current_run = last_block * B;
+        auto ro = run_and_offset(i);
+        ulint current_run = ro.first;
+        ulint dist = ro.second;
 
-        // current position in the string
-        ulint pos = 0;
-        if (last_block > 0) pos = runs.select(last_block-1) + 1;
+        // number of c runs before the current run
+        ulint rk = run_heads.rank(current_run, c);
 
-        assert(pos <= i);
+        // number of c before i in the current run
+        ulint tail = (run_heads[current_run] == c) * dist;
 
-        ulint dist = i - pos;
+        if (rk == 0) return tail;
 
-        // scan at most B runs
-        while (pos < i) 
-        {
-            pos += run_at(current_run);
-            current_run++;
+        return runs_per_letter[c].select(rk-1)+1+tail;
 
-            if (pos <= i) dist = i - pos;
-        }
+    }
 
-        if (pos > i) current_run--;
+    /*
+     * number of characters smaller than c in the range rn (inclusive)
+     *
+     * the distinct run heads overlapping rn are enumerated in one traversal
+     * of the run-head wavelet tree, so only the characters actually occurring
+     * in rn cost a select, instead of two ranks for every a < c
+     */
+    ulint count_smaller(range_t rn, uchar c) const
+    {
+        if (rn.first > rn.second) return 0;
 
-        assert(current_run < r);
+        assert(rn.second < n);
 
-        // number of c runs before the current run
-        ulint rk = run_heads.rank(current_run, c);
+        // <run, offset inside the run> of both ends
+        auto lo = run_and_offset(rn.first);
+        auto hi = run_and_offset(rn.second);
 
-        // number of c before i in the current run
-        ulint tail = (run_heads[current_run] == c) * dist;
+        // rn lies inside a single run
+        if (lo.first == hi.first)
+            return run_heads[lo.first] < c ? rn.second + 1 - rn.first : 0;
 
-        if (rk == 0) return tail;
+        ulint k = 0;
+        auto& buf = symbol_buffers::of_thread();
+        auto& cs = buf.cs;
+        auto& rank_lo = buf.rank_lo;
+        auto& rank_hi = buf.rank_hi;
+        run_heads.interval_symbols(lo.first, hi.first+1, k, cs, rank_lo, rank_hi);
 
-        return runs_per_letter[c].select(rk-1)+1+tail;
+        uchar head_lo = run_heads[lo.first];
+        uchar head_hi = run_heads[hi.first];
+
+        ulint acc = 0;
+        for (ulint t = 0; t < k; ++t)
+        {
+            uchar a = cs[t];
+            if (a >= c) continue;
+
+            // number of a before rn.first
+            ulint before = letters_in_runs(a, rank_lo[t]) + (head_lo == a) * lo.second;
+
+            // number of a up to rn.second
+            ulint upto = (head_hi == a)
+                ? letters_in_runs(a, rank_hi[t]-1) + hi.second + 1
+                : letters_in_runs(a, rank_hi[t]);
 
+            acc += upto - before;
+        }
+
+        return acc;
     }
 
     /*
-     * run number of text position i
+     * all distinct characters in the range rn (inclusive) with their ranks,
+     * i.e. rank(rn.first,c) and rank(rn.second+1,c), in one traversal of the
+     * run-head wavelet tree (multi-symbol rank)
+     * returns <c, rank(rn.first,c), rank(rn.second+1,c)> in increasing order of c
      */
-    ulint run_of_position(size_t i)
+    std::vector<std::tuple<uchar,ulint,ulint> > interval_symbols(range_t rn) const
     {
+        std::vector<std::tuple<uchar,ulint,ulint> > res;
 
-        assert(i < n);
+        if (rn.first > rn.second) return res;
 
-        ulint last_block = runs.rank(i);
-        ulint current_run = last_block * B;
+        assert(rn.second < n);
 
-        //current position in the string: the first of a block
-        ulint pos = 0;
-        if(last_block > 0)
-            pos = runs.select(last_block-1)+1;
+        auto lo = run_and_offset(rn.first);
+        auto hi = run_and_offset(rn.second);
 
-        assert(pos <= i);
+        // rn lies inside a single run
+        if (lo.first == hi.first)
+        {
+            uchar c = run_heads[lo.first];
+            ulint before = rank(rn.first,c);
+            res.push_back(std::make_tuple(c, before, before + rn.second + 1 - rn.first));
+            return res;
+        }
 
-        ulint dist = i - pos;
+        ulint k = 0;
+        auto& buf = symbol_buffers::of_thread();
+        auto& cs = buf.cs;
+        auto& rank_lo = buf.rank_lo;
+        auto& rank_hi = buf.rank_hi;
+        run_heads.interval_symbols(lo.first, hi.first+1, k, cs, rank_lo, rank_hi);
+
+        uchar head_lo = run_heads[lo.first];
+        uchar head_hi = run_heads[hi.first];
+
+        // the wavelet tree is Huffman-shaped: its symbols are put back in
+        // lexicographic order through a bitmap of the characters found
+        ulint found[4] = {0, 0, 0, 0};
+        uchar slot[256];
+        for (ulint t = 0; t < k; ++t)
+        {
+            found[cs[t] >> 6] |= ulint(1) << (cs[t] & 63);
+            slot[cs[t]] = (uchar)t;
+        }
 
-        //scan at most B runs
-        while(pos < i){
+        res.reserve(k);
+        for (ulint w = 0; w < 4; ++w)
+        {
+            for (ulint bits = found[w]; bits != 0; bits &= bits - 1)
+            {
+                uchar a = (uchar)(64 * w + __builtin_ctzll(bits));
+                ulint t = slot[a];
 
-            pos += run_at(current_run);
-            current_run++;
+                ulint before = letters_in_runs(a, rank_lo[t]) + (head_lo == a) * lo.second;
 
-            if(pos <= i) dist = i - pos;
+                ulint upto = (head_hi == a)
+                    ? letters_in_runs(a, rank_hi[t]-1) + hi.second + 1
+                    : letters_in_runs(a, rank_hi[t]);
 
+                res.push_back(std::make_tuple(a, before, upto));
+            }
         }
 
-        if(pos>i) current_run--;
+        return res;
+    }
 
-        assert(current_run < r);
+    /*
+     * run number of text position i
+     */
+    ulint run_of_position(size_t i) const
+    {
 
-        return current_run;
+        return run_and_offset(i).first;
 
     }
 
-    ulint size() { return n; }
+    ulint size() const { return n; }
 
     /*
      * inclusive range of j-th run
      */
-    range_t run_range(ulint j)
+    range_t run_range(ulint j) const
     {
 
         assert(j < run_heads.size());
 
-        ulint this_block = j/B;
-        ulint current_run = this_block * B;
-        ulint pos = (this_block == 0 ? 0 : runs.select(this_block-1)+1);
-
-        while (current_run < j)
-        {
-            pos += run_at(current_run);
-            current_run++;
-        }
+        if (run_directory) return {starts[j], starts[j+1] - 1};
 
-        assert(current_run == j);
+        ulint pos = run_start(j);
 
         return {pos, pos + run_at(j) - 1};
 
     }
 
-    ulint run_start(ulint j)
+    ulint run_start(ulint j) const
     {
         assert(j < run_heads.size());
 
+        if (run_directory) return starts[j];
+
         ulint this_block = j/B;
         ulint current_run = this_block * B;
         ulint pos = (this_block == 0 ? 0 : runs.select(this_block-1)+1);
@@ -271,42 +335,35 @@ public:
         return pos;
     }
 
-    ulint run_end(ulint j)
+    ulint run_end(ulint j) const
     {
         assert(j < run_heads.size());
 
-        ulint this_block = j/B;
-        ulint current_run = this_block * B;
-        ulint pos = (this_block == 0 ? 0 : runs.select(this_block-1)+1);
-
-        while (current_run < j)
-        {
-            pos += run_at(current_run);
-            current_run++;
-        }
+        if (run_directory) return starts[j+1] - 1;
 
-        assert(current_run == j);
-
-        return pos + run_at(j) - 1;
+        return run_start(j) + run_at(j) - 1;
     }
 
 
     /*
      * length of i-th run
      */
-    ulint run_at(ulint i)
+    ulint run_at(ulint i) const
     {
 
         assert(i < r);
+
+        if (run_directory) return starts[i+1] - starts[i];
+
         uchar c = run_heads[i];
 
         return runs_per_letter[c].gap_at(run_heads.rank(i,c));
 
     }
 
-    ulint number_of_runs() { return r; }
+    ulint number_of_runs() const { return r; }
 
-    ulint serialize(std::ostream& out)
+    ulint serialize(std::ostream& out) const
     {
 
         ulint w_bytes = 0;
@@ -348,6 +405,8 @@ public:
         
         run_heads.load(in);
 
+        build_directory();
+
     }
 
     // load from plain text bwt file
@@ -400,6 +459,8 @@ public:
         }
         runs = sparse_bitvector_t(runs_pos.cbegin(),runs_pos.cend());
 
+        build_directory();
+
     }
 
     // load from plain text bwt file using alphabet remapper
@@ -452,9 +513,52 @@ public:
         }
         runs = sparse_bitvector_t(runs_pos.cbegin(),runs_pos.cend());
 
+        build_directory();
+
+    }
+
+    /*
+     * build from the maximal runs: heads[k] (remapped, no 0) repeated lengths[k] times,
+     * so that a BWT streamed as runs needs no second pass to remap its characters
+     */
+    void load_from_runs(std::string const& heads, std::vector<ulint> const& lengths, ulint B=2) {
+        assert(heads.size() == lengths.size() && heads.size() > 0);
+
+        this->B=B;
+        r = heads.size();
+        n = 0;
+
+        auto runs_per_letter_pos = std::vector<std::vector<ulint>>(256);
+        auto freqs = std::vector<ulint>(256,0);
+        std::vector<ulint> runs_pos;
+
+        for (ulint k = 0; k < r; ++k) {
+            uchar c = heads[k];
+            assert(c != 0 && (k == 0 || c != (uchar)heads[k-1]));
+            assert(lengths[k] > 0);
+
+            n += lengths[k];
+            freqs[c] += lengths[k];
+            runs_per_letter_pos[c].push_back(freqs[c]-1);
+
+            if (k+1 < r && k%B == B-1) runs_pos.push_back(n-1); //run end (only at the end of a block)
+        }
+        runs_pos.push_back(n-1);
+
+        std::string run_heads_s(heads);
+        run_heads = string_t(run_heads_s);
+        assert(run_heads.size()==r);
+
+        runs_per_letter = std::vector<sparse_bitvector_t>(256);
+        for (ulint i = 0; i < 256; ++i) {
+            runs_per_letter[i] = sparse_bitvector_t(runs_per_letter_pos[i].cbegin(),runs_per_letter_pos[i].cend());
+        }
+        runs = sparse_bitvector_t(runs_pos.cbegin(),runs_pos.cend());
+
+        build_directory();
     }
 
-    std::string to_string()
+    std::string to_string() const
     {
         
         std::string s;
@@ -466,7 +570,7 @@ public:
 
     }
 
-    ulint print_space()
+    ulint print_space() const
     {
 
         ulint tot_bytes = 0;
@@ -487,11 +591,18 @@ public:
         tot_bytes += bytesize;
         std::cout << "- run heads: " << bytesize << " bytes" << std::endl;
 
+        if (run_directory)
+        {
+            bytesize = starts.serialize(out);
+            tot_bytes += bytesize;
+            std::cout << "- run directory: " << bytesize << " bytes" << std::endl;
+        }
+
         return tot_bytes;
 
     }
 
-    ulint get_space()
+    ulint get_space() const
     {
         ulint tot_bytes = 0;
 
@@ -506,13 +617,21 @@ public:
         bytesize = run_heads.serialize(out);
         tot_bytes += bytesize;
 
+        if (run_directory) tot_bytes += starts.serialize(out);
+
         return tot_bytes;
 
     }
 
     // <j(run number of position i), p(last position of j-th run)>
-    std::pair<ulint,ulint> run_of(ulint i)
+    std::pair<ulint,ulint> run_of(ulint i) const
     {
+        if (run_directory)
+        {
+            ulint j = run_and_offset(i).first;
+            return {j, starts[j+1] - 1};
+        }
+
         ulint last_block = runs.rank(i);
         ulint current_run = last_block * B;
 
@@ -543,8 +662,95 @@ public:
         return {current_run, pos-1};
     }
 
+    // character of the k-th run
+    inline uchar run_head(ulint k) const { return run_heads[k]; }
+
+    /*
+     * <run number of position i, offset of i inside the run>
+     */
+    std::pair<ulint,ulint> run_and_offset(size_t i) const
+    {
+        assert(i < n);
+
+        ulint last_block = runs.rank(i);
+        ulint current_run = last_block * B;
+
+        if (run_directory)
+        {
+            // the starts of the block's runs are contiguous
+            while (starts[current_run+1] <= i) current_run++;
+            return {current_run, i - starts[current_run]};
+        }
+
+        // current position in the string: the first of a block
+        ulint pos = 0;
+        if (last_block > 0) pos = runs.select(last_block-1) + 1;
+
+        assert(pos <= i);
+
+        ulint dist = i - pos;
+
+        // scan at most B runs
+        while (pos < i)
+        {
+            pos += run_at(current_run);
+            current_run++;
+
+            if (pos <= i) dist = i - pos;
+        }
+
+        if (pos > i) current_run--;
+
+        assert(current_run < r);
+
+        return {current_run, dist};
+    }
+
 private:
 
+    /*
+     * run starts & the sentinel n, from the run lengths (run_directory only)
+     */
+    void build_directory()
+    {
+        if (!run_directory || n == 0) return;
+
+        // runs of each letter seen so far
+        std::vector<ulint> seen(256,0);
+
+        starts = sdsl::int_vector<>(r+1,0,bitsize(n));
+        for (ulint k = 0; k < r; ++k)
+        {
+            uchar c = run_heads[k];
+            starts[k+1] = starts[k] + runs_per_letter[c].gap_at(seen[c]++);
+        }
+        assert(starts[r] == n);
+    }
+
+    /*
+     * number of c in the first k c-runs
+     */
+    inline ulint letters_in_runs(uchar c, ulint k) const
+    {
+        return k == 0 ? 0 : runs_per_letter[c].select(k-1)+1;
+    }
+
+    /*
+     * output buffers of the multi-symbol rank on the run heads (sigma <= 256),
+     * allocated once per thread instead of at every extension or contraction step
+     */
+    struct symbol_buffers {
+        std::vector<uchar> cs = std::vector<uchar>(256);
+        std::vector<ulint> rank_lo = std::vector<ulint>(256);
+        std::vector<ulint> rank_hi = std::vector<ulint>(256);
+
+        static symbol_buffers& of_thread()
+        {
+            static thread_local symbol_buffers buf;
+            return buf;
+        }
+    };
+
     // static member func to count the number of runs in s
     static ulint count_runs(std::string& s)
     {
@@ -580,6 +786,9 @@ private:
     // number of runs
     ulint r = 0;
 
+    // start of each run & n (run_directory only)
+    sdsl::int_vector<> starts;
+
 };
 
 typedef rle_string<sparse_sd_vector> rle_string_sd;
@@ -31,25 +31,28 @@ public:
         u = sdv.size();
     }
 
+    // copy constructor. rank/select supports are re-bound to the copied sd_vector
+    sparse_sd_vector(const sparse_sd_vector& other) { *this = other; }
+
     sparse_sd_vector& operator=(const sparse_sd_vector& other);
 
-    inline bool rank_supported() { return rank_enabled; }
-    inline bool select_supported() { return select_enabled; }
+    inline bool rank_supported() const { return rank_enabled; }
+    inline bool select_supported() const { return select_enabled; }
 
     /*
      * argument: position i 
      * returns: bit in position i
      * ACCESS ONLY
      */
-    inline bool operator[](size_t i) { assert(i < size()); return sdv[i]; }
+    inline bool operator[](size_t i) const { assert(i < size()); return sdv[i]; }
 
-    inline bool at(size_t i) { return operator[](i); }
+    inline bool at(size_t i) const { return operator[](i); }
 
     /*
      * argument: position i 
      * returns: number of 1-bits in sdv[0...i-1]
      */
-    inline ulint rank(size_t i)
+    inline ulint rank(size_t i) const
     {
         assert(rank_enabled);
         assert(i <= size());
@@ -60,7 +63,7 @@ public:
 	 * argument: position 0<=i<=n
 	 * returns: predecessor of i (position i excluded)
 	 */
-    inline size_t predecessor(size_t i)
+    inline size_t predecessor(size_t i) const
     {
         assert(rank_enabled);
         assert(select_enabled);
@@ -74,7 +77,7 @@ public:
 	 * bitvector space. If i does not have a predecessor,
 	 * return rank of the last bit set in the bitvector
 	 */
-    inline ulint predecessor_rank_circular(ulint i)
+    inline ulint predecessor_rank_circular(ulint i) const
     {
         return rank(i) == 0 ? number_of_1() - 1 : rank(i) - 1;
     }
@@ -83,7 +86,7 @@ public:
 	 * argument: bit number 0 <= i < m
 	 * returns: gap between the i-th bit and (i-1)-th bit
 	 */
-    inline ulint gap_at(size_t i)
+    inline ulint gap_at(size_t i) const
     {
         assert(select_enabled);
         assert(i<number_of_1());
@@ -94,7 +97,7 @@ public:
 	 * argument: ulint i >= 0
 	 * returns: position of the i-th 1-bit
 	 */
-    inline size_t select(ulint i)
+    inline size_t select(ulint i) const
     {
         assert(select_enabled);
         assert(i<number_of_1());
@@ -104,12 +107,12 @@ public:
     /*
      * returns: size of the bitvector
      */
-    inline ulint size() { return u; }
+    inline ulint size() const { return u; }
 
     /*
      * returns: number of 1s in the bitvector
      */
-    inline ulint number_of_1() { 
+    inline ulint number_of_1() const { 
         assert(rank_enabled);
         return rank1(u); 
     }
@@ -118,7 +121,7 @@ public:
      * argument: ostream
      * returns: number of bytes written to ostream
      */
-    ulint serialize(std::ostream& out);
+    ulint serialize(std::ostream& out) const;
 
     /*
      * load bitvector from istream
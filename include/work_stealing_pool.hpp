@@ -0,0 +1,168 @@
+/*
+ * work-stealing thread pool
+ * each worker pops tasks from the back of its own deque (LIFO)
+ * and steals from the front of the other workers' deques (FIFO) when it runs out.
+ * the deques are vectors guarded by a mutex each (a front index marks stolen tasks),
+ * not lock-free deques; workers without a task block on a condition variable.
+ * tasks may spawn new tasks on the deque of the worker executing them,
+ * e.g. when has_idle_workers() tells that someone is waiting for work.
+ */
+
+#ifndef INCLUDED_WORK_STEALING_POOL_HPP
+#define INCLUDED_WORK_STEALING_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "definitions.hpp"
+
+namespace bri {
+
+template<class task_t>
+class work_stealing_pool {
+
+public:
+    work_stealing_pool(ulint threads)
+    {
+        if (threads == 0) threads = 1;
+        for (ulint i = 0; i < threads; ++i)
+            queues.emplace_back(new task_queue());
+    }
+
+    inline ulint number_of_threads() const { return queues.size(); }
+
+    /*
+     * execute the initial tasks and all the tasks they spawn
+     * func(task, worker) is called once per task, worker in [0,#threads)
+     * the calling thread works as worker 0
+     */
+    template<class func_t>
+    void run(std::vector<task_t> const& initial, func_t func)
+    {
+        pending = initial.size();
+        queued = initial.size();
+        for (ulint i = 0; i < initial.size(); ++i)
+            queues[i % queues.size()]->tasks.push_back(initial[i]);
+
+        std::vector<std::thread> workers;
+        for (ulint w = 1; w < queues.size(); ++w)
+            workers.emplace_back([this,&func,w]() { work(w, func); });
+        work(0, func);
+
+        for (auto& th : workers) th.join();
+    }
+
+    /*
+     * spawn a task from inside func on the given worker's deque
+     */
+    void push(ulint worker, task_t task)
+    {
+        pending++;
+        {
+            std::lock_guard<std::mutex> lock(queues[worker]->m);
+            queues[worker]->tasks.push_back(std::move(task));
+            queued++;
+        }
+        std::lock_guard<std::mutex> lock(wait_m);
+        wake.notify_one();
+    }
+
+    /*
+     * true if more workers wait for work than there are tasks queued for them
+     */
+    inline bool has_idle_workers() const { return idle > queued; }
+
+private:
+
+    struct task_queue {
+        std::mutex m;
+        std::vector<task_t> tasks;
+        ulint front = 0; // tasks[0,front) were stolen
+    };
+
+    template<class func_t>
+    void work(ulint w, func_t& func)
+    {
+        task_t task;
+        while (true)
+        {
+            if (pop(w, task) || steal(w, task))
+            {
+                func(task, w);
+                // spawned tasks were counted before this one finishes
+                if (--pending == 0)
+                {
+                    std::lock_guard<std::mutex> lock(wait_m);
+                    wake.notify_all();
+                }
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(wait_m);
+            if (pending == 0) break;
+            idle++;
+            wake.wait(lock, [this]() { return queued > 0 || pending == 0; });
+            idle--;
+        }
+    }
+
+    bool pop(ulint w, task_t& task)
+    {
+        auto& q = *queues[w];
+        std::lock_guard<std::mutex> lock(q.m);
+        if (q.front == q.tasks.size()) return false;
+        task = std::move(q.tasks.back());
+        q.tasks.pop_back();
+        take(q);
+        return true;
+    }
+
+    bool steal(ulint w, task_t& task)
+    {
+        for (ulint i = 1; i < queues.size(); ++i)
+        {
+            auto& q = *queues[(w + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(q.m);
+            if (q.front == q.tasks.size()) continue;
+            task = std::move(q.tasks[q.front++]);
+            take(q);
+            return true;
+        }
+        return false;
+    }
+
+    // bookkeeping after a task left q, whose mutex is held
+    void take(task_queue& q)
+    {
+        queued--;
+        if (q.front == q.tasks.size())
+        {
+            q.tasks.clear();
+            q.front = 0;
+        }
+    }
+
+    std::vector<std::unique_ptr<task_queue> > queues;
+
+    // tasks pushed and not finished yet
+    std::atomic<ulint> pending{0};
+
+    // tasks in the deques
+    std::atomic<ulint> queued{0};
+
+    // workers without a task, blocked on wake
+    std::atomic<ulint> idle{0};
+
+    // guards the waits for a task or for the end of the run
+    std::mutex wait_m;
+    std::condition_variable wake;
+
+};
+
+};
+
+#endif /* INCLUDED_WORK_STEALING_POOL_HPP */
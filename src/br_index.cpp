@@ -4,6 +4,7 @@
  */
 
 #include "br_index.hpp"
+#include "work_stealing_pool.hpp"
 
 namespace bri {
 
@@ -179,6 +180,7 @@ br_index::br_index(std::string const& input, ulint length, bool sais) {
     std::cout << "done." << std::endl << std::endl;
 
 
+    n = bwt.size();
     r = bwt.number_of_runs();
     rR = bwtR.number_of_runs();
 
@@ -397,18 +399,20 @@ br_index::br_index(std::string const& input, ulint length, bool sais) {
     sdsl::remove(sdsl::cache_file_name(sdsl::conf::KEY_LCP, cc));
     sdsl::remove(sdsl::cache_file_name(sdsl::conf::KEY_LCP, ccR));
 
+    build_plcp_samples();
+
     std::cout << " done. " << std::endl << std::endl;
 }
 
 /*
  * get full BWT range
  */
-range_t br_index::full_range()
+range_t br_index::full_range() const
 {
     return {0,bwt_size()-1};
 }
 
-ulint br_index::LF(ulint i)
+ulint br_index::LF(ulint i) const
 {
     auto c = bwt[i];
     return F[c] + bwt.rank(i,c);
@@ -419,10 +423,10 @@ ulint br_index::LF(ulint i)
  * c:  remapped character
  * returns: BWT range of cP
  */
-range_t br_index::LF(range_t rn, uchar c)
+range_t br_index::LF(range_t rn, uchar c) const
 {
 
-    if ((c == 255 && F[c] == bwt.size()) || F[c] >= F[c+1]) return {1,0};
+    if ((c == 255 && F[c] == n) || F[c] >= F[c+1]) return {1,0};
 
     ulint c_before = bwt.rank(rn.first, c);
 
@@ -436,7 +440,7 @@ range_t br_index::LF(range_t rn, uchar c)
 
 }
 
-ulint br_index::LFR(ulint i)
+ulint br_index::LFR(ulint i) const
 {
     auto c = bwtR[i];
     return F[c] + bwtR.rank(i,c);
@@ -447,10 +451,10 @@ ulint br_index::LFR(ulint i)
  * c:  remapped character
  * returns: BWT^R range of cP
  */
-range_t br_index::LFR(range_t rn, uchar c)
+range_t br_index::LFR(range_t rn, uchar c) const
 {
 
-    if ((c == 255 && F[c] == bwt.size()) || F[c] >= F[c+1]) return {1,0};
+    if ((c == 255 && F[c] == n) || F[c] >= F[c+1]) return {1,0};
 
     ulint c_before = bwtR.rank(rn.first, c);
 
@@ -467,7 +471,7 @@ range_t br_index::LFR(range_t rn, uchar c)
 /*
  * inverse of LF (known as Psi)
  */
-ulint br_index::FL(ulint i)
+ulint br_index::FL(ulint i) const
 {
 
     // i-th character in first BWT column F
@@ -480,7 +484,7 @@ ulint br_index::FL(ulint i)
 
 }
 
-ulint br_index::FLR(ulint i)
+ulint br_index::FLR(ulint i) const
 {
 
     // i-th character in first BWT column F
@@ -497,9 +501,9 @@ ulint br_index::FLR(ulint i)
  * Phi function
  * get SA[i] from SA[i+1]
  */
-ulint br_index::Phi(ulint i)
+ulint br_index::Phi(ulint i) const
 {
-    assert(i != bwt.size() - 1);
+    assert(i != n - 1);
 
     ulint jr = first.predecessor_rank_circular(i);
 
@@ -507,7 +511,7 @@ ulint br_index::Phi(ulint i)
 
     ulint k = first.select(jr);
 
-    assert(jr < r - 1 || k == bwt.size() - 1);
+    assert(jr < r - 1 || k == n - 1);
 
     // distance from predecessor
     ulint delta = k < i ? i - k : i + 1;
@@ -517,13 +521,13 @@ ulint br_index::Phi(ulint i)
 
     ulint prev_sample = samples_last[first_to_run[jr]-1];
 
-    return (prev_sample + delta) % bwt.size();
+    return (prev_sample + delta) % n;
 }
 /*
  * Phi inverse
  * get SA[i] from SA[i-1]
  */
-ulint br_index::PhiI(ulint i)
+ulint br_index::PhiI(ulint i) const
 {
     assert(i != last_SA_val);
 
@@ -533,7 +537,7 @@ ulint br_index::PhiI(ulint i)
 
     ulint k = last.select(jr);
 
-    assert(jr < r - 1 || k == bwt.size() - 1);
+    assert(jr < r - 1 || k == n - 1);
 
     // distance from predecessor
     ulint delta = k < i ? i - k : i + 1;
@@ -543,16 +547,16 @@ ulint br_index::PhiI(ulint i)
 
     ulint prev_sample = samples_first[last_to_run[jr]+1];
 
-    return (prev_sample + delta) % bwt.size();
+    return (prev_sample + delta) % n;
 }
 
 /*
  * PhiR function
  * get SAR[i] from SAR[i+1]
  */
-ulint br_index::PhiR(ulint i)
+ulint br_index::PhiR(ulint i) const
 {
-    assert(i != bwtR.size() - 1);
+    assert(i != n - 1);
 
     ulint jr = firstR.predecessor_rank_circular(i);
 
@@ -560,7 +564,7 @@ ulint br_index::PhiR(ulint i)
 
     ulint k = firstR.select(jr);
 
-    assert(jr < rR - 1 || k == bwtR.size() - 1);
+    assert(jr < rR - 1 || k == n - 1);
 
     // distance from predecessor
     ulint delta = k < i ? i - k : i + 1;
@@ -570,13 +574,13 @@ ulint br_index::PhiR(ulint i)
 
     ulint prev_sample = samples_lastR[first_to_runR[jr]-1];
 
-    return (prev_sample + delta) % bwtR.size();
+    return (prev_sample + delta) % n;
 }
 /*
  * PhiR inverse
  * get SAR[i] from SAR[i-1]
  */
-ulint br_index::PhiIR(ulint i)
+ulint br_index::PhiIR(ulint i) const
 {
     //assert(i != last_SA_val);
 
@@ -586,7 +590,7 @@ ulint br_index::PhiIR(ulint i)
 
     ulint k = lastR.select(jr);
 
-    assert(jr < rR - 1 || k == bwtR.size() - 1);
+    assert(jr < rR - 1 || k == n - 1);
 
     // distance from predecessor
     ulint delta = k < i ? i - k : i + 1;
@@ -596,13 +600,367 @@ ulint br_index::PhiIR(ulint i)
 
     ulint prev_sample = samples_firstR[last_to_runR[jr]+1];
 
-    return (prev_sample + delta) % bwtR.size();
+    return (prev_sample + delta) % n;
+}
+
+/*
+ * switch the Phi/PhiI backend of locate & left_contraction
+ * use=true builds the move structures from first/last if absent
+ */
+void br_index::use_move_structures(bool use)
+{
+    if (!use)
+    {
+        phi_move = move_structure();
+        phiI_move = move_structure();
+        phi_move_plcp = sdsl::int_vector<>();
+        phiI_move_plcp = sdsl::int_vector<>();
+        return;
+    }
+    if (has_move_structures()) return;
+
+    require(PHI_SECTIONS | section_bit(SEC_PLCP), "use_move_structures");
+
+    // Phi(i) = prev_sample + i - k for i in (k, k'], k & k' consecutive in first
+    // the interval following the last sample (n-1) starts at 0
+    // Phi(SA[0]) is closed circularly to SA[n-1] to make Phi a permutation
+    std::vector<range_t> intervals(r);
+    for (ulint t = 0; t < r; ++t)
+    {
+        ulint prev_sample = samples_last[first_to_run[t] > 0 ? first_to_run[t]-1 : r-1];
+        intervals[(t+1) % r] = range_t((first.select(t)+1) % n, (prev_sample+1) % n);
+    }
+    phi_move = move_structure(n, intervals);
+
+    for (ulint t = 0; t < r; ++t)
+    {
+        ulint prev_sample = samples_first[last_to_run[t] < r-1 ? last_to_run[t]+1 : 0];
+        intervals[(t+1) % r] = range_t((last.select(t)+1) % n, (prev_sample+1) % n);
+    }
+    phiI_move = move_structure(n, intervals);
+
+    phi_move_plcp = sdsl::int_vector<>(phi_move.number_of_intervals(),0,bitsize(n));
+    for (ulint t = 0; t < phi_move.number_of_intervals(); ++t)
+        phi_move_plcp[t] = plcp[phi_move.start(t)];
+
+    phiI_move_plcp = sdsl::int_vector<>(phiI_move.number_of_intervals(),0,bitsize(n));
+    for (ulint t = 0; t < phiI_move.number_of_intervals(); ++t)
+        phiI_move_plcp[t] = plcp[phiI_move.image(t)];
+}
+
+/*
+ * build (or drop) the LCP & LCPR smaller value samples of the contractions
+ * LCP is enumerated in SA order with PhiI from SA[0] = n-1 (the terminator)
+ */
+void br_index::use_lcp_psv(bool use, ulint block)
+{
+    if (!use)
+    {
+        psv = lcp_psv();
+        psvR = lcp_psv();
+        return;
+    }
+    ulint b = block > 0 ? block : (n + r - 1) / r;
+    ulint bR = block > 0 ? block : (n + rR - 1) / rR;
+    if (has_lcp_psv() && psv.block_size() == b && psvR.block_size() == bR) return;
+
+    require(PHI_SECTIONS | PHIR_SECTIONS | section_bit(SEC_PLCP) | section_bit(SEC_PLCPR), "use_lcp_psv");
+
+    auto build = [&](bool reversed, ulint b) {
+        ulint m = (n + b - 1) / b;
+        std::vector<ulint> block_min(m,n);
+        std::vector<ulint> last_sa(m,0);
+
+        ulint sa = n-1;
+        for (ulint i = 0; i < n; ++i)
+        {
+            if (i > 0) sa = reversed ? PhiIR(sa) : PhiI(sa);
+            ulint lcp = reversed ? plcpR[sa] : plcp[sa];
+            block_min[i/b] = std::min(block_min[i/b], lcp);
+            if (i % b == b-1 || i == n-1) last_sa[i/b] = sa;
+        }
+        return lcp_psv(n, b, block_min, last_sa);
+    };
+
+    psv = build(false, b);
+    psvR = build(true, bR);
+}
+
+/*
+ * build (or drop) the table of the samples of all occurring q-grams
+ * by a depth-first traversal of right extensions up to depth q
+ */
+void br_index::use_qgram_table(ulint q)
+{
+    qgrams = qgram_table();
+    if (q == 0) return;
+
+    require(section_bit(SEC_SAMPLES_LAST) | section_bit(SEC_SAMPLES_FIRSTR) | section_bit(SEC_SAMPLES_LASTR), "use_qgram_table");
+
+    uchar bits = bitsize(*std::max_element(remap.begin(), remap.end()));
+    if (q * bits > 64)
+    {
+        std::cerr << "br_index error: q-grams longer than " << 64 / bits << " do not fit in the table keys" << std::endl;
+        exit(1);
+    }
+
+    // right extensions come in increasing order of characters and are pushed
+    // in reverse, so that q-grams are reached in increasing order of keys
+    std::vector<std::pair<ulint,br_sample> > entries;
+    std::vector<std::pair<ulint,br_sample> > stack = {{0, get_initial_sample()}};
+    while (!stack.empty())
+    {
+        ulint key = stack.back().first;
+        br_sample sample(stack.back().second);
+        stack.pop_back();
+
+        if (sample.len == q)
+        {
+            entries.push_back({key, sample});
+            continue;
+        }
+
+        auto exts = right_extensions(sample);
+        for (auto it = exts.rbegin(); it != exts.rend(); ++it)
+            stack.push_back({(key << bits) | remap[it->first], it->second});
+    }
+
+    qgrams = qgram_table(q, bits, n, entries);
+}
+
+/*
+ * build (or drop) the matching statistics thresholds
+ * LCP is scanned in SA order with a stack of its suffix minima; at the start of
+ * a c-run, the first entry after the end of the previous c-run is the minimum
+ * the LCP smaller values are sampled too if absent: the LCP after a jump
+ * to the first or last c-run has no threshold to stop at
+ */
+void br_index::use_ms_thresholds(bool use)
+{
+    if (!use)
+    {
+        thresholds = ms_thresholds();
+        return;
+    }
+    if (!has_lcp_psv()) use_lcp_psv(true);
+    if (has_ms_thresholds()) return;
+
+    require(section_bit(SEC_BWT) | PHI_SECTIONS | section_bit(SEC_PLCP), "use_ms_thresholds");
+
+    std::vector<ulint> threshold(r,0);
+    std::vector<ulint> min_lcp(r,0);
+
+    // end of the last c-run + 1, 0 if none
+    std::vector<ulint> after_last(256,0);
+    // <position, LCP> of the suffix minima, increasing in both
+    std::vector<range_t> minima;
+
+    ulint sa = n-1;
+    ulint k = 0, run_start = 0;
+    for (ulint i = 0; i < n; ++i)
+    {
+        if (i > 0) sa = PhiI(sa);
+        ulint lcp = plcp[sa];
+        while (!minima.empty() && minima.back().second >= lcp) minima.pop_back();
+        minima.push_back({i,lcp});
+
+        if (i == run_start)
+        {
+            uchar c = bwt[i];
+            if (after_last[c] > 0)
+            {
+                auto it = std::lower_bound(minima.begin(), minima.end(), range_t(after_last[c],0));
+                threshold[k] = it->first;
+                min_lcp[k] = it->second;
+            }
+            run_start += bwt.run_at(k);
+            after_last[c] = run_start;
+            k++;
+        }
+    }
+
+    thresholds = ms_thresholds(n, threshold, min_lcp);
+}
+
+/*
+ * PLCP values at the first position of each Phi/PhiI/PhiR/PhiIR interval
+ * PhiI: plcp[PhiI(first position)], closed circularly like the move structures
+ */
+void br_index::build_plcp_samples()
+{
+
+    first_plcp = sdsl::int_vector<>(r,0,bitsize(n));
+    last_plcp = sdsl::int_vector<>(r,0,bitsize(n));
+    for (ulint jr = 0; jr < r; ++jr)
+    {
+        first_plcp[jr] = plcp[(first.select(jr)+1) % n];
+
+        ulint next_sample = samples_first[last_to_run[jr] < r-1 ? last_to_run[jr]+1 : 0];
+        last_plcp[jr] = plcp[(next_sample+1) % n];
+    }
+
+    firstR_plcp = sdsl::int_vector<>(rR,0,bitsize(n));
+    lastR_plcp = sdsl::int_vector<>(rR,0,bitsize(n));
+    for (ulint jr = 0; jr < rR; ++jr)
+    {
+        firstR_plcp[jr] = plcpR[(firstR.select(jr)+1) % n];
+
+        ulint next_sample = samples_firstR[last_to_runR[jr] < rR-1 ? last_to_runR[jr]+1 : 0];
+        lastR_plcp[jr] = plcpR[(next_sample+1) % n];
+    }
+}
+
+bool br_index::phi_step(ulint& i, ulint& t, ulint len) const
+{
+    if (has_move_structures())
+    {
+        if (phi_move_plcp[t] - (i - phi_move.start(t)) < len) return false;
+        phi_move.move(i,t);
+        return true;
+    }
+
+    ulint jr = first.predecessor_rank_circular(i);
+    ulint k = first.select(jr);
+    ulint delta = k < i ? i - k : i + 1;
+
+    if (first_plcp[jr] - (delta - 1) < len) return false;
+
+    // check if Phi(SA[0]) is not called
+    assert(first_to_run[jr] > 0);
+
+    i = (samples_last[first_to_run[jr]-1] + delta) % n;
+    return true;
+}
+
+bool br_index::phiI_step(ulint& i, ulint& t, ulint len) const
+{
+    if (i == last_SA_val) return false;
+
+    if (has_move_structures())
+    {
+        if (phiI_move_plcp[t] - (i - phiI_move.start(t)) < len) return false;
+        phiI_move.move(i,t);
+        return true;
+    }
+
+    ulint jr = last.predecessor_rank_circular(i);
+    ulint k = last.select(jr);
+    ulint delta = k < i ? i - k : i + 1;
+
+    if (last_plcp[jr] - (delta - 1) < len) return false;
+
+    assert(last_to_run[jr] < r-1);
+
+    i = (samples_first[last_to_run[jr]+1] + delta) % n;
+    return true;
+}
+
+bool br_index::phiR_step(ulint& i, ulint len) const
+{
+    ulint jr = firstR.predecessor_rank_circular(i);
+    ulint k = firstR.select(jr);
+    ulint delta = k < i ? i - k : i + 1;
+
+    if (firstR_plcp[jr] - (delta - 1) < len) return false;
+
+    assert(first_to_runR[jr] > 0);
+
+    i = (samples_lastR[first_to_runR[jr]-1] + delta) % n;
+    return true;
+}
+
+bool br_index::phiIR_step(ulint& i, ulint len) const
+{
+    ulint jr = lastR.predecessor_rank_circular(i);
+    ulint k = lastR.select(jr);
+    ulint delta = k < i ? i - k : i + 1;
+
+    if (lastR_plcp[jr] - (delta - 1) < len) return false;
+
+    assert(last_to_runR[jr] < rR-1);
+
+    i = (samples_firstR[last_to_runR[jr]+1] + delta) % n;
+    return true;
+}
+
+/*
+ * smallest first' <= first such that LCP[first'+1..first] >= len (LCPR if reversed)
+ * Phi steps inside the block of first and inside the nearest block with
+ * a smaller value, the blocks in between are skipped with psv
+ */
+ulint br_index::widen_first(ulint first, ulint pos, ulint len, bool reversed) const
+{
+    lcp_psv const& p = reversed ? psvR : psv;
+
+    ulint t = 0;
+    auto reset = [&]() { if (!reversed && has_move_structures()) t = phi_move.interval_of(pos); };
+    auto step = [&]() { return reversed ? phiR_step(pos,len) : phi_step(pos,t,len); };
+
+    reset();
+    if (p.size() == 0)
+    {
+        while (first > 0 && step()) first--;
+        return first;
+    }
+
+    ulint b = p.block_size();
+
+    // scan the block of first
+    ulint lo = first - first % b;
+    while (first > lo && step()) first--;
+    if (first > lo || first == 0 || !step()) return first;
+
+    // LCP >= len on [lo,first]: continue in the nearest block with a smaller value
+    ulint B;
+    if (!p.prev_smaller_block(lo / b, len, B)) return 0;
+
+    first = (B+1) * b - 1;
+    pos = p.last_sa_of(B);
+    reset();
+    while (first > 0 && step()) first--;
+    return first;
+}
+
+/*
+ * largest second' >= second such that LCP[second+1..second'] >= len (LCPR if reversed)
+ */
+ulint br_index::widen_second(ulint second, ulint pos, ulint len, bool reversed) const
+{
+    lcp_psv const& p = reversed ? psvR : psv;
+
+    ulint t = 0;
+    auto reset = [&]() { if (!reversed && has_move_structures()) t = phiI_move.interval_of(pos); };
+    auto step = [&]() { return reversed ? phiIR_step(pos,len) : phiI_step(pos,t,len); };
+
+    reset();
+    if (p.size() == 0 || second == n-1)
+    {
+        while (second < n-1 && step()) second++;
+        return second;
+    }
+
+    ulint b = p.block_size();
+
+    // scan the block of second+1
+    ulint hi = std::min(n, (second+1) / b * b + b) - 1;
+    while (second < hi && step()) second++;
+    if (second < hi || hi == n-1) return second;
+
+    // LCP >= len up to hi: continue in the nearest block with a smaller value
+    ulint B;
+    if (!p.next_smaller_block(hi / b, len, B)) return n-1;
+
+    second = B * b - 1;
+    pos = p.last_sa_of(B-1);
+    reset();
+    while (second < n-1 && step()) second++;
+    return second;
 }
 
 /*
  * character of position i in column F
  */
-uchar br_index::F_at(ulint i)
+uchar br_index::F_at(ulint i) const
 {
 
     ulint c = (std::upper_bound(F.begin(),F.end(),i) - F.begin()) - 1;
@@ -616,7 +974,7 @@ uchar br_index::F_at(ulint i)
 /*
  * return BWT range of original char c (not remapped)
  */
-range_t br_index::get_char_range(uchar c)
+range_t br_index::get_char_range(uchar c) const
 {
     // replace c with internal representation
     c = remap[c];
@@ -632,28 +990,29 @@ range_t br_index::get_char_range(uchar c)
 
 }
 
+/*
+ * number of characters smaller than c (remapped) in BWT[rn] or BWT^R[rn]
+ */
+ulint br_index::count_smaller(range_t rn, uchar c, bool reversed) const
+{
+    return reversed ? bwtR.count_smaller(rn,c) : bwt.count_smaller(rn,c);
+}
+
 /*
  * get a sample corresponding to an empty string
  */
-br_sample br_index::get_initial_sample()
+br_sample br_index::get_initial_sample() const
 {
+    require(section_bit(SEC_SAMPLES_LAST), "search");
+
     return br_sample(full_range(), // entire SA range
                     full_range(), // entire SAR range
-                    (samples_last[r-1]+1) % bwt.size(), // arbitrary sample
+                    (samples_last[r-1]+1) % n, // arbitrary sample
                     0,            // offset 0
                     0);           // null pattern
 
 }
 
-inline br_sample br_index::get_invalid_sample()
-{
-        return br_sample({1,0},   // empty SA range
-                    {1,0},        // empty SAR range
-                    0,            // arbitrary sample
-                    0,            // offset 0
-                    0);           // null pattern
-}
-
 /*
  * search the pattern cP (P:the current pattern)
  * returns SA&SAR range corresponding to cP
@@ -662,8 +1021,10 @@ inline br_sample br_index::get_invalid_sample()
  * 
  * assumes c is original char (not remapped)
  */
-br_sample br_index::left_extension(br_sample const& prev_sample, uchar c)
+br_sample br_index::left_extension(br_sample const& prev_sample, uchar c) const
 {
+    require(section_bit(SEC_BWT) | section_bit(SEC_SAMPLES_FIRST) | section_bit(SEC_SAMPLES_LAST), "left_extension");
+
     // replace c with internal representation
     c = remap[c];
 
@@ -681,12 +1042,7 @@ br_sample br_index::left_extension(br_sample const& prev_sample, uchar c)
     {
         
         // accumulated occ of aP (for any a s.t. a < c)
-        ulint acc = 0;
-        for (ulint a = 1; a < c; ++a)
-        {
-            range_t smaller_range = LF(prev_sample.range,(uchar)a);
-            acc += (smaller_range.second+1) - smaller_range.first;
-        }
+        ulint acc = bwt.count_smaller(prev_sample.range,c);
         // get SAR range of (cP)^R
         sample.rangeR.second = sample.rangeR.first + acc + sample.range.second - sample.range.first;
         sample.rangeR.first = sample.rangeR.first + acc;
@@ -731,8 +1087,10 @@ br_sample br_index::left_extension(br_sample const& prev_sample, uchar c)
  * 
  * assumes c is original char (not remapped)
  */
-br_sample br_index::right_extension(br_sample const& prev_sample, uchar c)
+br_sample br_index::right_extension(br_sample const& prev_sample, uchar c) const
 {
+    require(section_bit(SEC_SAMPLES_FIRSTR) | section_bit(SEC_SAMPLES_LASTR), "right_extension");
+
     // replace c with internal representation
     c = remap[c];
 
@@ -750,12 +1108,7 @@ br_sample br_index::right_extension(br_sample const& prev_sample, uchar c)
     {
 
         // accumulated occ of Pa (for any a s.t. a < c)
-        ulint acc = 0;
-        for (ulint a = 1; a < c; ++a)
-        {
-            range_t smaller_rangeR = LFR(prev_sample.rangeR,(uchar)a);
-            acc += (smaller_rangeR.second+1) - smaller_rangeR.first;
-        }
+        ulint acc = bwtR.count_smaller(prev_sample.rangeR,c);
         // get SA range of Pc
         sample.range.second = sample.range.first + acc + sample.rangeR.second - sample.rangeR.first; 
         sample.range.first = sample.range.first + acc;
@@ -775,9 +1128,9 @@ br_sample br_index::right_extension(br_sample const& prev_sample, uchar c)
 
         // j = SA[p]
         if (bwtR[prev_sample.rangeR.second] == c)
-            sample.j = bwt.size()-2-samples_firstR[run_of_pR];
+            sample.j = n-2-samples_firstR[run_of_pR];
         else
-            sample.j = bwt.size()-2-samples_lastR[run_of_pR];
+            sample.j = n-2-samples_lastR[run_of_pR];
 
         // reset d
         sample.d = sample.len;
@@ -791,12 +1144,147 @@ br_sample br_index::right_extension(br_sample const& prev_sample, uchar c)
     return sample;
 }
 
+/*
+ * all non-empty left extensions aP of the current pattern P
+ * returns <a, sample of aP> in increasing order of a (original chars)
+ *
+ * the characters preceding P and their ranks are obtained by one
+ * multi-symbol rank on BWT, instead of one LF per character
+ */
+std::vector<std::pair<uchar,br_sample> > br_index::left_extensions(br_sample const& prev_sample, bool toehold) const
+{
+    require(section_bit(SEC_BWT) | (toehold ? section_bit(SEC_SAMPLES_FIRST) | section_bit(SEC_SAMPLES_LAST) : 0), "left_extensions");
+
+    std::vector<std::pair<uchar,br_sample> > res;
+
+    if (prev_sample.is_invalid()) return res;
+
+    // <c, rank(first,c), rank(second+1,c)>
+    auto symbols = bwt.interval_symbols(prev_sample.range);
+
+    // only one character precedes P
+    bool unique = symbols.size() == 1;
+
+    uchar last_c = (toehold && !unique) ? bwt[prev_sample.range.second] : 0;
+
+    // accumulated occ of aP (for any a s.t. a < c)
+    ulint acc = 0;
+    for (auto const& sym : symbols)
+    {
+        uchar c = std::get<0>(sym);
+        ulint c_before = std::get<1>(sym);
+        ulint c_inside = std::get<2>(sym) - c_before;
+
+        if (c != TERMINATOR)
+        {
+            br_sample sample(prev_sample);
+
+            sample.range.first = F[c] + c_before;
+            sample.range.second = sample.range.first + c_inside - 1;
+
+            if (unique)
+            {
+                sample.d++;
+            }
+            else
+            {
+                sample.rangeR.first = prev_sample.rangeR.first + acc;
+                sample.rangeR.second = sample.rangeR.first + c_inside - 1;
+
+                if (toehold)
+                {
+                    // last c in range and its sample
+                    ulint p = bwt.select(std::get<2>(sym)-1,c);
+                    ulint run_of_p = bwt.run_of_position(p);
+
+                    if (last_c == c)
+                        sample.j = samples_first[run_of_p];
+                    else
+                        sample.j = samples_last[run_of_p];
+
+                    sample.d = 0;
+                }
+            }
+            sample.len++;
+
+            res.push_back({remap_inv[c], sample});
+        }
+        acc += c_inside;
+    }
+    return res;
+}
+
+/*
+ * all non-empty right extensions Pa of the current pattern P
+ * returns <a, sample of Pa> in increasing order of a (original chars)
+ */
+std::vector<std::pair<uchar,br_sample> > br_index::right_extensions(br_sample const& prev_sample, bool toehold) const
+{
+    require(toehold ? section_bit(SEC_SAMPLES_FIRSTR) | section_bit(SEC_SAMPLES_LASTR) : 0, "right_extensions");
+
+    std::vector<std::pair<uchar,br_sample> > res;
+
+    if (prev_sample.is_invalid()) return res;
+
+    // <c, rank(firstR,c), rank(secondR+1,c)>
+    auto symbols = bwtR.interval_symbols(prev_sample.rangeR);
+
+    // only one character follows P
+    bool unique = symbols.size() == 1;
+
+    uchar last_c = (toehold && !unique) ? bwtR[prev_sample.rangeR.second] : 0;
+
+    // accumulated occ of Pa (for any a s.t. a < c)
+    ulint acc = 0;
+    for (auto const& sym : symbols)
+    {
+        uchar c = std::get<0>(sym);
+        ulint c_before = std::get<1>(sym);
+        ulint c_inside = std::get<2>(sym) - c_before;
+
+        if (c != TERMINATOR)
+        {
+            br_sample sample(prev_sample);
+
+            sample.rangeR.first = F[c] + c_before;
+            sample.rangeR.second = sample.rangeR.first + c_inside - 1;
+
+            if (!unique)
+            {
+                sample.range.first = prev_sample.range.first + acc;
+                sample.range.second = sample.range.first + c_inside - 1;
+
+                if (toehold)
+                {
+                    // last c in rangeR and its sample
+                    ulint pR = bwtR.select(std::get<2>(sym)-1,c);
+                    ulint run_of_pR = bwtR.run_of_position(pR);
+
+                    if (last_c == c)
+                        sample.j = n-2-samples_firstR[run_of_pR];
+                    else
+                        sample.j = n-2-samples_lastR[run_of_pR];
+
+                    sample.d = sample.len;
+                }
+            }
+            sample.len++;
+
+            res.push_back({remap_inv[c], sample});
+        }
+        acc += c_inside;
+    }
+    return res;
+}
+
 /*
  * match the pattern P from the current pattern cP
  * return SAR&SA range corresponding to P
  */
-br_sample br_index::left_contraction(br_sample const& prev_sample)
+br_sample br_index::left_contraction(br_sample const& prev_sample) const
 {
+    require(section_bit(SEC_BWT) | PHI_SECTIONS | section_bit(SEC_KMER), "left_contraction");
+
     br_sample sample(prev_sample);
     assert(sample.len >= 1);
 
@@ -806,14 +1294,15 @@ br_sample br_index::left_contraction(br_sample const& prev_sample)
     ulint psi_s = FL(sample.range.first);
     ulint psi_e = FL(sample.range.second);
 
-    uchar c = bwt[psi_s];
-
-
     // updating range, rangeR
-    ulint run_psi_s = bwt.run_of_position(psi_s);
-    ulint run_start = bwt.run_start(run_psi_s);
-    ulint run_psi_e = bwt.run_of_position(psi_e);
-    ulint run_end = bwt.run_end(run_psi_e);
+    auto run_offset_s = bwt.run_and_offset(psi_s);
+    ulint run_psi_s = run_offset_s.first;
+    ulint run_start = psi_s - run_offset_s.second;
+    auto run_end_e = bwt.run_of(psi_e);
+    ulint run_psi_e = run_end_e.first;
+    ulint run_end = run_end_e.second;
+
+    uchar c = bwt.run_head(run_psi_s);
     assert(run_start <= psi_s);
     assert(psi_e <= run_end);
 
@@ -833,34 +1322,18 @@ br_sample br_index::left_contraction(br_sample const& prev_sample)
     {
         sample.range.first = psi_s;
         if (run_start == psi_s) {
-            ulint pos = (samples_first[run_psi_s]+1) % bwt.size();
-
-            while (sample.range.first > 0 && plcp[pos] >= sample.len-1)
-            {
-                sample.range.first--;
-                pos = Phi(pos);
-            }
+            ulint pos = (samples_first[run_psi_s]+1) % n;
+            sample.range.first = widen_first(psi_s,pos,sample.len-1,false);
         }
         sample.range.second = psi_e;
         if (run_end == psi_e) {
-            ulint pos = (samples_last[run_psi_e]+1) % bwt.size();
-
-            while (sample.range.second < bwt.size()-1)
-            {
-                pos = PhiI(pos);
-                if (plcp[pos] < sample.len-1) break;
-                sample.range.second++;
-            }
+            ulint pos = (samples_last[run_psi_e]+1) % n;
+            sample.range.second = widen_second(psi_e,pos,sample.len-1,false);
         }
     }
     
     // accumulated occ of aP (for any a s.t. a < c)
-    ulint acc = 0;
-    for (ulint a = 1; a < c; ++a)
-    {
-        range_t smaller_range = LF(sample.range,(uchar)a);
-        acc += (smaller_range.second+1) - smaller_range.first;
-    }
+    ulint acc = bwt.count_smaller(sample.range,c);
     // get range for SAR
     sample.rangeR.first -= acc;
     sample.rangeR.second = sample.rangeR.first + sample.range.second - sample.range.first;
@@ -878,8 +1351,10 @@ br_sample br_index::left_contraction(br_sample const& prev_sample)
  * match the pattern P from the current pattern Pc
  * return SAR&SA range corresponding to P
  */
-br_sample br_index::right_contraction(br_sample const& prev_sample)
+br_sample br_index::right_contraction(br_sample const& prev_sample) const
 {
+    require(PHIR_SECTIONS | section_bit(SEC_SAMPLES_LAST) | section_bit(SEC_KMER+1), "right_contraction");
+
     br_sample sample(prev_sample);
     assert(sample.len >= 1);
 
@@ -889,13 +1364,15 @@ br_sample br_index::right_contraction(br_sample const& prev_sample)
     ulint psiR_sR = FLR(sample.rangeR.first);
     ulint psiR_eR = FLR(sample.rangeR.second);
 
-    uchar c = bwtR[psiR_sR];
-
     // updating range, rangeR
-    ulint run_psiR_sR = bwtR.run_of_position(psiR_sR);
-    ulint run_start = bwtR.run_start(run_psiR_sR);
-    ulint run_psiR_eR = bwtR.run_of_position(psiR_eR);
-    ulint run_end = bwtR.run_end(run_psiR_eR);
+    auto run_offset_s = bwtR.run_and_offset(psiR_sR);
+    ulint run_psiR_sR = run_offset_s.first;
+    ulint run_start = psiR_sR - run_offset_s.second;
+    auto run_end_e = bwtR.run_of(psiR_eR);
+    ulint run_psiR_eR = run_end_e.first;
+    ulint run_end = run_end_e.second;
+
+    uchar c = bwtR.run_head(run_psiR_sR);
     assert(run_start <= psiR_sR);
     assert(psiR_eR <= run_end);
 
@@ -915,34 +1392,18 @@ br_sample br_index::right_contraction(br_sample const& prev_sample)
     {
         sample.rangeR.first = psiR_sR;
         if (run_start == psiR_sR) {
-            ulint pos = (samples_firstR[run_psiR_sR]+1) % bwtR.size();
-
-            while (sample.rangeR.first > 0 && plcpR[pos] >= sample.len-1)
-            {
-                sample.rangeR.first--;
-                pos = PhiR(pos);
-            }
+            ulint pos = (samples_firstR[run_psiR_sR]+1) % n;
+            sample.rangeR.first = widen_first(psiR_sR,pos,sample.len-1,true);
         }
         sample.rangeR.second = psiR_eR;
         if (run_end == psiR_eR) {
-            ulint pos = (samples_lastR[run_psiR_eR]+1) % bwtR.size();
-
-            while (sample.rangeR.second < bwtR.size()-1)
-            {
-                pos = PhiIR(pos);
-                if (plcpR[pos] < sample.len-1) break;
-                sample.rangeR.second++;
-            }
+            ulint pos = (samples_lastR[run_psiR_eR]+1) % n;
+            sample.rangeR.second = widen_second(psiR_eR,pos,sample.len-1,true);
         }
     }
 
     // accumulated occ of Pa (for any a s.t. a < c)
-    ulint acc = 0;
-    for (ulint a = 1; a < c; ++a)
-    {
-        range_t smaller_rangeR = LFR(sample.rangeR,(uchar)a);
-        acc += (smaller_rangeR.second+1) - smaller_rangeR.first;
-    }
+    ulint acc = bwtR.count_smaller(sample.rangeR,c);
     // get range for SA
     sample.range.first -= acc;
     sample.range.second = sample.range.first + sample.rangeR.second - sample.rangeR.first;
@@ -958,10 +1419,18 @@ br_sample br_index::right_contraction(br_sample const& prev_sample)
 }
 
 // search the pattern
-br_sample br_index::search(std::string const& pattern)
+br_sample br_index::search(std::string const& pattern) const
 {
-    br_sample sample(get_initial_sample());
-    for (ulint i = 0; i < pattern.size(); ++i)
+    br_sample sample;
+    ulint i = 0;
+    if (qgram_prefix(pattern, sample))
+    {
+        if (sample.is_invalid()) return sample;
+        i = sample.len;
+    }
+    else sample = get_initial_sample();
+
+    for (; i < pattern.size(); ++i)
     {
         sample = right_extension(sample, pattern[i]);
         if (sample.is_invalid()) return sample;
@@ -969,15 +1438,108 @@ br_sample br_index::search(std::string const& pattern)
     return sample;
 }
 
+/*
+ * search the pattern for locate
+ * only the SAR range is maintained (LF on BWT^R), the toehold is computed
+ * once at the end from the last step that narrowed the range, which is
+ * where right_extension would have updated j & d for the last time
+ */
+ulint br_index::search_toehold(std::string const& pattern, ulint& sa) const
+{
+    require(section_bit(SEC_SAMPLES_LAST) | section_bit(SEC_SAMPLES_FIRSTR) | section_bit(SEC_SAMPLES_LASTR), "locate");
+
+    range_t rangeR = full_range();
+    size_t i = 0;
+
+    // toehold if the range does not narrow
+    br_sample sample;
+    if (qgram_prefix(pattern, sample))
+    {
+        if (sample.is_invalid()) return 0;
+        rangeR = sample.rangeR;
+        i = sample.len;
+    }
+    else
+    {
+        // same arbitrary sample as get_initial_sample
+        sample.j = (samples_last[r-1]+1) % n;
+        sample.d = 0;
+    }
+
+    // SAR range, char and pattern length before the last narrowing step
+    range_t prevR = rangeR;
+    uchar last_c = 0;
+    ulint last_len = 0;
+    bool narrowed = false;
+
+    for (; i < pattern.size(); ++i)
+    {
+        uchar c = remap[(uchar)pattern[i]];
+        range_t next = LFR(rangeR, c);
+
+        // pattern was not found
+        if (next.first > next.second) return 0;
+
+        if (next.second - next.first != rangeR.second - rangeR.first)
+        {
+            prevR = rangeR;
+            last_c = c;
+            last_len = i;
+            narrowed = true;
+        }
+        rangeR = next;
+    }
+
+    sa = narrowed ? toehold_of(prevR, last_c, last_len) : sample.j - sample.d;
+
+    return (rangeR.second + 1) - rangeR.first;
+}
+
+/*
+ * toehold of a pattern whose last narrowing step extended P[0,len) (SAR range prevR) with c:
+ * the last c in prevR and its sample, as in right_extension
+ */
+ulint br_index::toehold_of(range_t prevR, uchar c, ulint len) const
+{
+    ulint rnk = bwtR.rank(prevR.second+1,c);
+    assert(rnk > 0);
+    ulint pR = bwtR.select(rnk-1,c);
+    ulint run_of_pR = bwtR.run_of_position(pR);
+
+    ulint j;
+    if (bwtR[prevR.second] == c)
+        j = n-2-samples_firstR[run_of_pR];
+    else
+        j = n-2-samples_lastR[run_of_pR];
+
+    assert(j >= len);
+    return j - len;
+}
+
+/*
+ * one lookup for the first q characters (invalid sample if they do not occur)
+ */
+bool br_index::qgram_prefix(std::string const& pattern, br_sample& sample) const
+{
+    ulint q = qgrams.length();
+    if (q == 0 || pattern.size() < q) return false;
+
+    ulint key = 0;
+    for (ulint i = 0; i < q; ++i) key = (key << qgrams.bits_per_char()) | remap[(uchar)pattern[i]];
+
+    if (!qgrams.find(key, sample)) sample = get_invalid_sample();
+    return true;
+}
+
 /*
  * count occurrences of current pattern P
  */
-ulint br_index::count_sample(br_sample const& sample)
+ulint br_index::count_sample(br_sample const& sample) const
 {
     return (sample.range.second + 1) - sample.range.first;
 }
 
-ulint br_index::count_samples(std::unordered_map<range_t,br_sample,range_hash> const& samples)
+ulint br_index::count_samples(std::unordered_map<range_t,br_sample,range_hash> const& samples) const
 {
     ulint res = 0;
     for (auto it = samples.begin(); it != samples.end(); ++it)
@@ -992,158 +1554,811 @@ ulint br_index::count_samples(std::unordered_map<range_t,br_sample,range_hash> c
  * return them as std::vector
  * (space consuming if result is big)
  */
-std::vector<ulint> br_index::locate_sample(br_sample const& sample)
+std::vector<ulint> br_index::locate_sample(br_sample const& sample) const
 {
-    assert(sample.j >= sample.d);
-
-    ulint sa = sample.j - sample.d;
-    ulint pos = sa;
+    require(PHI_SECTIONS, "locate");
 
     std::vector<ulint> res;
+    if (sample.is_invalid()) return res;
     res.reserve(sample.range.second + 1 - sample.range.first);
 
-    res.push_back(pos);
+    locate_sample(sample, [&res](ulint occ) { res.push_back(occ); return true; });
+
+    return res;
+}
+
+std::vector<ulint> br_index::locate_samples(std::vector<br_sample> const& samples) const
+{
+    std::vector<ulint> res;
+    for (auto const& s: samples)
+    {
+        locate_sample(s, [&res](ulint occ) { res.push_back(occ); return true; });
+    }
+    return res;
+}
 
-    while (plcp[pos] >= sample.len) 
+std::vector<ulint> br_index::locate_samples(std::unordered_map<range_t,br_sample,range_hash> const& samples) const
+{
+    std::vector<ulint> res;
+    for (auto it = samples.begin(); it != samples.end(); ++it)
     {
-        pos = Phi(pos);
-        res.push_back(pos);
+        locate_sample(it->second, [&res](ulint occ) { res.push_back(occ); return true; });
     }
+    return res;
+}
+
+br_index::locate_cursor::locate_cursor(br_index const* idx, br_sample const& sample)
+{
+    this->idx = idx;
+    if (sample.is_invalid()) return;
+
+    idx->require(PHI_SECTIONS, "locate");
+
+    assert(sample.j >= sample.d);
+
+    len = sample.len;
+    sa = sample.j - sample.d;
     pos = sa;
-    while (true)
+    state = TOEHOLD;
+}
+
+br_index::locate_cursor::locate_cursor(br_index const* idx, ulint sa, ulint len)
+{
+    this->idx = idx;
+
+    idx->require(PHI_SECTIONS, "locate");
+
+    this->len = len;
+    this->sa = sa;
+    pos = sa;
+    state = TOEHOLD;
+}
+
+/*
+ * get the next occurrence
+ * one step of Phi or PhiI, PLCP from the interval samples
+ */
+bool br_index::locate_cursor::next(ulint& occ)
+{
+    switch (state)
+    {
+    case TOEHOLD:
+        t = idx->has_move_structures() ? idx->phi_move.interval_of(pos) : 0;
+        state = PHI;
+        occ = pos;
+        cnt++;
+        return true;
+
+    case PHI:
+        if (idx->phi_step(pos,t,len))
+        {
+            occ = pos;
+            cnt++;
+            return true;
+        }
+        pos = sa;
+        t = idx->has_move_structures() ? idx->phiI_move.interval_of(pos) : 0;
+        state = PHII;
+        // fall through
+
+    case PHII:
+        if (idx->phiI_step(pos,t,len))
+        {
+            occ = pos;
+            cnt++;
+            return true;
+        }
+        state = DONE;
+        return false;
+
+    default:
+        return false;
+    }
+}
+
+/*
+ * append at most n occurrences to out
+ * the cursor can be resumed by later calls
+ */
+ulint br_index::locate_cursor::next(std::vector<ulint>& out, ulint n)
+{
+    ulint occ, appended = 0;
+    while (appended < n && next(occ))
+    {
+        out.push_back(occ);
+        appended++;
+    }
+    return appended;
+}
+
+/*
+ * count the number of a given pattern
+ */
+ulint br_index::count(std::string const& pattern) const
+{
+    // SAR range only: the toehold is not needed for counting
+    range_t rangeR = full_range();
+    size_t i = 0;
+
+    br_sample sample;
+    if (qgram_prefix(pattern, sample))
+    {
+        if (sample.is_invalid()) return 0;
+        rangeR = sample.rangeR;
+        i = sample.len;
+    }
+
+    for (; i < pattern.size(); ++i)
     {
-        if (pos == last_SA_val) break;
-        pos = PhiI(pos);
-        if (plcp[pos] < sample.len) break;
-        res.push_back(pos);
+        rangeR = LFR(rangeR, remap[(uchar)pattern[i]]);
+        if (rangeR.first > rangeR.second) return 0;
     }
+    return (rangeR.second + 1) - rangeR.first;
+}
+
+/*
+ * locate occurrences of a given pattern
+ */
+std::vector<ulint> br_index::locate(std::string const& pattern) const
+{
+    std::vector<ulint> res;
+
+    ulint sa;
+    ulint occ = search_toehold(pattern, sa);
+    if (occ == 0) return res;
+    res.reserve(occ);
+
+    locate_cursor cursor(this, sa, pattern.size());
+    cursor.next(res, occ);
 
     return res;
 }
 
-std::vector<ulint> br_index::locate_samples(std::vector<br_sample> const& samples)
+/*
+ * locate occurrences of a given pattern in SA order
+ */
+std::vector<ulint> br_index::locate_sa_order(std::string const& pattern, ulint threads) const
+{
+    return locate_sample_sa_order(search(pattern), threads);
+}
+
+/*
+ * SA[range.first..range.second] of the sample
+ * the segment up to the end of the first run is walked with Phi from SA[end],
+ * the others start at run starts s with SA[s] = samples_first+1 and are walked with PhiI;
+ * a range inside one run is walked both ways from the toehold
+ */
+std::vector<ulint> br_index::locate_sample_sa_order(br_sample const& sample, ulint threads) const
 {
     std::vector<ulint> res;
-    for (auto s: samples)
+    if (sample.is_invalid()) return res;
+
+    require(section_bit(SEC_BWT) | section_bit(SEC_SAMPLES_FIRST) | section_bit(SEC_SAMPLES_LAST) | PHI_SECTIONS, "locate_sample_sa_order");
+
+    ulint lo = sample.range.first, hi = sample.range.second;
+    ulint occ = hi + 1 - lo;
+    res.resize(occ);
+
+    // <run of lo, last position of the run>
+    auto run_lo = bwt.run_of(lo);
+    if (run_lo.second >= hi)
     {
-        auto tmp = locate_sample(s);
-        res.insert(res.end(),tmp.begin(),tmp.end());
+        ulint sa = sample.j - sample.d;
+        std::vector<ulint> up;
+        ulint pos = sa, t = has_move_structures() ? phi_move.interval_of(pos) : 0;
+        while (phi_step(pos,t,sample.len)) up.push_back(pos);
+        std::copy(up.rbegin(), up.rend(), res.begin());
+        res[up.size()] = sa;
+        pos = sa;
+        t = has_move_structures() ? phiI_move.interval_of(pos) : 0;
+        for (ulint i = up.size() + 1; i < occ && phiI_step(pos,t,sample.len); ++i) res[i] = pos;
+        return res;
     }
+
+    // segments <first position, SA value there or at the last position, backwards>
+    struct segment { ulint first, last, sa; bool backwards; };
+    std::vector<segment> segments;
+    segments.push_back({lo, run_lo.second, (samples_last[run_lo.first]+1) % n, true});
+
+    // about 64 segments per thread, cut at the run starting before each target position
+    if (threads == 0) threads = 1;
+    ulint target = std::max<ulint>(1024, occ / (64 * threads));
+    ulint start = run_lo.second + 1;
+    ulint run = run_lo.first + 1;
+    while (start <= hi)
+    {
+        ulint end = hi;
+        ulint next_run = 0;
+        if (start + target <= hi)
+        {
+            auto ro = bwt.run_and_offset(start + target);
+            ulint s = start + target - ro.second;
+            if (s > start)
+            {
+                end = s - 1;
+                next_run = ro.first;
+            }
+            else
+            {
+                // start + target is in the run of start: cut after it
+                auto re = bwt.run_of(start + target);
+                if (re.second < hi)
+                {
+                    end = re.second;
+                    next_run = re.first + 1;
+                }
+            }
+        }
+        segments.push_back({start, end, (samples_first[run]+1) % n, false});
+        start = end + 1;
+        run = next_run;
+    }
+
+    // chains of a task advance in turns, so that their memory accesses overlap
+    const ulint interleave = 8;
+    auto locate_segments = [&](ulint first_segment) {
+        ulint last_segment = std::min<ulint>(first_segment + interleave, segments.size());
+        ulint m = last_segment - first_segment;
+        std::vector<ulint> pos(m), t(m), left(m), out(m);
+        for (ulint k = 0; k < m; ++k)
+        {
+            segment const& seg = segments[first_segment + k];
+            pos[k] = seg.sa;
+            t[k] = !has_move_structures() ? 0 : seg.backwards ? phi_move.interval_of(pos[k]) : phiI_move.interval_of(pos[k]);
+            left[k] = seg.last - seg.first;
+            out[k] = seg.backwards ? seg.last - lo : seg.first - lo;
+            res[out[k]] = pos[k];
+        }
+
+        bool active = true;
+        while (active)
+        {
+            active = false;
+            for (ulint k = 0; k < m; ++k)
+            {
+                if (left[k] == 0) continue;
+                if (segments[first_segment + k].backwards)
+                {
+                    phi_step(pos[k],t[k],sample.len);
+                    res[--out[k]] = pos[k];
+                }
+                else
+                {
+                    phiI_step(pos[k],t[k],sample.len);
+                    res[++out[k]] = pos[k];
+                }
+                active |= --left[k] > 0;
+            }
+        }
+    };
+
+    std::vector<ulint> tasks;
+    for (ulint k = 0; k < segments.size(); k += interleave) tasks.push_back(k);
+
+    if (threads == 1)
+    {
+        for (ulint k : tasks) locate_segments(k);
+    }
+    else
+    {
+        work_stealing_pool<ulint> pool(threads);
+        pool.run(tasks, [&](ulint k, ulint) { locate_segments(k); });
+    }
+
     return res;
 }
 
-std::vector<ulint> br_index::locate_samples(std::unordered_map<range_t,br_sample,range_hash> const& samples)
+/*
+ * count the occurrences of many patterns
+ */
+std::vector<ulint> br_index::count_batch(std::vector<std::string> const& patterns, ulint group) const
 {
-    std::vector<ulint> res;
-    for (auto it = samples.begin(); it != samples.end(); ++it)
+    std::vector<ulint> counts;
+    search_batch(patterns, group, counts, nullptr);
+    return counts;
+}
+
+/*
+ * locate the occurrences of many patterns, each in the order of locate
+ * the toehold of each pattern starts a Phi and a PhiI chain; group chains
+ * advance in turns, each step split where the next address is known and
+ * prefetched: predecessor search | PLCP & run samples | SA sample
+ * (with move structures: jump | forward scan & PLCP of the next interval)
+ */
+std::vector<std::vector<ulint> > br_index::locate_batch(std::vector<std::string> const& patterns, ulint group) const
+{
+    require(PHI_SECTIONS, "locate");
+
+    std::vector<ulint> counts, toeholds;
+    search_batch(patterns, group, counts, &toeholds);
+
+    std::vector<std::vector<ulint> > res(patterns.size());
+    // PhiI chains, appended once all chains are done
+    std::vector<std::vector<ulint> > below(patterns.size());
+
+    enum : uchar { RANK, SAMPLE, STEP };
+    struct chain { ulint p, pos, t, jr, delta; bool forwards; uchar stage; };
+
+    bool move = has_move_structures();
+    ulint next = 0;
+
+    // next chain (2p: Phi, 2p+1: PhiI) of a pattern that occurs, false if none is left
+    auto admit = [&](chain& ch) -> bool {
+        while (next < 2 * patterns.size() && counts[next / 2] == 0) next++;
+        if (next == 2 * patterns.size()) return false;
+
+        ch.p = next / 2;
+        ch.forwards = next % 2 == 1;
+        ch.pos = toeholds[ch.p];
+        ch.t = !move ? 0 : ch.forwards ? phiI_move.interval_of(ch.pos) : phi_move.interval_of(ch.pos);
+        ch.stage = RANK;
+        if (!ch.forwards)
+        {
+            res[ch.p].reserve(counts[ch.p]);
+            res[ch.p].push_back(ch.pos);
+        }
+        next++;
+        return true;
+    };
+
+    // one stage of the chain, false once it is done
+    auto advance = [&](chain& ch) -> bool {
+        ulint len = patterns[ch.p].size();
+        std::vector<ulint>& out = ch.forwards ? below[ch.p] : res[ch.p];
+
+        if (move)
+        {
+            move_structure const& mv = ch.forwards ? phiI_move : phi_move;
+            sdsl::int_vector<> const& mv_plcp = ch.forwards ? phiI_move_plcp : phi_move_plcp;
+
+            if (ch.stage == STEP)
+            {
+                mv.settle(ch.pos,ch.t);
+                out.push_back(ch.pos);
+            }
+            if (ch.forwards && ch.pos == last_SA_val) return false;
+            if (mv_plcp[ch.t] - (ch.pos - mv.start(ch.t)) < len) return false;
+
+            mv.jump(ch.pos,ch.t);
+            mv.prefetch(ch.t);
+            prefetch_entry(mv_plcp,ch.t);
+            ch.stage = STEP;
+            return true;
+        }
+
+        sparse_bitvector_t const& heads = ch.forwards ? last : first;
+        sdsl::int_vector<> const& heads_plcp = ch.forwards ? last_plcp : first_plcp;
+        sdsl::int_vector<> const& to_run = ch.forwards ? last_to_run : first_to_run;
+        sdsl::int_vector<> const& samples = ch.forwards ? samples_first : samples_last;
+
+        switch (ch.stage)
+        {
+        case STEP:
+            ch.pos = (samples[ch.jr] + ch.delta) % n;
+            out.push_back(ch.pos);
+            // fall through
+
+        case RANK:
+            if (ch.forwards && ch.pos == last_SA_val) return false;
+            ch.jr = heads.predecessor_rank_circular(ch.pos);
+            prefetch_entry(heads_plcp,ch.jr);
+            prefetch_entry(to_run,ch.jr);
+            ch.stage = SAMPLE;
+            return true;
+
+        default:
+        {
+            ulint k = heads.select(ch.jr);
+            ch.delta = k < ch.pos ? ch.pos - k : ch.pos + 1;
+            if (heads_plcp[ch.jr] - (ch.delta - 1) < len) return false;
+
+            // Phi(SA[0]) (PhiI(SA[n-1])) is never called
+            assert(ch.forwards ? to_run[ch.jr] < r-1 : to_run[ch.jr] > 0);
+            ch.jr = ch.forwards ? to_run[ch.jr] + 1 : to_run[ch.jr] - 1;
+            prefetch_entry(samples,ch.jr);
+            ch.stage = STEP;
+            return true;
+        }
+        }
+    };
+
+    if (group == 0) group = 1;
+    std::vector<chain> chains(group);
+    ulint active = 0;
+    while (active < group && admit(chains[active])) active++;
+
+    while (active > 0)
     {
-        auto tmp = locate_sample(it->second);
-        res.insert(res.end(),tmp.begin(),tmp.end());
+        for (ulint k = 0; k < active; )
+        {
+            if (advance(chains[k]) || admit(chains[k])) k++;
+            else chains[k] = chains[--active];
+        }
+    }
+
+    for (ulint p = 0; p < patterns.size(); ++p)
+    {
+        res[p].insert(res[p].end(), below[p].begin(), below[p].end());
+        std::vector<ulint>().swap(below[p]);
     }
+
     return res;
 }
 
 /*
- * count the number of a given pattern
+ * group patterns advance in lockstep, one LFR step each per round; a finished
+ * pattern hands its slot to the next one. counts[p] = #occ of pattern p and,
+ * if toeholds is not null, (*toeholds)[p] = one of them as in search_toehold
  */
-ulint br_index::count(std::string const& pattern)
+void br_index::search_batch(std::vector<std::string> const& patterns, ulint group, std::vector<ulint>& counts, std::vector<ulint>* toeholds) const
 {
-    br_sample sample(get_initial_sample());
-    for (size_t i = 0; i < pattern.size(); ++i)
+    if (toeholds != nullptr)
+        require(section_bit(SEC_SAMPLES_LAST) | section_bit(SEC_SAMPLES_FIRSTR) | section_bit(SEC_SAMPLES_LASTR), "locate");
+
+    // SAR range, and the toehold before the first narrowing step or the SAR range, char & length before the last one
+    struct search { ulint p, i, sa, last_len; range_t rangeR, prevR; uchar last_c; bool narrowed; };
+
+    counts.assign(patterns.size(),0);
+    if (toeholds != nullptr) toeholds->assign(patterns.size(),0);
+
+    // same arbitrary toehold as get_initial_sample
+    ulint initial_sa = toeholds == nullptr ? 0 : (samples_last[r-1]+1) % n;
+
+    auto finish = [&](search const& s) {
+        counts[s.p] = (s.rangeR.second + 1) - s.rangeR.first;
+        if (toeholds != nullptr)
+            (*toeholds)[s.p] = s.narrowed ? toehold_of(s.prevR, s.last_c, s.last_len) : s.sa;
+    };
+
+    ulint next = 0;
+
+    // next pattern not settled by the q-gram table alone, false if none is left
+    auto admit = [&](search& s) -> bool {
+        while (next < patterns.size())
+        {
+            s.p = next++;
+            s.i = 0;
+            s.sa = initial_sa;
+            s.rangeR = full_range();
+            s.narrowed = false;
+
+            br_sample sample;
+            if (qgram_prefix(patterns[s.p], sample))
+            {
+                if (sample.is_invalid()) continue;
+                s.rangeR = sample.rangeR;
+                s.i = sample.len;
+                s.sa = sample.j - sample.d;
+            }
+            if (s.i < patterns[s.p].size()) return true;
+            finish(s);
+        }
+        return false;
+    };
+
+    // one step of the search, false once it is done
+    auto advance = [&](search& s) -> bool {
+        uchar c = remap[(uchar)patterns[s.p][s.i]];
+        range_t next_range = LFR(s.rangeR, c);
+
+        // pattern was not found
+        if (next_range.first > next_range.second) return false;
+
+        if (next_range.second - next_range.first != s.rangeR.second - s.rangeR.first)
+        {
+            s.prevR = s.rangeR;
+            s.last_c = c;
+            s.last_len = s.i;
+            s.narrowed = true;
+        }
+        s.rangeR = next_range;
+
+        if (++s.i < patterns[s.p].size()) return true;
+        finish(s);
+        return false;
+    };
+
+    if (group == 0) group = 1;
+    std::vector<search> searches(group);
+    ulint active = 0;
+    while (active < group && admit(searches[active])) active++;
+
+    while (active > 0)
     {
-        sample = right_extension(sample, pattern[i]);
-        if (sample.is_invalid()) return 0;
+        for (ulint k = 0; k < active; )
+        {
+            if (advance(searches[k]) || admit(searches[k])) k++;
+            else searches[k] = searches[--active];
+        }
+    }
+}
+
+// gets MEMs (returns max length of maximal substrings)
+ulint br_index::maximal_exact_match(std::string const& pattern) const
+{
+    ulint max_l = 0;
+    maximal_exact_matches(pattern, 1, 1, [&max_l](ulint, br_sample const& sample) {
+        if (sample.len > max_l) max_l = sample.len;
+    });
+    return max_l;
+}
+
+/*
+ * matching statistics by MONI's backward pass: the position q of a suffix
+ * sharing lengths[i+1] characters with P[i+1,m) and pointers[i+1] = SA[q]
+ * go to LF(q) if BWT[q] = P[i], otherwise to LF of the P[i] above or below
+ * q chosen by the threshold, where the length becomes 1 + min(length, LCP).
+ * The LCP is only computed when the length exceeds the minimum stored with
+ * the threshold, by a Phi (PhiI) walk within a psv block or by lcp_min
+ * beyond it, so that a jump costs O(n/r) steps also without a threshold
+ */
+void br_index::matching_statistics(std::string const& pattern, std::vector<ulint>& lengths, std::vector<ulint>& pointers) const
+{
+    require(section_bit(SEC_BWT) | section_bit(SEC_SAMPLES_FIRST) | section_bit(SEC_SAMPLES_LAST)
+        | section_bit(SEC_MS_THRESHOLDS) | section_bit(SEC_LCP_PSV), "matching_statistics");
+    if (!has_ms_thresholds() || !has_lcp_psv())
+    {
+        std::cerr << "br_index error: matching_statistics needs the thresholds and the LCP smaller values (use_ms_thresholds)" << std::endl;
+        exit(1);
+    }
+
+    ulint m = pattern.size();
+    lengths.assign(m,0);
+    pointers.assign(m,0);
+
+    // min LCP[lo..hi] if smaller than bound, with sa = SA[hi] (SA[lo])
+    auto lcp_up = [&](ulint lo, ulint hi, ulint sa, ulint bound) {
+        if (hi - lo > psv.block_size()) return lcp_min(lo, hi);
+        ulint res = plcp[sa];
+        for (ulint x = hi; x > lo && res > bound; --x)
+        {
+            sa = Phi(sa);
+            res = std::min<ulint>(res, plcp[sa]);
+        }
+        return res;
+    };
+    auto lcp_down = [&](ulint lo, ulint hi, ulint sa, ulint bound) {
+        if (hi - lo > psv.block_size()) return lcp_min(lo, hi);
+        ulint res = plcp[sa];
+        for (ulint x = lo; x < hi && res > bound; ++x)
+        {
+            sa = PhiI(sa);
+            res = std::min<ulint>(res, plcp[sa]);
+        }
+        return res;
+    };
+
+    ulint q = 0, sa = 0, len = 0;
+    for (ulint i = m; i-- > 0; )
+    {
+        uchar c = remap[(uchar)pattern[i]];
+        range_t cr = get_char_range((uchar)pattern[i]);
+        if (c == 0 || cr.first > cr.second)
+        {
+            len = 0;
+            continue;
+        }
+
+        ulint rnk = len > 0 ? bwt.rank(q,c) : 0;
+        if (len > 0 && bwt[q] == c)
+        {
+            q = cr.first + rnk;
+            sa--;
+        }
+        else if (len == 0)
+        {
+            // any occurrence of c: the first one
+            ulint p = bwt.select(0,c);
+            q = cr.first;
+            sa = samples_first[bwt.run_of_position(p)];
+        }
+        else
+        {
+            ulint occ = cr.second + 1 - cr.first;
+
+            // c below q and its threshold
+            ulint below = 0, run_below = 0;
+            bool up = rnk == occ;
+            if (!up)
+            {
+                below = bwt.select(rnk,c);
+                run_below = bwt.run_of_position(below);
+                up = rnk > 0 && q < thresholds.threshold_of(run_below);
+            }
+
+            if (up)
+            {
+                ulint above = bwt.select(rnk-1,c);
+                ulint run_above = bwt.run_of_position(above);
+                ulint bound = rnk < occ ? thresholds.min_lcp_of(run_below) : 0;
+                if (len > bound) len = std::min(len, lcp_up(above+1, q, sa, bound));
+                q = cr.first + rnk - 1;
+                sa = samples_last[run_above];
+            }
+            else
+            {
+                ulint bound = rnk > 0 ? thresholds.min_lcp_of(run_below) : 0;
+                if (len > bound) len = std::min(len, lcp_down(q+1, below, PhiI(sa), bound));
+                q = cr.first + rnk;
+                sa = samples_first[run_below];
+            }
+        }
+
+        len++;
+        lengths[i] = len;
+        pointers[i] = sa;
     }
-    return count_sample(sample);
 }
 
 /*
- * locate occurrences of a given pattern
+ * depth-first with an explicit stack of counted samples,
+ * so that its bottom (the shallowest, largest subtrees) can be given away
  */
-std::vector<ulint> br_index::locate(std::string const& pattern)
-{
-    br_sample sample(get_initial_sample());
-    for (size_t i = 0; i < pattern.size(); ++i)
-    {
-        sample = right_extension(sample, pattern[i]);
-        if (sample.is_invalid()) return {};
-    }
-    return locate_sample(sample);
-}
-
-// gets MEMs (returns max length of maximal substrings)
-ulint br_index::maximal_exact_match(std::string const& pattern)
+ulint br_index::_full_task_dfs(ulint k, ulint t, br_sample const& root, work_stealing_pool<br_sample>* pool, ulint worker) const
 {
-    ulint m = pattern.size();
-    ulint j = 0, l = 0, max_l = 0;
-    bool extended = false;
+    ulint total = 0;
 
-    br_sample init(get_initial_sample());
-    br_sample sample(init);
+    std::vector<br_sample> stack(1,root);
+    ulint bottom = 0;
 
-    for (ulint i = 0; i < m; ++i)
+    while (bottom < stack.size())
     {
-        while (j < m)
+        if (pool != nullptr && bottom + 1 < stack.size() && pool->has_idle_workers())
         {
-            br_sample new_sample = right_extension(sample, (uchar)pattern[j]);
-            if (new_sample.is_invalid()) break;
-            extended = true;
-            sample = new_sample;
-            l++;
-            j++;
+            pool->push(worker,stack[bottom++]);
+            continue;
         }
-        if (extended)
-        {
-            if (l > max_l) max_l = l;
+
+        br_sample prev = stack.back();
+        stack.pop_back();
+
+        if (prev.len >= k) continue;
+
+        for (auto const& ext : right_extensions(prev,false)) {
+            br_sample const& sample = ext.second;
+
+            ulint cnt = sample.rangeR.second + 1 - sample.rangeR.first;
+            if (cnt >= t)
+            {
+                total += cnt;
+                stack.push_back(sample);
+            }
         }
-        
-        if (i == j)
+
+        if (bottom == stack.size())
         {
-            sample = init;
-            j++;
-            l = 0;
+            stack.clear();
+            bottom = 0;
         }
-        else 
+    }
+
+    return total;
+}
+
+// compute total number of substrings with length<=k & frequency>=t
+ulint br_index::full_task(ulint k, ulint t, ulint threads) const {
+    br_sample sample(get_initial_sample());
+    if (threads <= 1) return _full_task_dfs(k,t,sample);
+
+    ulint total = 0;
+
+    // split the top levels into (at least) 16 tasks per thread
+    std::vector<br_sample> tasks(1,sample);
+    while (!tasks.empty() && tasks.size() < 16 * threads)
+    {
+        std::vector<br_sample> next;
+        for (auto const& prev : tasks)
         {
-            sample = left_contraction(sample);
-            l--;
+            if (prev.len >= k) continue;
+            for (auto const& ext : right_extensions(prev,false))
+            {
+                ulint cnt = ext.second.rangeR.second + 1 - ext.second.rangeR.first;
+                if (cnt >= t)
+                {
+                    total += cnt;
+                    next.push_back(ext.second);
+                }
+            }
         }
-        extended = false;
+        tasks.swap(next);
     }
-    return max_l;
+
+    std::vector<ulint> totals(threads,0);
+    work_stealing_pool<br_sample> pool(threads);
+    pool.run(tasks, [&](br_sample const& task, ulint worker) {
+        totals[worker] += _full_task_dfs(k,t,task,&pool,worker);
+    });
+
+    for (auto x : totals) total += x;
+    return total;
 }
 
-ulint br_index::_full_task_dfs(ulint k, ulint t, br_sample const& prev)
+/*
+ * SA[i] (SAR[i]) from the SA sample at the end of the block of i
+ * at most one block of Phi (PhiR) steps
+ */
+ulint br_index::sa_at(ulint i, bool reversed) const
 {
-    if (prev.len >= k) return 0;
-    
-    ulint total = 0, acc = 0;
+    lcp_psv const& p = reversed ? psvR : psv;
+    ulint B = i / p.block_size();
 
-    for (ulint a = 2; a <= sigma; ++a) {
-        br_sample sample(prev);
+    ulint pos = p.last_sa_of(B);
+    for (ulint k = std::min(n, (B+1) * p.block_size()) - 1; k > i; --k)
+        pos = reversed ? PhiR(pos) : Phi(pos);
+    return pos;
+}
 
-        sample.rangeR = LFR(prev.rangeR,(uchar)a);
-        sample.len++;
+/*
+ * minimum of LCP[lo..hi]
+ * the blocks of lo and hi are scanned with Phi, the ones between from psv
+ */
+ulint br_index::lcp_min(ulint lo, ulint hi) const
+{
+    assert(lo <= hi && hi < n);
+
+    ulint b = psv.block_size();
 
-        ulint cnt = sample.rangeR.second + 1 - sample.rangeR.first;
-        if (cnt >= t) 
+    // min LCP[from..to] inside block B
+    auto scan = [&](ulint B, ulint from, ulint to) {
+        ulint i = std::min(n, (B+1) * b) - 1;
+        ulint pos = psv.last_sa_of(B);
+        for (; i > to; --i) pos = Phi(pos);
+        ulint res = plcp[pos];
+        for (; i > from; --i)
         {
-            total += cnt;
-            total += _full_task_dfs(k,t,sample);
+            pos = Phi(pos);
+            res = std::min<ulint>(res, plcp[pos]);
         }
-    }
+        return res;
+    };
 
-    return total;
+    ulint B_lo = lo / b, B_hi = hi / b;
+    if (B_lo == B_hi) return scan(B_lo, lo, hi);
+
+    ulint res = std::min(scan(B_lo, lo, (B_lo+1) * b - 1), scan(B_hi, B_hi * b, hi));
+    if (B_lo + 1 < B_hi) res = std::min(res, psv.min_of_blocks(B_lo+1, B_hi-1));
+    return res;
 }
 
-// compute total number of substrings with length<=k & frequency>=t
-ulint br_index::full_task(ulint k, ulint t) {
-    br_sample sample(get_initial_sample());
-    return _full_task_dfs(k,t,sample);
+/*
+ * ancestor with string depth len of the sample P, i.e. P[0..len)
+ * SA range: P[0..len) is a prefix of P, its range is the one of P widened while LCP >= len
+ * SAR range: (P[0..len))^R is a suffix of P^R, FLR^(|P|-len) maps a position of
+ * P^R's range into it, which is widened while LCPR >= len
+ * the edges in between cost one FLR each instead of one right_contraction
+ */
+br_sample br_index::contract_to(br_sample const& sample, ulint len) const
+{
+    assert(len < sample.len);
+
+    if (len == 0) return get_initial_sample();
+
+    br_sample res(sample);
+
+    ulint p = sample.rangeR.first;
+    ulint q = sa_at(p, true);
+    for (ulint k = len; k < sample.len; ++k)
+    {
+        p = FLR(p);
+        q++;
+    }
+    res.rangeR.first = widen_first(p, q, len, true);
+    res.rangeR.second = widen_second(p, q, len, true);
+
+    res.range.first = widen_first(sample.range.first, sa_at(sample.range.first, false), len, false);
+    res.range.second = res.range.first + res.rangeR.second - res.rangeR.first;
+
+    // j & d as after |P|-len right contractions
+    ulint d = std::min(sample.d, len-1);
+    res.j = sample.j - (sample.d - d);
+    res.d = d;
+    res.len = len;
+
+    return res;
 }
 
 // suffix tree op: parent
-br_sample br_index::parent(br_sample const& sample)
+br_sample br_index::parent(br_sample const& sample) const
 {
     assert(sample.len > 0);
 
@@ -1151,6 +2366,16 @@ br_sample br_index::parent(br_sample const& sample)
 
     if (sample.is_leaf() || par_sample.len == 0) return par_sample;
 
+    // on an edge after one step (and beyond the kmer shortcuts): jump to the
+    // string depth of the parent, the larger LCP at the borders of the SA range
+    if (has_lcp_psv() && par_sample.size() == sample.size() && par_sample.len > length)
+    {
+        ulint depth = plcp[sa_at(sample.range.first, false)];
+        if (sample.range.second + 1 < n)
+            depth = std::max<ulint>(depth, plcp[sa_at(sample.range.second + 1, false)]);
+        return contract_to(par_sample, depth);
+    }
+
     br_sample tmp(sample);
     while (par_sample.size() == tmp.size())
     {
@@ -1161,44 +2386,69 @@ br_sample br_index::parent(br_sample const& sample)
 }
 
 // suffix tree op: child
-br_sample br_index::child(br_sample const& sample, uchar c)
+br_sample br_index::child(br_sample const& sample, uchar c) const
 {
     if (sample.is_leaf()) return get_invalid_sample();
 
     br_sample new_sample(right_extension(sample,c));
     if (new_sample.is_invalid() || new_sample.is_leaf()) return new_sample;
 
-    uchar a = bwtR[new_sample.rangeR.first];
-    range_t rangeR = LFR(new_sample.rangeR,a);
-    while (rangeR.second + 1 - rangeR.first == new_sample.rangeR.second + 1 - new_sample.rangeR.first)
+    return descend_edge(new_sample);
+}
+
+// extend a non-leaf sample to the right until the next branching node
+br_sample br_index::descend_edge(br_sample sample) const
+{
+    uchar a = bwtR[sample.rangeR.first];
+    range_t rangeR = LFR(sample.rangeR,a);
+
+    // with psv, step at most one block's worth of characters
+    ulint steps = has_lcp_psv() ? psv.block_size() : n;
+    while (rangeR.second + 1 - rangeR.first == sample.rangeR.second + 1 - sample.rangeR.first && steps-- > 0)
     {
-        new_sample.rangeR.first = rangeR.first;
-        new_sample.rangeR.second = rangeR.second;
-        new_sample.len++;
+        sample.rangeR.first = rangeR.first;
+        sample.rangeR.second = rangeR.second;
+        sample.len++;
         rangeR = LFR(rangeR, bwtR[rangeR.first]);
     }
-    return new_sample;
+    // a long edge: the node's string depth is the min LCP inside its SA range,
+    // the range size stays the same along the edge: one LFR per character
+    if (rangeR.second + 1 - rangeR.first == sample.rangeR.second + 1 - sample.rangeR.first)
+    {
+        ulint depth = lcp_min(sample.range.first + 1, sample.range.second);
+        ulint size = sample.rangeR.second - sample.rangeR.first;
+        ulint p = sample.rangeR.first;
+        for (; sample.len < depth; ++sample.len) p = LFR(p);
+        sample.rangeR.first = p;
+        sample.rangeR.second = p + size;
+    }
+    return sample;
 }
 
 // suffix tree op: suffix-link
-br_sample br_index::slink(br_sample const& sample)
+br_sample br_index::slink(br_sample const& sample) const
 {
     assert(sample.size() > 1);
     return left_contraction(sample);
 }
 
 // suffix tree op: weiner-link
-br_sample br_index::wlink(br_sample const& sample, uchar c)
+br_sample br_index::wlink(br_sample const& sample, uchar c) const
 {
     return left_extension(sample,c);
 }
 
 // suffix tree op: lowest common ancestor
-br_sample br_index::lca(br_sample const& left, br_sample const& right)
+br_sample br_index::lca(br_sample const& left, br_sample const& right) const
 {
     if (left.len <= right.len) 
     {
         br_sample anc(left);
+        // jump to the string depth of the lca, the min LCP over both SA ranges,
+        // unless the parent already contains the other sample
+        if (has_lcp_psv() && anc.len > length && !anc.contains(right) && !(anc = parent(anc)).contains(right))
+            return contract_to(anc, lcp_min(std::min(left.range.first, right.range.first) + 1,
+                                            std::max(left.range.second, right.range.second)));
         while (!anc.contains(right)) anc = parent(anc);
 
         return anc;
@@ -1206,6 +2456,11 @@ br_sample br_index::lca(br_sample const& left, br_sample const& right)
     else 
     {
         br_sample anc(right);
+        // jump to the string depth of the lca, the min LCP over both SA ranges,
+        // unless the parent already contains the other sample
+        if (has_lcp_psv() && anc.len > length && !anc.contains(left) && !(anc = parent(anc)).contains(left))
+            return contract_to(anc, lcp_min(std::min(left.range.first, right.range.first) + 1,
+                                            std::max(left.range.second, right.range.second)));
         while (!anc.contains(left)) anc = parent(anc);
 
         return anc;
@@ -1213,25 +2468,25 @@ br_sample br_index::lca(br_sample const& left, br_sample const& right)
 }
 
 // suffix tree op: string-depth(v)
-ulint br_index::sdepth(br_sample const& sample)
+ulint br_index::sdepth(br_sample const& sample) const
 { 
-    if (sample.is_leaf()) return bwt.size() - (sample.j - sample.d);
+    if (sample.is_leaf()) return n - (sample.j - sample.d);
     return sample.len; 
 }
     
 // suffix tree op: first-child(v)
-br_sample br_index::fchild(br_sample const& sample)
+br_sample br_index::fchild(br_sample const& sample) const
 {
-    for (ulint a = 1; a <= sigma; ++a)
-    {
-        br_sample new_sample(child(sample,remap_inv[a]));
-        if (!new_sample.is_invalid()) return new_sample;
-    }
-    return get_invalid_sample();
+    if (sample.is_leaf()) return get_invalid_sample();
+
+    auto exts = right_extensions(sample,false);
+    if (exts.empty()) return get_invalid_sample();
+
+    return child(sample,exts.front().first);
 }
     
 // suffix tree op: next-sibling(v)
-br_sample br_index::nsibling(br_sample const& sample)
+br_sample br_index::nsibling(br_sample const& sample) const
 {
 
     br_sample par_sample(parent(sample));
@@ -1239,44 +2494,43 @@ br_sample br_index::nsibling(br_sample const& sample)
     for (ulint i = 0; i < sample.len-par_sample.len; ++i) p = FLR(p);
 
     uchar c = bwtR[p];
-    br_sample new_sample;
-    for (ulint a = c+1; a <= sigma; ++a)
+    for (auto const& ext : right_extensions(par_sample,false))
     {
-        new_sample = child(par_sample,remap_inv[a]);
-        if (!new_sample.is_invalid()) return new_sample;
+        if (remap[ext.first] > c) return child(par_sample,ext.first);
     }
     return get_invalid_sample();
 }
 
 
 // suffix tree op: children(v)
-std::vector<br_sample> br_index::children(br_sample const& sample)
+std::vector<br_sample> br_index::children(br_sample const& sample) const
 {
     std::vector<br_sample> res;
-    for (ulint a = 1; a <= sigma; ++a)
+    if (sample.is_leaf()) return res;
+
+    for (auto const& ext : right_extensions(sample))
     {
-        br_sample tmp(child(sample,remap_inv[a]));
-        if (!tmp.is_invalid()) res.push_back(tmp);
+        if (ext.second.is_leaf()) res.push_back(ext.second);
+        else res.push_back(descend_edge(ext.second));
     }
     return res;
 }
 
 // child characters
-std::vector<uchar> br_index::child_chars(br_sample const& sample)
+std::vector<uchar> br_index::child_chars(br_sample const& sample) const
 {
     std::vector<uchar> res;
-    for (ulint a = 1; a <= sigma; ++a)
+    for (auto const& ext : right_extensions(sample,false))
     {
-        range_t rangeR = LFR(sample.rangeR,a);
-        if (rangeR.second+1-rangeR.first > 0) res.push_back(remap_inv[a]);
+        res.push_back(ext.first);
     }
     return res;
 }
 
 // suffix tree op: letter(v,i)
-uchar br_index::letter(br_sample const& sample, ulint i)
+uchar br_index::letter(br_sample const& sample, ulint i) const
 {
-    assert(i < sample.len || (sample.is_leaf() && i < bwt.size() - (sample.j-sample.d)));
+    assert(i < sample.len || (sample.is_leaf() && i < n - (sample.j-sample.d)));
     if ((i<<1) <= sample.len)
     {
         ulint p = sample.range.first;
@@ -1295,7 +2549,7 @@ uchar br_index::letter(br_sample const& sample, ulint i)
         }
         return remap_inv[bwtR[p]];
     }
-    else // sample.is_leaf() && i < bwt.size() - (sample.j-sample.d)
+    else // sample.is_leaf() && i < n - (sample.j-sample.d)
     {
         ulint p = sample.rangeR.first;
         for (ulint k = 0; k < i - sample.len; ++k)
@@ -1314,7 +2568,7 @@ uchar br_index::letter(br_sample const& sample, ulint i)
 
 
 // node label
-std::string br_index::label(br_sample const& sample)
+std::string br_index::label(br_sample const& sample) const
 {
     std::string res;
     ulint p = sample.range.first;
@@ -1327,10 +2581,20 @@ std::string br_index::label(br_sample const& sample)
 }
 
 
-ulint br_index::serialize(std::ostream& out)
+ulint br_index::serialize(std::ostream& out) const
 {
+    require(profile_sections(LOAD_FULL), "serialize");
+
     ulint w_bytes = 0;
 
+    // offsets of the sections, written as a table at the end
+    // taken from the stream position when the stream has one
+    std::vector<ulint> offsets(SEC_KMER + 2*length, 0);
+    std::streampos start = out.tellp();
+    auto offset = [&]() -> ulint {
+        return start != std::streampos(-1) ? (ulint)(out.tellp() - start) : w_bytes;
+    };
+
     out.write((char*)&sigma,sizeof(sigma));
     out.write((char*)&length,sizeof(length));
 
@@ -1347,37 +2611,93 @@ ulint br_index::serialize(std::ostream& out)
                 + sizeof(last_SA_val)
                 + 256*sizeof(ulint);
     
+    offsets[SEC_BWT] = offset();
     w_bytes += bwt.serialize(out);
+    offsets[SEC_BWTR] = offset();
     w_bytes += bwtR.serialize(out);
 
+    offsets[SEC_SAMPLES_FIRST] = offset();
     w_bytes += samples_first.serialize(out);
+    offsets[SEC_SAMPLES_LAST] = offset();
     w_bytes += samples_last.serialize(out);
 
+    offsets[SEC_FIRST] = offset();
     w_bytes += first.serialize(out);
+    offsets[SEC_FIRST_TO_RUN] = offset();
     w_bytes += first_to_run.serialize(out);
 
+    offsets[SEC_LAST] = offset();
     w_bytes += last.serialize(out);
+    offsets[SEC_LAST_TO_RUN] = offset();
     w_bytes += last_to_run.serialize(out);
 
+    offsets[SEC_SAMPLES_FIRSTR] = offset();
     w_bytes += samples_firstR.serialize(out);
+    offsets[SEC_SAMPLES_LASTR] = offset();
     w_bytes += samples_lastR.serialize(out);
 
+    offsets[SEC_FIRSTR] = offset();
     w_bytes += firstR.serialize(out);
+    offsets[SEC_FIRST_TO_RUNR] = offset();
     w_bytes += first_to_runR.serialize(out);
 
+    offsets[SEC_LASTR] = offset();
     w_bytes += lastR.serialize(out);
+    offsets[SEC_LAST_TO_RUNR] = offset();
     w_bytes += last_to_runR.serialize(out);
 
+    offsets[SEC_PLCP] = offset();
     w_bytes += plcp.serialize(out);
+    offsets[SEC_PLCPR] = offset();
     w_bytes += plcpR.serialize(out);
 
     for (ulint k = 0; k < length; ++k)
     {
+        offsets[SEC_KMER+2*k] = offset();
         w_bytes += kmer[k].serialize(out);
 
+        offsets[SEC_KMER+2*k+1] = offset();
         w_bytes += kmerR[k].serialize(out);
     }
 
+    // optional, empty if not built
+    offsets[SEC_PHI_MOVE] = offset();
+    w_bytes += phi_move.serialize(out);
+    offsets[SEC_PHII_MOVE] = offset();
+    w_bytes += phiI_move.serialize(out);
+
+    offsets[SEC_FIRST_PLCP] = offset();
+    w_bytes += first_plcp.serialize(out);
+    offsets[SEC_LAST_PLCP] = offset();
+    w_bytes += last_plcp.serialize(out);
+    offsets[SEC_FIRSTR_PLCP] = offset();
+    w_bytes += firstR_plcp.serialize(out);
+    offsets[SEC_LASTR_PLCP] = offset();
+    w_bytes += lastR_plcp.serialize(out);
+    offsets[SEC_PHI_MOVE_PLCP] = offset();
+    w_bytes += phi_move_plcp.serialize(out);
+    offsets[SEC_PHII_MOVE_PLCP] = offset();
+    w_bytes += phiI_move_plcp.serialize(out);
+
+    // optional, empty if not built
+    offsets[SEC_LCP_PSV] = offset();
+    w_bytes += psv.serialize(out);
+    offsets[SEC_LCP_PSVR] = offset();
+    w_bytes += psvR.serialize(out);
+    offsets[SEC_QGRAM] = offset();
+    w_bytes += qgrams.serialize(out);
+    offsets[SEC_MS_THRESHOLDS] = offset();
+    w_bytes += thresholds.serialize(out);
+
+    // section table: #sections, offsets, offset of the table, magic number
+    ulint table_offset = offset();
+    ulint sections = offsets.size();
+    out.write((char*)&sections,sizeof(sections));
+    out.write((char*)offsets.data(),sections*sizeof(ulint));
+    out.write((char*)&table_offset,sizeof(table_offset));
+    out.write((char*)&SECTION_TABLE_MAGIC,sizeof(SECTION_TABLE_MAGIC));
+
+    w_bytes += (sections + 3) * sizeof(ulint);
 
     return w_bytes;
 
@@ -1385,69 +2705,162 @@ ulint br_index::serialize(std::ostream& out)
 
 void br_index::load(std::istream& in)
 {
+    load(in, LOAD_FULL);
+}
 
-    in.read((char*)&sigma,sizeof(sigma));
-    in.read((char*)&length,sizeof(length));
+void br_index::load(std::istream& in, ulint bl)
+{
+    load(in, LOAD_FULL, (int)bl);
+}
 
-    remap = std::vector<uchar>(256);
-    in.read((char*)remap.data(),256*sizeof(uchar));
-    remap_inv = std::vector<uchar>(256);
-    in.read((char*)remap_inv.data(),256*sizeof(uchar));
-    
-    in.read((char*)&last_SA_val,sizeof(last_SA_val));
-    
-    F = std::vector<ulint>(256);
-    in.read((char*)F.data(),256*sizeof(ulint));
+/*
+ * load the components of the given profile
+ * with a section table only those are read, older index files and streams
+ * that cannot seek are read entirely and the other components are released
+ * afterwards
+ */
+void br_index::load(std::istream& in, load_profile profile, int bl)
+{
 
-    bwt.load(in);
-    bwtR.load(in);
-    r = bwt.number_of_runs();
-    rR = bwtR.number_of_runs();
+    std::streampos base = in.tellg();
+    std::vector<ulint> table;
+    if (base != std::streampos(-1)) table = read_section_table(in);
 
-    samples_first.load(in);
-    samples_last.load(in);
+    ulint file_length = load_header(in, bl);
+    ulint sections = profile_sections(profile);
 
-    first.load(in);
-    first_to_run.load(in);
+    if (table.size() != SEC_KMER + 2*file_length)
+    {
+        load_sequential(in, file_length);
+        release_sections(~sections);
+    }
+    else
+    {
+        // position at section sec if it belongs to the profile
+        auto want = [&](ulint sec) {
+            ulint bit = sec < SEC_KMER ? sec : SEC_KMER + (sec - SEC_KMER) % 2;
+            if (!(sections & section_bit(bit))) return false;
+            in.seekg(base + (std::streamoff)table[sec]);
+            return true;
+        };
 
-    last.load(in);
-    last_to_run.load(in);
+        if (want(SEC_BWT)) bwt.load(in);
+        if (want(SEC_BWTR)) bwtR.load(in);
 
-    samples_firstR.load(in);
-    samples_lastR.load(in);
+        if (want(SEC_SAMPLES_FIRST)) samples_first.load(in);
+        if (want(SEC_SAMPLES_LAST)) samples_last.load(in);
 
-    firstR.load(in);
-    first_to_runR.load(in);
+        if (want(SEC_FIRST)) first.load(in);
+        if (want(SEC_FIRST_TO_RUN)) first_to_run.load(in);
 
-    lastR.load(in);
-    last_to_runR.load(in);
-    
-    plcp.load(in);
-    plcpR.load(in);
+        if (want(SEC_LAST)) last.load(in);
+        if (want(SEC_LAST_TO_RUN)) last_to_run.load(in);
 
-    kmer.resize(length);
-    kmerR.resize(length);
-    for (ulint k = 0; k < length; ++k)
+        if (want(SEC_SAMPLES_FIRSTR)) samples_firstR.load(in);
+        if (want(SEC_SAMPLES_LASTR)) samples_lastR.load(in);
+
+        if (want(SEC_FIRSTR)) firstR.load(in);
+        if (want(SEC_FIRST_TO_RUNR)) first_to_runR.load(in);
+
+        if (want(SEC_LASTR)) lastR.load(in);
+        if (want(SEC_LAST_TO_RUNR)) last_to_runR.load(in);
+
+        if (want(SEC_PLCP)) plcp.load(in);
+        if (want(SEC_PLCPR)) plcpR.load(in);
+
+        kmer.resize(sections & section_bit(SEC_KMER) ? length : 0);
+        kmerR.resize(sections & section_bit(SEC_KMER+1) ? length : 0);
+        for (ulint k = 0; k < length; ++k)
+        {
+            if (want(SEC_KMER+2*k)) kmer[k].load(in);
+            if (want(SEC_KMER+2*k+1)) kmerR[k].load(in);
+        }
+
+        if (want(SEC_PHI_MOVE)) phi_move.load(in);
+        if (want(SEC_PHII_MOVE)) phiI_move.load(in);
+
+        if (want(SEC_FIRST_PLCP)) first_plcp.load(in);
+        if (want(SEC_LAST_PLCP)) last_plcp.load(in);
+        if (want(SEC_FIRSTR_PLCP)) firstR_plcp.load(in);
+        if (want(SEC_LASTR_PLCP)) lastR_plcp.load(in);
+        if (want(SEC_PHI_MOVE_PLCP)) phi_move_plcp.load(in);
+        if (want(SEC_PHII_MOVE_PLCP)) phiI_move_plcp.load(in);
+
+        if (want(SEC_LCP_PSV)) psv.load(in);
+        if (want(SEC_LCP_PSVR)) psvR.load(in);
+        if (want(SEC_QGRAM)) qgrams.load(in);
+        if (want(SEC_MS_THRESHOLDS)) thresholds.load(in);
+
+        loaded_sections = sections;
+
+        // the section table closes the index
+        in.seekg(0, std::ios::end);
+    }
+
+    n = bwtR.size();
+    r = bwt.size() > 0 ? bwt.number_of_runs() : samples_last.size();
+    rR = bwtR.number_of_runs();
+
+}
+
+/*
+ * offsets of the sections, empty if the index has no section table
+ * the stream is left at its current position
+ */
+std::vector<ulint> br_index::read_section_table(std::istream& in)
+{
+    std::vector<ulint> table;
+
+    std::streampos base = in.tellg();
+    in.seekg(0, std::ios::end);
+    std::streampos end = in.tellg();
+
+    if (end != std::streampos(-1) && end - base >= (std::streamoff)(2*sizeof(ulint)))
     {
-        kmer[k].load(in);
+        ulint table_offset = 0, magic = 0;
+        in.seekg(end - (std::streamoff)(2*sizeof(ulint)));
+        in.read((char*)&table_offset,sizeof(table_offset));
+        in.read((char*)&magic,sizeof(magic));
 
-        kmerR[k].load(in);
+        if (in && magic == SECTION_TABLE_MAGIC && (std::streamoff)table_offset < end - base)
+        {
+            ulint sections = 0;
+            in.seekg(base + (std::streamoff)table_offset);
+            in.read((char*)&sections,sizeof(sections));
+            if (in && (sections + 3) * sizeof(ulint) == (ulint)(end - base) - table_offset)
+            {
+                table.resize(sections);
+                in.read((char*)table.data(),sections*sizeof(ulint));
+                if (!in) table.clear();
+            }
+        }
     }
 
+    in.clear();
+    in.seekg(base);
+    return table;
 }
-void br_index::load(std::istream& in, ulint bl)
+
+/*
+ * sigma, bl, remap, last_SA_val & F
+ * bl >= 0 overrides the index file's bl, which is returned
+ */
+ulint br_index::load_header(std::istream& in, int bl)
 {
 
     in.read((char*)&sigma,sizeof(sigma));
     in.read((char*)&length,sizeof(length));
 
-    if (bl > length) {
-        perror("br_index load error. Given bl is larger than idx file's parameter.");
-        exit(1);
+    ulint file_length = length;
+    if (bl >= 0)
+    {
+        if ((ulint)bl > length) {
+            perror("br_index load error. Given bl is larger than idx file's parameter.");
+            exit(1);
+        }
+        length = bl;
     }
 
-    length = bl;
-
     remap = std::vector<uchar>(256);
     in.read((char*)remap.data(),256*sizeof(uchar));
     remap_inv = std::vector<uchar>(256);
@@ -1458,8 +2871,20 @@ void br_index::load(std::istream& in, ulint bl)
     F = std::vector<ulint>(256);
     in.read((char*)F.data(),256*sizeof(ulint));
 
+    return file_length;
+
+}
+
+/*
+ * all the components after the header, in file order
+ * (index files without section table, or streams that cannot seek)
+ */
+void br_index::load_sequential(std::istream& in, ulint file_length)
+{
+
     bwt.load(in);
     bwtR.load(in);
+    n = bwt.size();
     r = bwt.number_of_runs();
     rR = bwtR.number_of_runs();
 
@@ -1491,12 +2916,166 @@ void br_index::load(std::istream& in, ulint bl)
         kmer[k].load(in);
         kmerR[k].load(in);
     }
+
+    // skip unused shortcut bitvectors to reach the move structures
+    for (ulint k = length; k < file_length; ++k)
+    {
+        sparse_bitvector_t skipped;
+        skipped.load(in);
+        skipped.load(in);
+    }
+
+    // absent in index files built without move structures
+    phi_move.load(in);
+    phiI_move.load(in);
+
+    loaded_sections = ~ulint(0);
+
+    // absent in older index files
+    if (in.peek() == EOF)
+    {
+        in.clear();
+        build_plcp_samples();
+        if (has_move_structures())
+        {
+            // rebuild together with their PLCP samples
+            use_move_structures(false);
+            use_move_structures(true);
+        }
+        return;
+    }
+    first_plcp.load(in);
+    last_plcp.load(in);
+    firstR_plcp.load(in);
+    lastR_plcp.load(in);
+    phi_move_plcp.load(in);
+    phiI_move_plcp.load(in);
+
+    // index files with section table, read here when the stream cannot seek
+    if (in.peek() == EOF)
+    {
+        in.clear();
+        return;
+    }
+    psv.load(in);
+    psvR.load(in);
+    qgrams.load(in);
+    thresholds.load(in);
+
+    // step over the section table to leave the stream after the index
+    if (in.peek() == EOF)
+    {
+        in.clear();
+        return;
+    }
+    ulint sections = 0, magic = 0;
+    in.read((char*)&sections,sizeof(sections));
+    in.ignore((std::streamsize)((sections + 1) * sizeof(ulint)));
+    in.read((char*)&magic,sizeof(magic));
+    if (!in || magic != SECTION_TABLE_MAGIC)
+    {
+        perror("br_index load error. Malformed section table.");
+        exit(1);
+    }
+
+}
+
+/*
+ * free the given sections
+ */
+void br_index::release_sections(ulint sections)
+{
+
+    auto drop = [&](ulint sec) { return (sections & section_bit(sec)) != 0; };
+
+    if (drop(SEC_BWT)) bwt = rle_string_t();
+    if (drop(SEC_BWTR)) bwtR = rle_string_t();
+
+    if (drop(SEC_SAMPLES_FIRST)) samples_first = sdsl::int_vector<>();
+    if (drop(SEC_SAMPLES_LAST)) samples_last = sdsl::int_vector<>();
+    if (drop(SEC_FIRST)) first = sparse_bitvector_t();
+    if (drop(SEC_FIRST_TO_RUN)) first_to_run = sdsl::int_vector<>();
+    if (drop(SEC_LAST)) last = sparse_bitvector_t();
+    if (drop(SEC_LAST_TO_RUN)) last_to_run = sdsl::int_vector<>();
+
+    if (drop(SEC_SAMPLES_FIRSTR)) samples_firstR = sdsl::int_vector<>();
+    if (drop(SEC_SAMPLES_LASTR)) samples_lastR = sdsl::int_vector<>();
+    if (drop(SEC_FIRSTR)) firstR = sparse_bitvector_t();
+    if (drop(SEC_FIRST_TO_RUNR)) first_to_runR = sdsl::int_vector<>();
+    if (drop(SEC_LASTR)) lastR = sparse_bitvector_t();
+    if (drop(SEC_LAST_TO_RUNR)) last_to_runR = sdsl::int_vector<>();
+
+    if (drop(SEC_PLCP)) plcp = permuted_lcp<>();
+    if (drop(SEC_PLCPR)) plcpR = permuted_lcp<>();
+
+    if (drop(SEC_KMER)) kmer.clear();
+    if (drop(SEC_KMER+1)) kmerR.clear();
+
+    if (drop(SEC_PHI_MOVE)) phi_move = move_structure();
+    if (drop(SEC_PHII_MOVE)) phiI_move = move_structure();
+
+    if (drop(SEC_FIRST_PLCP)) first_plcp = sdsl::int_vector<>();
+    if (drop(SEC_LAST_PLCP)) last_plcp = sdsl::int_vector<>();
+    if (drop(SEC_FIRSTR_PLCP)) firstR_plcp = sdsl::int_vector<>();
+    if (drop(SEC_LASTR_PLCP)) lastR_plcp = sdsl::int_vector<>();
+    if (drop(SEC_PHI_MOVE_PLCP)) phi_move_plcp = sdsl::int_vector<>();
+    if (drop(SEC_PHII_MOVE_PLCP)) phiI_move_plcp = sdsl::int_vector<>();
+
+    if (drop(SEC_LCP_PSV)) psv = lcp_psv();
+    if (drop(SEC_LCP_PSVR)) psvR = lcp_psv();
+    if (drop(SEC_QGRAM)) qgrams = qgram_table();
+    if (drop(SEC_MS_THRESHOLDS)) thresholds = ms_thresholds();
+
+    loaded_sections &= ~sections;
+
+}
+
+const ulint br_index::SECTION_TABLE_MAGIC;
+
+const ulint br_index::PHI_SECTIONS =
+    section_bit(SEC_SAMPLES_FIRST) | section_bit(SEC_SAMPLES_LAST)
+    | section_bit(SEC_FIRST) | section_bit(SEC_FIRST_TO_RUN)
+    | section_bit(SEC_LAST) | section_bit(SEC_LAST_TO_RUN)
+    | section_bit(SEC_FIRST_PLCP) | section_bit(SEC_LAST_PLCP);
+
+const ulint br_index::PHIR_SECTIONS =
+    section_bit(SEC_SAMPLES_FIRSTR) | section_bit(SEC_SAMPLES_LASTR)
+    | section_bit(SEC_FIRSTR) | section_bit(SEC_FIRST_TO_RUNR)
+    | section_bit(SEC_LASTR) | section_bit(SEC_LAST_TO_RUNR)
+    | section_bit(SEC_FIRSTR_PLCP) | section_bit(SEC_LASTR_PLCP);
+
+ulint br_index::profile_sections(load_profile profile)
+{
+
+    const ulint count = section_bit(SEC_HEADER) | section_bit(SEC_BWTR) | section_bit(SEC_QGRAM);
+
+    const ulint locate = count | PHI_SECTIONS
+        | section_bit(SEC_SAMPLES_FIRSTR) | section_bit(SEC_SAMPLES_LASTR)
+        | section_bit(SEC_PHI_MOVE) | section_bit(SEC_PHII_MOVE)
+        | section_bit(SEC_PHI_MOVE_PLCP) | section_bit(SEC_PHII_MOVE_PLCP);
+
+    const ulint bidirectional = locate | section_bit(SEC_BWT);
+
+    switch (profile)
+    {
+    case LOAD_COUNT: return count;
+    case LOAD_LOCATE: return locate;
+    case LOAD_BIDIRECTIONAL: return bidirectional;
+    default: return ~ulint(0);
+    }
+
+}
+
+void br_index::missing_sections(const char* op) const
+{
+    std::cerr << "br_index error: " << op << " needs index components not loaded by the load profile" << std::endl;
+    exit(1);
 }
 
 /*
  * save index to "{path_prefix}.bri" file
  */
-void br_index::save_to_file(std::string const& path_prefix)
+void br_index::save_to_file(std::string const& path_prefix) const
 {
 
     std::string path = path_prefix + ".bri";
@@ -1522,10 +3101,10 @@ void br_index::load_from_file(std::string const& path)
 /*
  * get stats
  */
-ulint br_index::print_space(ulint fix)
+ulint br_index::print_space(ulint fix) const
 {
 
-    std::cout << "text length           : " << bwt.size() << std::endl;
+    std::cout << "text length           : " << n << std::endl;
     std::cout << "alphabet size         : " << sigma << std::endl;
     std::cout << "number of runs in bwt : " << bwt.number_of_runs() << std::endl;
     std::cout << "numbef of runs in bwtR: " << bwtR.number_of_runs() << std::endl << std::endl;
@@ -1606,21 +3185,60 @@ ulint br_index::print_space(ulint fix)
 
     std::cout << "kmer, kmerR: ";
     ulint kmer_bytes = 0;
-    for (ulint k = 0; k < fix; ++k)
+    // kmer/kmerR are empty when not loaded by the load profile
+    for (ulint k = 0; k < fix && k < kmer.size(); ++k)
     {
         bytes =  kmer[k].serialize(out);
         kmer_bytes += bytes;
         tot_bytes += bytes;
-
+    }
+    for (ulint k = 0; k < fix && k < kmerR.size(); ++k)
+    {
         bytes =  kmerR[k].serialize(out);
         kmer_bytes += bytes;
         tot_bytes += bytes;
     }
     std::cout << kmer_bytes << " bytes" << std::endl;
 
+    bytes = first_plcp.serialize(out) + last_plcp.serialize(out)
+          + firstR_plcp.serialize(out) + lastR_plcp.serialize(out);
+    tot_bytes += bytes;
+    std::cout << "plcp samples:   " << bytes << " bytes" << std::endl;
+
+    if (has_move_structures())
+    {
+        tot_bytes += phi_move.print_space();
+        tot_bytes += phiI_move.print_space();
+
+        bytes = phi_move_plcp.serialize(out) + phiI_move_plcp.serialize(out);
+        tot_bytes += bytes;
+        std::cout << "plcp samples (move): " << bytes << " bytes" << std::endl;
+    }
+
+    if (has_lcp_psv())
+    {
+        bytes = psv.get_space() + psvR.get_space();
+        tot_bytes += bytes;
+        std::cout << "lcp psv/nsv (" << psv.number_of_blocks() << " + " << psvR.number_of_blocks() << " blocks): " << bytes << " bytes" << std::endl;
+    }
+
+    if (qgram_length() > 0)
+    {
+        bytes = qgrams.get_space();
+        tot_bytes += bytes;
+        std::cout << "q-gram table (q = " << qgram_length() << ", " << qgrams.size() << " q-grams): " << bytes << " bytes" << std::endl;
+    }
+
+    if (has_ms_thresholds())
+    {
+        bytes = thresholds.get_space();
+        tot_bytes += bytes;
+        std::cout << "matching statistics thresholds: " << bytes << " bytes" << std::endl;
+    }
+
 
     std::cout << "<total space of br-index>: " << tot_bytes << " bytes" << std::endl << std::endl;
-    std::cout << "<bits/symbol>            : " << (double) tot_bytes * 8 / (double) bwt.size() << std::endl;
+    std::cout << "<bits/symbol>            : " << (double) tot_bytes * 8 / (double) n << std::endl;
 
     return tot_bytes;
 
@@ -1629,7 +3247,7 @@ ulint br_index::print_space(ulint fix)
 /*
  * get space complexity
  */
-ulint br_index::get_space()
+ulint br_index::get_space() const
 {
 
     ulint tot_bytes = sizeof(sigma)
@@ -1666,13 +3284,29 @@ ulint br_index::get_space()
     tot_bytes += last_to_runR.serialize(out);
 
 
-    for (ulint k = 0; k < length; ++k)
-    {
+    for (ulint k = 0; k < kmer.size(); ++k)
         tot_bytes += kmer[k].serialize(out);
-
+    for (ulint k = 0; k < kmerR.size(); ++k)
         tot_bytes += kmerR[k].serialize(out);
+
+    tot_bytes += first_plcp.serialize(out);
+    tot_bytes += last_plcp.serialize(out);
+    tot_bytes += firstR_plcp.serialize(out);
+    tot_bytes += lastR_plcp.serialize(out);
+
+    if (has_move_structures())
+    {
+        tot_bytes += phi_move.get_space();
+        tot_bytes += phiI_move.get_space();
+        tot_bytes += phi_move_plcp.serialize(out);
+        tot_bytes += phiI_move_plcp.serialize(out);
     }
 
+    tot_bytes += psv.get_space();
+    tot_bytes += psvR.get_space();
+    tot_bytes += qgrams.get_space();
+    tot_bytes += thresholds.get_space();
+
     return tot_bytes;
 
 }
@@ -1680,7 +3314,7 @@ ulint br_index::get_space()
 /*
  * get string representation of BWT
  */
-std::string br_index::get_bwt(bool reversed)
+std::string br_index::get_bwt(bool reversed) const
 {
     if (!reversed)
     {
@@ -0,0 +1,568 @@
+#include <unistd.h>
+
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <algorithm>
+
+#include "br_index.hpp"
+
+using namespace bri;
+using namespace std;
+
+using hrclock=chrono::high_resolution_clock;
+using chrono::duration_cast;
+using chrono::nanoseconds;
+using chrono::microseconds;
+
+// struct containing command line parameters and other globals
+struct Args {
+    string mode = "";
+    int bl = -1;
+    string idx_file = "";
+    string text_file = "";
+    ulint n = 1000; // number of sampled substrings
+    ulint m = 32;   // length of sampled substrings
+    ulint seed = 0;
+    ulint block = 0; // block size of the LCP smaller value samples
+};
+
+void print_help(char** argv, Args &args) {
+    std::cout << "Usage: " << argv[0] << " ext    <index file> <text file> [options]" << std::endl;
+    std::cout << "       " << argv[0] << " locate <index file> <text file> [options]" << std::endl;
+    std::cout << "       " << argv[0] << " batch  <index file> <text file> [options]" << std::endl;
+    std::cout << "       " << argv[0] << " mems   <index file> <text file> [options]" << std::endl;
+    std::cout << "       " << argv[0] << " ms     <index file> <text file> [options]" << std::endl;
+    std::cout << "       " << argv[0] << " treeop <index file> <text file> [options]" << std::endl;
+    std::cout << "Benchmark br-index operations on substrings sampled from the indexed text." << std::endl;
+    std::cout << "- ext measures per-step latency of extensions & contractions against sigma." << std::endl;
+    std::cout << "- locate compares locate throughput of predecessor-search Phi and move structures." << std::endl;
+    std::cout << "- batch compares one-by-one count & locate with count_batch & locate_batch for several group sizes." << std::endl;
+    std::cout << "- mems times MEMs of mutated substrings with and without LCP smaller value samples, for bl = 0..L." << std::endl;
+    std::cout << "- ms times matching statistics of mutated substrings by extensions & contractions and by thresholds." << std::endl;
+    std::cout << "- treeop times suffix tree operations on the ancestors of random leaves (as experiment_archive's x_treeop)," << std::endl
+              << "  stepping along edges and jumping over them with LCP smaller value samples." << std::endl;
+
+    std::cout << std::endl << "  Options: " << std::endl
+        << "\t-b B\tblock size of the LCP smaller value samples (mems, ms, treeop), def. n/r" << std::endl
+        << "\t-h  \tshow help and exit" << std::endl
+        << "\t-l L\tparameter bl for contraction shortcut, def. index file's bl" << std::endl
+        << "\t-n N\tnumber of sampled substrings, def. " << args.n << std::endl
+        << "\t-m M\tlength of sampled substrings, def. " << args.m << std::endl
+        << "\t-s S\tseed of the random generator, def. " << args.seed << std::endl;
+    exit(1);
+}
+
+void parse_args( int argc, char** argv, Args& arg ) {
+    int c;
+    extern char *optarg;
+    extern int optind;
+
+    puts("==== Command line:");
+    for(int i=0;i<argc;i++)
+        printf(" %s",argv[i]);
+    puts("");
+
+    std::string sarg;
+    while ((c = getopt( argc, argv, "b:l:n:m:s:h") ) != -1) {
+        switch(c) {
+            case 'b':
+            sarg.assign( optarg );
+            arg.block = stoul( sarg ); break;
+            case 'l':
+            sarg.assign( optarg );
+            arg.bl = stoi( sarg ); break;
+            case 'n':
+            sarg.assign( optarg );
+            arg.n = stoul( sarg ); break;
+            case 'm':
+            sarg.assign( optarg );
+            arg.m = stoul( sarg ); break;
+            case 's':
+            sarg.assign( optarg );
+            arg.seed = stoul( sarg ); break;
+            case 'h':
+            print_help(argv, arg); exit(1);
+            case '?':
+            cout << "Unknown option. Use -h for help." << endl;
+            exit(1);
+        }
+    }
+    if (argc == optind+3 && (strcmp(argv[optind],"ext")==0 || strcmp(argv[optind],"locate")==0 || strcmp(argv[optind],"batch")==0 || strcmp(argv[optind],"mems")==0 || strcmp(argv[optind],"ms")==0 || strcmp(argv[optind],"treeop")==0))
+    {
+        arg.mode.assign(argv[optind]);
+        arg.idx_file.assign(argv[optind+1]);
+        arg.text_file.assign(argv[optind+2]);
+    }
+    else
+    {
+        std::cout << "Invalid command line arguments" << std::endl;
+        print_help(argv,arg);
+    }
+    if (arg.m == 0) {
+        cout << "m must be positive integer" << endl;
+        exit(1);
+    }
+}
+
+// substrings of length m starting at random text positions
+vector<string> sample_substrings(Args& args, string const& text)
+{
+    vector<string> res;
+    if (text.size() < args.m) return res;
+
+    mt19937 engine(args.seed);
+    uniform_int_distribution<ulint> dist(0,text.size()-args.m);
+    for (ulint i = 0; i < args.n; ++i)
+        res.push_back(text.substr(dist(engine),args.m));
+    return res;
+}
+
+double per_op(ulint ns, ulint ops)
+{
+    return ops == 0 ? 0.0 : (double)ns / ops;
+}
+
+void bench_ext(Args& args, br_index const& idx, string const& text)
+{
+    auto patterns = sample_substrings(args, text);
+    ulint sigma = idx.alphabet_size();
+
+    cout << "sigma: " << sigma << endl;
+    cout << "Sampled substrings: " << patterns.size() << " x " << args.m << " chars" << endl;
+
+    ulint lext_ns = 0, rext_ns = 0, lcont_ns = 0, rcont_ns = 0;
+    ulint lext_ops = 0, rext_ops = 0, lcont_ops = 0, rcont_ops = 0;
+
+    // SA ranges visited by the extensions, reused for the acc comparison
+    vector<range_t> ranges;
+
+    for (auto const& p : patterns)
+    {
+        br_sample sample(idx.get_initial_sample());
+        for (ulint i = p.size(); i-- > 0;)
+        {
+            auto t1 = hrclock::now();
+            sample = idx.left_extension(sample, p[i]);
+            auto t2 = hrclock::now();
+            lext_ns += duration_cast<nanoseconds>(t2-t1).count();
+            lext_ops++;
+            ranges.push_back(sample.range);
+        }
+        while (sample.len > 0)
+        {
+            auto t1 = hrclock::now();
+            sample = idx.left_contraction(sample);
+            auto t2 = hrclock::now();
+            lcont_ns += duration_cast<nanoseconds>(t2-t1).count();
+            lcont_ops++;
+        }
+
+        sample = idx.get_initial_sample();
+        for (ulint i = 0; i < p.size(); ++i)
+        {
+            auto t1 = hrclock::now();
+            sample = idx.right_extension(sample, p[i]);
+            auto t2 = hrclock::now();
+            rext_ns += duration_cast<nanoseconds>(t2-t1).count();
+            rext_ops++;
+        }
+        while (sample.len > 0)
+        {
+            auto t1 = hrclock::now();
+            sample = idx.right_contraction(sample);
+            auto t2 = hrclock::now();
+            rcont_ns += duration_cast<nanoseconds>(t2-t1).count();
+            rcont_ops++;
+        }
+    }
+
+    cout << "left_extension   : " << per_op(lext_ns,lext_ops) << " ns/step" << endl;
+    cout << "right_extension  : " << per_op(rext_ns,rext_ops) << " ns/step" << endl;
+    cout << "left_contraction : " << per_op(lcont_ns,lcont_ops) << " ns/step" << endl;
+    cout << "right_contraction: " << per_op(rcont_ns,rcont_ops) << " ns/step" << endl;
+
+    // acc = #characters smaller than c in a range, for every remapped c
+    // naive: one LF per character a < c (two ranks each)
+    ulint naive_ns = 0, fast_ns = 0, evals = 0;
+    for (auto const& rn : ranges)
+    {
+        for (ulint c = 2; c <= sigma+1; ++c)
+        {
+            auto t1 = hrclock::now();
+            ulint acc = 0;
+            for (ulint a = 1; a < c; ++a)
+            {
+                range_t smaller_range = idx.LF(rn,(uchar)a);
+                acc += (smaller_range.second+1) - smaller_range.first;
+            }
+            auto t2 = hrclock::now();
+            ulint acc2 = idx.count_smaller(rn,(uchar)c);
+            auto t3 = hrclock::now();
+
+            if (acc != acc2)
+            {
+                cerr << "Error: count_smaller mismatch on range [" << rn.first << "," << rn.second << "]" << endl;
+                exit(1);
+            }
+            naive_ns += duration_cast<nanoseconds>(t2-t1).count();
+            fast_ns += duration_cast<nanoseconds>(t3-t2).count();
+            evals++;
+        }
+    }
+
+    cout << "acc (LF per char): " << per_op(naive_ns,evals) << " ns/eval" << endl;
+    cout << "acc (count_smaller): " << per_op(fast_ns,evals) << " ns/eval" << endl;
+}
+
+// total time (us) & number of occurrences of locating all patterns
+pair<ulint,ulint> time_locate(br_index const& idx, vector<br_sample> const& samples, vector<vector<ulint>>& occs)
+{
+    ulint total = 0;
+    occs.clear();
+    auto t1 = hrclock::now();
+    for (auto const& sample : samples)
+    {
+        occs.push_back(idx.locate_sample(sample));
+        total += occs.back().size();
+    }
+    auto t2 = hrclock::now();
+    return {(ulint)duration_cast<microseconds>(t2-t1).count(), total};
+}
+
+void bench_locate(Args& args, br_index& idx, string const& text)
+{
+    auto patterns = sample_substrings(args, text);
+    cout << "Sampled substrings: " << patterns.size() << " x " << args.m << " chars" << endl;
+
+    vector<br_sample> samples;
+    for (auto const& p : patterns) samples.push_back(idx.search(p));
+
+    vector<vector<ulint>> occs_pred, occs_move;
+
+    idx.use_move_structures(false);
+    auto pred = time_locate(idx, samples, occs_pred);
+
+    auto t1 = hrclock::now();
+    idx.use_move_structures(true);
+    auto t2 = hrclock::now();
+    auto mv = time_locate(idx, samples, occs_move);
+
+    for (ulint i = 0; i < samples.size(); ++i)
+    {
+        sort(occs_pred[i].begin(),occs_pred[i].end());
+        sort(occs_move[i].begin(),occs_move[i].end());
+        if (occs_pred[i] != occs_move[i])
+        {
+            cerr << "Error: locate mismatch on pattern " << patterns[i] << endl;
+            exit(1);
+        }
+    }
+
+    cout << "occurrences: " << pred.second << endl;
+    cout << "move structure construction: " << duration_cast<microseconds>(t2-t1).count() << " us" << endl;
+    cout << "locate (predecessor): " << pred.first << " us, "
+         << per_op(pred.first*1000,pred.second) << " ns/occ" << endl;
+    cout << "locate (move)       : " << mv.first << " us, "
+         << per_op(mv.first*1000,mv.second) << " ns/occ" << endl;
+}
+
+// one-by-one vs interleaved count & locate, with both Phi backends
+void bench_batch(Args& args, br_index& idx, string const& text)
+{
+    auto patterns = sample_substrings(args, text);
+    cout << "Sampled substrings: " << patterns.size() << " x " << args.m << " chars" << endl;
+
+    vector<ulint> counts;
+    auto t1 = hrclock::now();
+    for (auto const& p : patterns) counts.push_back(idx.count(p));
+    auto t2 = hrclock::now();
+    cout << "count            : " << duration_cast<microseconds>(t2-t1).count() << " us" << endl;
+
+    for (ulint group : {4, 16, 64})
+    {
+        t1 = hrclock::now();
+        auto batch = idx.count_batch(patterns, group);
+        t2 = hrclock::now();
+        if (batch != counts)
+        {
+            cerr << "Error: count_batch mismatch" << endl;
+            exit(1);
+        }
+        cout << "count_batch (" << group << ")" << string(group < 10 ? 2 : 1, ' ') << ": "
+             << duration_cast<microseconds>(t2-t1).count() << " us" << endl;
+    }
+
+    for (bool move : {false, true})
+    {
+        idx.use_move_structures(move);
+        string backend = move ? "move" : "predecessor";
+
+        vector<vector<ulint>> occs;
+        ulint total = 0;
+        t1 = hrclock::now();
+        for (auto const& p : patterns)
+        {
+            occs.push_back(idx.locate(p));
+            total += occs.back().size();
+        }
+        t2 = hrclock::now();
+        ulint us = duration_cast<microseconds>(t2-t1).count();
+        cout << "locate (" << backend << ")      : " << us << " us, " << per_op(us*1000,total) << " ns/occ" << endl;
+
+        for (ulint group : {4, 16, 64})
+        {
+            t1 = hrclock::now();
+            auto batch = idx.locate_batch(patterns, group);
+            t2 = hrclock::now();
+            if (batch != occs)
+            {
+                cerr << "Error: locate_batch mismatch" << endl;
+                exit(1);
+            }
+            us = duration_cast<microseconds>(t2-t1).count();
+            cout << "locate_batch (" << backend << ", " << group << ")" << string(group < 10 ? 2 : 1, ' ') << ": "
+                 << us << " us, " << per_op(us*1000,total) << " ns/occ" << endl;
+        }
+    }
+}
+
+// sampled substrings with about one mismatch every 16 characters
+vector<string> sample_mutated_substrings(Args& args, string const& text)
+{
+    auto res = sample_substrings(args, text);
+
+    mt19937 engine(args.seed+1);
+    uniform_int_distribution<ulint> pos(0,text.size()-1);
+    uniform_int_distribution<ulint> coin(0,15);
+    for (auto& p : res)
+        for (auto& c : p)
+            if (coin(engine) == 0) c = text[pos(engine)];
+    return res;
+}
+
+// total time (us) of the MEMs of all patterns & the sum of max MEM lengths
+pair<ulint,ulint> time_mems(br_index const& idx, vector<string> const& patterns)
+{
+    ulint total = 0;
+    auto t1 = hrclock::now();
+    for (auto const& p : patterns) total += idx.maximal_exact_match(p);
+    auto t2 = hrclock::now();
+    return {(ulint)duration_cast<microseconds>(t2-t1).count(), total};
+}
+
+void bench_mems(Args& args, br_index& idx, string const& text)
+{
+    auto patterns = sample_mutated_substrings(args, text);
+    cout << "Sampled substrings: " << patterns.size() << " x " << args.m << " chars (mutated)" << endl;
+
+    ulint max_bl = idx.border_length();
+    for (ulint bl = 0; bl <= max_bl; ++bl)
+    {
+        ifstream fidx(args.idx_file);
+        idx.load(fidx, br_index::LOAD_FULL, (int)bl);
+        fidx.close();
+
+        idx.use_lcp_psv(false);
+        auto plain = time_mems(idx, patterns);
+
+        auto t1 = hrclock::now();
+        idx.use_lcp_psv(true,args.block);
+        auto t2 = hrclock::now();
+        auto psv = time_mems(idx, patterns);
+
+        if (plain.second != psv.second)
+        {
+            cerr << "Error: MEM mismatch with bl = " << bl << endl;
+            exit(1);
+        }
+
+        cout << "bl = " << bl << ": "
+             << "MEMs (Phi scan): " << plain.first << " us, "
+             << "MEMs (psv): " << psv.first << " us, "
+             << "psv construction: " << duration_cast<microseconds>(t2-t1).count() << " us" << endl;
+    }
+}
+
+// total time (us) of the matching statistics of all patterns & the sum of their lengths
+// by the MEMs (MS[i] = end of the last MEM starting at or before i - i) or by the thresholds
+pair<ulint,ulint> time_ms(br_index const& idx, vector<string> const& patterns, bool thresholds)
+{
+    ulint total = 0;
+    vector<ulint> lengths, pointers;
+    auto t1 = hrclock::now();
+    for (auto const& p : patterns)
+    {
+        if (thresholds)
+        {
+            idx.matching_statistics(p, lengths, pointers);
+            for (auto l : lengths) total += l;
+            continue;
+        }
+        ulint i = 0, end = 0;
+        idx.maximal_exact_matches(p, 1, 1, [&](ulint offset, br_sample const& sample) {
+            for (; i < offset; ++i) total += end > i ? end - i : 0;
+            end = offset + sample.len;
+        });
+        for (; i < p.size(); ++i) total += end > i ? end - i : 0;
+    }
+    auto t2 = hrclock::now();
+    return {(ulint)duration_cast<microseconds>(t2-t1).count(), total};
+}
+
+void bench_ms(Args& args, br_index& idx, string const& text)
+{
+    auto patterns = sample_mutated_substrings(args, text);
+    cout << "Sampled substrings: " << patterns.size() << " x " << args.m << " chars (mutated)" << endl;
+
+    auto t1 = hrclock::now();
+    idx.use_ms_thresholds(true);
+    auto t2 = hrclock::now();
+    cout << "thresholds construction: " << duration_cast<microseconds>(t2-t1).count() << " us" << endl;
+
+    // the thresholds always need the psv, the extensions & contractions are timed without it too
+    idx.use_lcp_psv(true,args.block);
+    auto thr = time_ms(idx, patterns, true);
+
+    for (bool psv : {false, true})
+    {
+        idx.use_lcp_psv(psv,args.block);
+        auto ext = time_ms(idx, patterns, false);
+
+        if (ext.second != thr.second)
+        {
+            cerr << "Error: matching statistics mismatch" << endl;
+            exit(1);
+        }
+
+        cout << (psv ? "with psv   : " : "without psv: ")
+             << "MS (extensions & contractions): " << ext.first << " us" << endl;
+    }
+    cout << "MS (thresholds): " << thr.first << " us" << endl;
+}
+
+// ns per operation of parent, fchild, nsibling, child & lca on the ancestors of random leaves
+struct treeop_times {
+    ulint visited = 0;
+    ulint parent = 0, fchild = 0, nsibling = 0, child = 0, lca = 0;
+    ulint checksum = 0;
+};
+
+treeop_times time_treeop(Args& args, br_index const& idx, string const& text)
+{
+    treeop_times res;
+
+    mt19937 engine(args.seed);
+    uniform_int_distribution<ulint> dist(0,text.size()-1);
+
+    for (ulint i = 0; i < args.n; ++i)
+    {
+        // a random leaf & a random other node for lca
+        ulint pos = dist(engine);
+        br_sample v = idx.get_initial_sample();
+        for (ulint k = pos; k < text.size() && !v.is_leaf(); ++k) v = idx.right_extension(v,text[k]);
+        br_sample w = idx.search(text.substr(dist(engine) % (text.size()-1), 2));
+
+        while (v.len > 0)
+        {
+            auto t1 = hrclock::now();
+            auto fc = idx.fchild(v);
+            auto t2 = hrclock::now();
+            auto sib = idx.nsibling(v);
+            auto t3 = hrclock::now();
+            auto anc = idx.lca(v,w);
+            auto t4 = hrclock::now();
+            auto par = idx.parent(v);
+            auto t5 = hrclock::now();
+            auto ch = idx.child(par,text[pos+par.len]);
+            auto t6 = hrclock::now();
+
+            res.fchild += duration_cast<nanoseconds>(t2-t1).count();
+            res.nsibling += duration_cast<nanoseconds>(t3-t2).count();
+            res.lca += duration_cast<nanoseconds>(t4-t3).count();
+            res.parent += duration_cast<nanoseconds>(t5-t4).count();
+            res.child += duration_cast<nanoseconds>(t6-t5).count();
+            res.visited++;
+
+            res.checksum += fc.len + sib.len + anc.len + par.len + ch.len + ch.range.first;
+            v = par;
+        }
+    }
+    return res;
+}
+
+void bench_treeop(Args& args, br_index& idx, string const& text)
+{
+    cout << "Random leaves: " << args.n << endl;
+
+    idx.use_lcp_psv(false);
+    auto step = time_treeop(args, idx, text);
+
+    auto t1 = hrclock::now();
+    idx.use_lcp_psv(true,args.block);
+    auto t2 = hrclock::now();
+    auto jump = time_treeop(args, idx, text);
+
+    if (step.checksum != jump.checksum)
+    {
+        cerr << "Error: suffix tree operations mismatch" << endl;
+        exit(1);
+    }
+
+    cout << "visited nodes: " << step.visited << endl;
+    cout << "psv construction: " << duration_cast<microseconds>(t2-t1).count() << " us" << endl;
+    cout << "            step / jump (ns/op)" << endl;
+    cout << "parent   : " << per_op(step.parent,step.visited) << " / " << per_op(jump.parent,jump.visited) << endl;
+    cout << "child    : " << per_op(step.child,step.visited) << " / " << per_op(jump.child,jump.visited) << endl;
+    cout << "fchild   : " << per_op(step.fchild,step.visited) << " / " << per_op(jump.fchild,jump.visited) << endl;
+    cout << "nsibling : " << per_op(step.nsibling,step.visited) << " / " << per_op(jump.nsibling,jump.visited) << endl;
+    cout << "lca      : " << per_op(step.lca,step.visited) << " / " << per_op(jump.lca,jump.visited) << endl;
+}
+
+int main(int argc, char** argv)
+{
+    Args args;
+    parse_args(argc, argv, args);
+
+    cout << "Loading br-index ... " << flush;
+
+    br_index idx;
+    ifstream fidx(args.idx_file);
+    if (!fidx.is_open()) {
+        cerr << "Cannot open index file: " << args.idx_file << endl;
+        exit(1);
+    }
+    if (args.bl == -1) idx.load(fidx);
+    else idx.load(fidx,args.bl);
+    fidx.close();
+
+    cout << "done." << endl;
+
+    ifstream ft(args.text_file);
+    if (!ft.is_open()) {
+        cerr << "Cannot open text file: " << args.text_file << endl;
+        exit(1);
+    }
+    string text((istreambuf_iterator<char>(ft)), istreambuf_iterator<char>());
+    ft.close();
+
+    if (args.mode == "ext") {
+        bench_ext(args,idx,text);
+    }
+    else if (args.mode == "locate") {
+        bench_locate(args,idx,text);
+    }
+    else if (args.mode == "batch") {
+        bench_batch(args,idx,text);
+    }
+    else if (args.mode == "mems") {
+        bench_mems(args,idx,text);
+    }
+    else if (args.mode == "ms") {
+        bench_ms(args,idx,text);
+    }
+    else if (args.mode == "treeop") {
+        bench_treeop(args,idx,text);
+    }
+}
@@ -128,36 +128,36 @@ void locate_all(Args& args, ifstream& in, string pattern_file)
 
     t3 = high_resolution_clock::now();
 
-    idx.maximal_exact_match(p);
+    ulint max_l = 0;
+    ulint mems = idx.maximal_exact_matches(p, 1, 1, [&](ulint, br_sample const& sample) {
+        if (sample.len > max_l) max_l = sample.len;
+        occ_tot += idx.count_sample(sample);
+    });
 
     t4 = high_resolution_clock::now();
 
     tot_time += duration_cast<microseconds>(t4-t3).count();
 
+    cout << "number of MEMs : " << mems << endl;
+    cout << "max length of MEMs : " << max_l << endl;
+    cout << "number of MEM occs : " << occ_tot << endl;
 
-    /*if (c) // check occurrences
+    if (c) // check occurrences
     {
-        cout << "length of MEM : " << res.first << endl;
-        cout << "number of MEM occs : " << occs.size() << endl;
-        ulint maxlen = res.first;
-        for (auto pair: res.second)
-        {
-            ulint offset = pair.first;
-            auto occs = idx.locate_sample(pair.second);
-            for (auto o: occs)
-            {
-                for (ulint i = 0; i < maxlen; ++i)
+        ulint wrong = 0;
+        idx.maximal_exact_matches(p, 1, 1, [&](ulint offset, br_sample const& sample) {
+            idx.locate_sample(sample, [&](ulint o) {
+                bool ok = o + sample.len <= text.size() && text.compare(o, sample.len, p, offset, sample.len) == 0;
+                if (!ok)
                 {
-                    if (text[o+i] != p[i+offset])
-                    {
-                        cout << "wrong occurrence  occ: " << o << " offset on P: " << offset << endl;
-                    }
+                    cout << "wrong occurrence  occ: " << o << " offset on P: " << offset << endl;
+                    wrong++;
                 }
-            }
-        }
-    }*/
-
-    
+                return true;
+            });
+        });
+        if (wrong == 0) cout << "all MEM occurrences are correct" << endl;
+    }
 
     ulint load = duration_cast<milliseconds>(t2-t1).count();
     cout << "Load time  : " << load << " milliseconds" << endl;
@@ -3,8 +3,10 @@
 #include <iostream>
 #include <chrono>
 #include <cstdlib>
+#include <mutex>
 
 #include "br_index.hpp"
+#include "work_stealing_pool.hpp"
 
 using namespace bri;
 using namespace std;
@@ -24,22 +26,52 @@ struct Args {
     string pattern_file = "";
     int k = -1;
     int t = -1;
+    string phi = ""; // Phi backend, "" = as stored in index file
+    ulint max_occ = 0; // 0 = all occurrences
+    string format = ""; // batch mode pattern file format, "" = whole file is one pattern
+    ulint threads = 1;
+    string output_file = ""; // batch mode results, "" = stdout
+    bool sa_order = false; // locate in SA order, splitting the SA range at run boundaries
+    bool mem_report = false; // mems reports every MEM instead of the max length
+    ulint mem_min_len = 1;
+    ulint mem_min_occ = 1;
+    bool mem_positions = false;
 };
 
 void print_help(char** argv, Args &args) {
     std::cout << "Usage: " << argv[0] << " count  <index file> <pattern file> [options]" << std::endl;
     std::cout << "       " << argv[0] << " locate <index file> <pattern file> [options]" << std::endl;
     std::cout << "       " << argv[0] << " mems   <index file> <pattern file> [options]" << std::endl;
+    std::cout << "       " << argv[0] << " ms     <index file> <pattern file> [options]" << std::endl;
+    std::cout << "       " << argv[0] << " kmers  <index file> <pattern file> -k K [options]" << std::endl;
     std::cout << "       " << argv[0] << " full   <index file> <k(length)> <t(freq)> [options]" << std::endl;
     std::cout << "Compute searching query on given pattern using br-index." << std::endl;
     std::cout << "- count counts the number of the pattern occurring in the text." << std::endl;
     std::cout << "- locate locates all the starting positions of the pattern occurring in the text." << std::endl;
     std::cout << "- mems computes Maximal Exact Matches on the pattern and the text." << std::endl;
+    std::cout << "- ms computes matching statistics (length & text position of the longest match at each offset) with thresholds." << std::endl;
+    std::cout << "- kmers counts the occurrences of every length-K window of the pattern (k-mer presence & abundance)." << std::endl;
     std::cout << "- full computes full-task (total number of substrings of length at most k and occurring at least t times)" << std::endl;
+    std::cout << "count, locate, mems, ms and kmers take the whole pattern file as one pattern unless -b is given." << std::endl;
+    std::cout << "With -b, they run on every pattern of the file using -t threads and write one result line per pattern" << std::endl;
+    std::cout << " in input order; batch count & locate advance the patterns of each thread in lockstep to overlap cache misses." << std::endl;
+    std::cout << "full splits the top of the suffix trie and hands deep subtrees to idle threads (-t)." << std::endl;
+    std::cout << "count and locate load only the index components they use (a seek each with the index file's section table)." << std::endl;
 
     std::cout << std::endl << "  Options: " << std::endl
+        << "\t-b F\tbatch mode, pattern file holds many patterns in format F: lines, fasta, fastq, pizza (Pizza&Chili) or auto" << std::endl
         << "\t-h  \tshow help and exit" << std::endl
-        << "\t-l L\tparameter bl for contraction shortcut, def. index file's bl" << args.bl << std::endl;
+        << "\t-k K\tkmers window length" << std::endl
+        << "\t-L L\tmems reports only MEMs of length >= L, implies -r, def. " << args.mem_min_len << std::endl
+        << "\t-T T\tmems reports only MEMs occurring >= T times (SMEMs with occurrence threshold), implies -r, def. " << args.mem_min_occ << std::endl
+        << "\t-P  \tmems reports the text positions of each MEM too (at most -n), implies -r" << std::endl
+        << "\t-r  \tmems reports every MEM as <offset> <length> <#occ> [positions] instead of the max length" << std::endl
+        << "\t-l L\tparameter bl for contraction shortcut, def. index file's bl" << args.bl << std::endl
+        << "\t-n N\tlocate (mems -P) reports only the first N occurrences (per MEM), def. all" << std::endl
+        << "\t-o O\tbatch mode (or mems -r, ms, kmers) output file of results, def. stdout" << std::endl
+        << "\t-p P\tPhi backend, move (move structures, built if absent) or pred (predecessor search), def. index file's" << std::endl
+        << "\t-S  \tlocate reports occurrences in SA order, located in segments between BWT run boundaries (by -t threads for one pattern)" << std::endl
+        << "\t-t T\tnumber of threads in batch mode, full and locate -S, def. " << args.threads << std::endl;
     // << "\t-c C\tcheck correctness of each pattern occurrence" << std::endl
     exit(1);
 }
@@ -55,13 +87,42 @@ void parse_args( int argc, char** argv, Args& arg ) {
     puts("");
 
     std::string sarg;
-    while ((c = getopt( argc, argv, "c:l:h") ) != -1) {
+    while ((c = getopt( argc, argv, "b:c:k:l:n:o:p:rt:L:PST:h") ) != -1) {
         switch(c) {
+            case 'b':
+            arg.format.assign(optarg); break;
             case 'c':
             arg.check.assign(optarg); break;
+            case 'k':
+            sarg.assign( optarg );
+            arg.k = stoi( sarg ); break;
             case 'l':
             sarg.assign( optarg );
             arg.bl = stoi( sarg ); break;
+            case 'n':
+            sarg.assign( optarg );
+            arg.max_occ = stoul( sarg ); break;
+            case 'o':
+            arg.output_file.assign(optarg); break;
+            case 'p':
+            arg.phi.assign(optarg); break;
+            case 'r':
+            arg.mem_report = true; break;
+            case 'L':
+            sarg.assign( optarg );
+            arg.mem_min_len = stoul( sarg );
+            arg.mem_report = true; break;
+            case 'S':
+            arg.sa_order = true; break;
+            case 'P':
+            arg.mem_positions = arg.mem_report = true; break;
+            case 'T':
+            sarg.assign( optarg );
+            arg.mem_min_occ = stoul( sarg );
+            arg.mem_report = true; break;
+            case 't':
+            sarg.assign( optarg );
+            arg.threads = stoul( sarg ); break;
             case 'h':
             print_help(argv, arg); exit(1);
             case '?':
@@ -77,7 +138,7 @@ void parse_args( int argc, char** argv, Args& arg ) {
         sarg.assign( argv[optind+3] );
         arg.t = stoi(sarg);
     }
-    else if (argc == optind+3 && (strcmp(argv[optind],"count")==0 || strcmp(argv[optind],"locate")==0 || strcmp(argv[optind],"mems")==0 ))
+    else if (argc == optind+3 && (strcmp(argv[optind],"count")==0 || strcmp(argv[optind],"locate")==0 || strcmp(argv[optind],"mems")==0 || strcmp(argv[optind],"ms")==0 || strcmp(argv[optind],"kmers")==0 ))
     {
         arg.query.assign(argv[optind]);
         arg.idx_file.assign(argv[optind+1]);
@@ -99,13 +160,46 @@ void parse_args( int argc, char** argv, Args& arg ) {
             exit(1);
         }
     }
+    if (arg.query=="kmers" && arg.k <= 0) {
+        cout << "kmers needs a positive window length -k" << endl;
+        exit(1);
+    }
+    if (arg.format != "" && arg.format != "lines" && arg.format != "fasta" && arg.format != "fastq"
+        && arg.format != "pizza" && arg.format != "auto") {
+        cout << "Pattern file format must be lines, fasta, fastq, pizza or auto" << endl;
+        exit(1);
+    }
+    if (arg.format != "" && arg.query == "full") {
+        cout << "Batch mode is available for count, locate, mems, ms and kmers" << endl;
+        exit(1);
+    }
+    if (arg.threads == 0) {
+        cout << "number of threads must be positive integer" << endl;
+        exit(1);
+    }
+    if (arg.sa_order && arg.query != "locate") {
+        cout << "-S is available for locate" << endl;
+        exit(1);
+    }
+    if (arg.mem_report && arg.query != "mems") {
+        cout << "-r, -L, -T and -P are available for mems" << endl;
+        exit(1);
+    }
+    if (arg.mem_min_len == 0 || arg.mem_min_occ == 0) {
+        cout << "MEM length and occurrence thresholds must be positive integers" << endl;
+        exit(1);
+    }
+    if (arg.phi != "" && arg.phi != "move" && arg.phi != "pred") {
+        cout << "Phi backend must be move or pred" << endl;
+        exit(1);
+    }
     //if(arg.bl < 0) {
     //    std::cout << "bl must be nonnegative integer\n";
     //    exit(1);
     //}
 }
 
-void query_count(Args& args, br_index& idx) {
+void query_count(Args& args, br_index const& idx) {
 
     ifstream fp(args.pattern_file);
     if (!fp.is_open()) {
@@ -127,7 +221,7 @@ void query_count(Args& args, br_index& idx) {
     cout << "Elapsed time: " << duration_cast<microseconds>(t4-t3).count() << "(us)" << endl;
 }
 
-void query_locate(Args& args, br_index& idx) {
+void query_locate(Args& args, br_index const& idx) {
 
     ifstream fp(args.pattern_file);
     if (!fp.is_open()) {
@@ -140,12 +234,19 @@ void query_locate(Args& args, br_index& idx) {
     cout << "Locating the pattern ... " << flush;
 
     auto t3 = hrclock::now();
-    auto locations = idx.locate(pattern);
+    vector<ulint> locations;
+    if (args.sa_order) {
+        locations = idx.locate_sa_order(pattern, args.threads);
+        if (args.max_occ > 0 && locations.size() > args.max_occ) locations.resize(args.max_occ);
+    }
+    else if (args.max_occ == 0) locations = idx.locate(pattern);
+    else idx.locate(pattern, [&](ulint occ) { locations.push_back(occ); return locations.size() < args.max_occ; });
     auto t4 = hrclock::now();
 
     cout << "done." << std::endl;
 
-    cout << "#Occurrences: " << locations.size() << endl;
+    if (args.max_occ == 0) cout << "#Occurrences: " << locations.size() << endl;
+    else cout << "#Reported occurrences (at most " << args.max_occ << "): " << locations.size() << endl;
 
     cout << "First min(#Occ,10) locations: ";
     ulint l = locations.size() >= 10 ? 10 : locations.size();
@@ -155,7 +256,112 @@ void query_locate(Args& args, br_index& idx) {
     cout << "Elapsed time: " << duration_cast<microseconds>(t4-t3).count() << "(us)" << endl;
 }
 
-void query_mems(Args& args, br_index& idx) {
+/*
+ * one line "<prefix><offset>\t<length>\t<#occ>[\t<locations...>]" per MEM
+ * returns the number of MEMs
+ */
+ulint write_mems(Args& args, br_index const& idx, string const& pattern, string const& prefix, ostream& out) {
+    return idx.maximal_exact_matches(pattern, args.mem_min_len, args.mem_min_occ, [&](ulint offset, br_sample const& sample) {
+        out << prefix << offset << '\t' << sample.len << '\t' << idx.count_sample(sample);
+        if (args.mem_positions)
+        {
+            ulint reported = 0;
+            idx.locate_sample(sample, [&](ulint occ) {
+                out << '\t' << occ;
+                return args.max_occ == 0 || ++reported < args.max_occ;
+            });
+        }
+        out << '\n';
+    });
+}
+
+/*
+ * one line "<prefix><offset>\t<length>\t<pointer>" per pattern position
+ */
+void write_ms(br_index const& idx, string const& pattern, string const& prefix, ostream& out) {
+    vector<ulint> lengths, pointers;
+    idx.matching_statistics(pattern, lengths, pointers);
+    for (ulint i = 0; i < pattern.size(); ++i)
+        out << prefix << i << '\t' << lengths[i] << '\t' << pointers[i] << '\n';
+}
+
+/*
+ * one line "<prefix><offset>\t<count>" per length-k window
+ * returns the number of windows occurring in the text
+ */
+ulint write_kmers(Args& args, br_index const& idx, string const& pattern, string const& prefix, ostream& out) {
+    return idx.sliding_window(pattern, args.k, [&](ulint offset, ulint cnt, br_sample const&) {
+        out << prefix << offset << '\t' << cnt << '\n';
+    });
+}
+
+void query_kmers(Args& args, br_index const& idx) {
+    ifstream fp(args.pattern_file);
+    if (!fp.is_open()) {
+        cerr << "Cannot open pattern file: " << args.pattern_file << endl;
+        exit(1);
+    }
+    string pattern((istreambuf_iterator<char>(fp)), istreambuf_iterator<char>());
+    fp.close();
+
+    ofstream fout;
+    if (args.output_file != "") {
+        fout.open(args.output_file);
+        if (!fout.is_open()) {
+            cerr << "Cannot open output file: " << args.output_file << endl;
+            exit(1);
+        }
+    }
+    ostream& out = args.output_file != "" ? fout : cout;
+
+    cout << "Counting the " << args.k << "-mers of the pattern ... " << flush;
+    if (args.output_file == "") cout << endl;
+
+    auto t3 = hrclock::now();
+    ulint present = write_kmers(args, idx, pattern, "", out);
+    out << flush;
+    auto t4 = hrclock::now();
+
+    cout << "done." << std::endl;
+
+    ulint windows = pattern.size() >= (ulint)args.k ? pattern.size() - args.k + 1 : 0;
+    cout << "#Occurring k-mers: " << present << " / " << windows << endl;
+    cout << "Elapsed time: " << duration_cast<microseconds>(t4-t3).count() << "(us)" << endl;
+}
+
+void query_ms(Args& args, br_index const& idx) {
+    ifstream fp(args.pattern_file);
+    if (!fp.is_open()) {
+        cerr << "Cannot open pattern file: " << args.pattern_file << endl;
+        exit(1);
+    }
+    string pattern((istreambuf_iterator<char>(fp)), istreambuf_iterator<char>());
+    fp.close();
+
+    ofstream fout;
+    if (args.output_file != "") {
+        fout.open(args.output_file);
+        if (!fout.is_open()) {
+            cerr << "Cannot open output file: " << args.output_file << endl;
+            exit(1);
+        }
+    }
+    ostream& out = args.output_file != "" ? fout : cout;
+
+    cout << "Matching statistics of the pattern ... " << flush;
+    if (args.output_file == "") cout << endl;
+
+    auto t3 = hrclock::now();
+    write_ms(idx, pattern, "", out);
+    out << flush;
+    auto t4 = hrclock::now();
+
+    cout << "done." << std::endl;
+
+    cout << "Elapsed time: " << duration_cast<microseconds>(t4-t3).count() << "(us)" << endl;
+}
+
+void query_mems(Args& args, br_index const& idx) {
     ifstream fp(args.pattern_file);
     if (!fp.is_open()) {
         cerr << "Cannot open pattern file: " << args.pattern_file << endl;
@@ -164,6 +370,32 @@ void query_mems(Args& args, br_index& idx) {
     string pattern((istreambuf_iterator<char>(fp)), istreambuf_iterator<char>());
     fp.close();
 
+    if (args.mem_report) {
+        ofstream fout;
+        if (args.output_file != "") {
+            fout.open(args.output_file);
+            if (!fout.is_open()) {
+                cerr << "Cannot open output file: " << args.output_file << endl;
+                exit(1);
+            }
+        }
+        ostream& out = args.output_file != "" ? fout : cout;
+
+        cout << "MEMs on the pattern and the text ... " << flush;
+        if (args.output_file == "") cout << endl;
+
+        auto t3 = hrclock::now();
+        ulint mems = write_mems(args, idx, pattern, "", out);
+        out << flush;
+        auto t4 = hrclock::now();
+
+        cout << "done." << std::endl;
+
+        cout << "#MEMs: " << mems << endl;
+        cout << "Elapsed time: " << duration_cast<microseconds>(t4-t3).count() << "(us)" << endl;
+        return;
+    }
+
     cout << "MEMs on the pattern and the text ... " << flush;
 
     auto t3 = hrclock::now();
@@ -177,15 +409,151 @@ void query_mems(Args& args, br_index& idx) {
     cout << "Elapsed time: " << duration_cast<microseconds>(t4-t3).count() << "(us)" << endl;
 }
 
-void query_full(Args& args, br_index& idx) {
+/*
+ * batch mode: one result line per pattern, in input order
+ * "<pattern number>\t<count>", "<pattern number>\t<count>\t<locations...>" or "<pattern number>\t<max MEM length>"
+ * kmers writes one line "<pattern number>\t<offset>\t<count>" per k-mer
+ * ms writes one line "<pattern number>\t<offset>\t<length>\t<pointer>" per pattern position
+ * mems -r writes one line "<pattern number>\t<offset>\t<length>\t<#occ>[\t<locations...>]" per MEM instead
+ * patterns are split into chunks processed by a work-stealing pool sharing idx,
+ * count & locate (without -n, -S) run the patterns of a chunk interleaved (count_batch, locate_batch)
+ */
+void query_batch(Args& args, br_index const& idx) {
+
+    cout << "Reading patterns ... " << flush;
+    auto patterns = read_patterns(args.pattern_file, args.format);
+    ulint bases = 0;
+    for (auto const& p : patterns) bases += p.size();
+    cout << "done. " << patterns.size() << " patterns, " << bases << " bases." << endl;
+
+    ofstream fout;
+    if (args.output_file != "") {
+        fout.open(args.output_file);
+        if (!fout.is_open()) {
+            cerr << "Cannot open output file: " << args.output_file << endl;
+            exit(1);
+        }
+    }
+    ostream& out = args.output_file != "" ? fout : cout;
+
+    const ulint chunk_size = 256;
+    ulint chunks = (patterns.size() + chunk_size - 1) / chunk_size;
+    vector<ulint> tasks(chunks);
+    for (ulint c = 0; c < chunks; ++c) tasks[c] = c;
+
+    // finished chunks are written as soon as all previous ones are
+    vector<string> chunk_out(chunks);
+    vector<bool> finished(chunks,false);
+    ulint next_chunk = 0;
+    mutex out_mutex;
+
+    vector<ulint> occs(args.threads,0);
+
+    cout << "Processing " << args.query << " queries with " << args.threads << " threads ... " << flush;
+    if (args.output_file == "") cout << endl;
+
+    auto t3 = hrclock::now();
+
+    work_stealing_pool<ulint> pool(args.threads);
+    pool.run(tasks, [&](ulint c, ulint worker) {
+        stringstream ss;
+        ulint begin = c*chunk_size;
+        ulint end = min((c+1)*chunk_size, (ulint)patterns.size());
+
+        // count & locate of the whole chunk, interleaved
+        vector<ulint> counts;
+        vector<vector<ulint>> chunk_locations;
+        bool batched = args.query == "count" || (args.query == "locate" && !args.sa_order && args.max_occ == 0);
+        if (batched)
+        {
+            vector<string> chunk(patterns.begin()+begin, patterns.begin()+end);
+            if (args.query == "count") counts = idx.count_batch(chunk);
+            else chunk_locations = idx.locate_batch(chunk);
+        }
+
+        for (ulint i = begin; i < end; ++i)
+        {
+            if (args.query == "kmers")
+            {
+                occs[worker] += write_kmers(args, idx, patterns[i], to_string(i) + '\t', ss);
+                continue;
+            }
+            if (args.query == "ms")
+            {
+                write_ms(idx, patterns[i], to_string(i) + '\t', ss);
+                continue;
+            }
+            if (args.mem_report)
+            {
+                occs[worker] += write_mems(args, idx, patterns[i], to_string(i) + '\t', ss);
+                continue;
+            }
+
+            ss << i << '\t';
+            if (args.query == "count")
+            {
+                ulint cnt = counts[i-begin];
+                occs[worker] += cnt;
+                ss << cnt;
+            }
+            else if (args.query == "locate")
+            {
+                vector<ulint> locations;
+                if (batched) locations.swap(chunk_locations[i-begin]);
+                else if (args.sa_order) {
+                    locations = idx.locate_sa_order(patterns[i]);
+                    if (args.max_occ > 0 && locations.size() > args.max_occ) locations.resize(args.max_occ);
+                }
+                else if (args.max_occ == 0) locations = idx.locate(patterns[i]);
+                else idx.locate(patterns[i], [&](ulint occ) { locations.push_back(occ); return locations.size() < args.max_occ; });
+                occs[worker] += locations.size();
+                ss << locations.size();
+                for (auto occ : locations) ss << '\t' << occ;
+            }
+            else
+            {
+                ss << idx.maximal_exact_match(patterns[i]);
+            }
+            ss << '\n';
+        }
+
+        lock_guard<mutex> lock(out_mutex);
+        chunk_out[c] = ss.str();
+        finished[c] = true;
+        while (next_chunk < chunks && finished[next_chunk])
+        {
+            out << chunk_out[next_chunk];
+            string().swap(chunk_out[next_chunk]);
+            next_chunk++;
+        }
+    });
+    out << flush;
+
+    auto t4 = hrclock::now();
+
+    cout << "done." << endl;
+
+    double sec = duration_cast<microseconds>(t4-t3).count() / 1000000.0;
+    ulint total_occ = 0;
+    for (auto o : occs) total_occ += o;
+
+    if (args.query == "kmers") cout << "#Occurring k-mers: " << total_occ << endl;
+    else if (args.query != "mems" && args.query != "ms") cout << "#Occurrences: " << total_occ << endl;
+    else if (args.mem_report) cout << "#MEMs: " << total_occ << endl;
+    cout << "Elapsed time: " << duration_cast<microseconds>(t4-t3).count() << "(us)" << endl;
+    cout << "Throughput: " << (sec > 0 ? patterns.size() / sec : 0) << " patterns/s, "
+         << (sec > 0 ? bases / sec : 0) << " bases/s" << endl;
+}
+
+void query_full(Args& args, br_index const& idx) {
     ulint k = args.k, t = args.t;
 
     cout << "Max substring length k: " << k << endl;
     cout << "Min occurrence       t: " << t << endl; 
-    cout << "Computing full-task ... " << flush;
+    cout << "Computing full-task with " << args.threads << " threads ... " << flush;
 
     auto t3 = hrclock::now();
-    ulint occ = idx.full_task(k,t);
+    ulint occ = idx.full_task(k,t,args.threads);
     auto t4 = hrclock::now();
 
     cout << "done." << endl;
@@ -204,16 +572,27 @@ int main(int argc, char** argv)
 
     cout << "Loading br-index ... " << flush;
 
+    // load only the components the query needs
+    // building move structures (-p move) needs the full PLCP
+    br_index::load_profile profile = br_index::LOAD_FULL;
+    if (args.phi == "") {
+        if (args.query == "count") profile = br_index::LOAD_COUNT;
+        else if (args.query == "locate") profile = args.sa_order ? br_index::LOAD_BIDIRECTIONAL : br_index::LOAD_LOCATE;
+    }
+
     br_index idx;
     ifstream fidx(args.idx_file);
     if (!fidx.is_open()) {
         cerr << "Cannot open index file: " << args.idx_file << endl;
         exit(1);
     }
-    if (args.bl == -1) idx.load(fidx);
-    else idx.load(fidx,args.bl);
+    idx.load(fidx,profile,args.bl);
     fidx.close();
 
+    if (args.phi != "") idx.use_move_structures(args.phi == "move");
+    // thresholds absent from the index file are computed here
+    if (args.query == "ms") idx.use_ms_thresholds(true);
+
     cout << "done." << endl;
 
     auto t2 = hrclock::now();
@@ -224,12 +603,21 @@ int main(int argc, char** argv)
         // string text((istreambuf_iterator<char>(fin)), istreambuf_iterator<char>());
         query_full(args,idx);
     }
+    else if (args.format != "") {
+        query_batch(args,idx);
+    }
     else if (args.query == "count") {
         query_count(args,idx);
     }
     else if (args.query == "locate") {
         query_locate(args,idx);
     } 
+    else if (args.query == "kmers") {
+        query_kmers(args,idx);
+    }
+    else if (args.query == "ms") {
+        query_ms(args,idx);
+    }
     else if (args.query == "mems") {
         query_mems(args,idx);
     }
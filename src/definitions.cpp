@@ -88,4 +88,91 @@ ulint get_patterns_length(std::string header){
 
 }
 
+// guess the format of a pattern file from its first bytes
+static std::string detect_pattern_format(std::string const& data)
+{
+	if (data.compare(0,9,"# number=") == 0) return "pizza";
+	if (!data.empty() && data[0] == '>') return "fasta";
+	if (!data.empty() && data[0] == '@') return "fastq";
+	return "lines";
+}
+
+std::vector<std::string> read_patterns(std::string const& path, std::string format)
+{
+	std::ifstream in(path);
+	if (!in.is_open()) {
+		std::cerr << "Cannot open pattern file: " << path << std::endl;
+		exit(1);
+	}
+	std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	in.close();
+
+	if (format == "auto") format = detect_pattern_format(data);
+
+	std::vector<std::string> patterns;
+
+	if (format == "pizza")
+	{
+		ulint header_end = data.find('\n');
+		if (header_end == std::string::npos) header_error();
+		std::string header = data.substr(0,header_end);
+
+		ulint n = get_number_of_patterns(header);
+		ulint m = get_patterns_length(header);
+		if (header_end + 1 + n*m > data.size()) header_error();
+
+		for (ulint i = 0; i < n; ++i)
+			patterns.push_back(data.substr(header_end + 1 + i*m, m));
+		return patterns;
+	}
+
+	std::istringstream ss(data);
+	std::string line;
+
+	if (format == "lines")
+	{
+		while (std::getline(ss,line))
+		{
+			if (!line.empty() && line.back() == '\r') line.pop_back();
+			if (!line.empty()) patterns.push_back(line);
+		}
+	}
+	else if (format == "fasta")
+	{
+		bool in_record = false;
+		while (std::getline(ss,line))
+		{
+			if (!line.empty() && line.back() == '\r') line.pop_back();
+			if (!line.empty() && line[0] == '>')
+			{
+				patterns.push_back("");
+				in_record = true;
+			}
+			else if (in_record) patterns.back() += line;
+		}
+	}
+	else if (format == "fastq")
+	{
+		// @name, sequence, +, quality
+		std::string seq, plus, qual;
+		while (std::getline(ss,line))
+		{
+			if (line.empty()) continue;
+			if (line[0] != '@' || !std::getline(ss,seq) || !std::getline(ss,plus) || !std::getline(ss,qual)) {
+				std::cerr << "Error: malformed FASTQ record in " << path << std::endl;
+				exit(1);
+			}
+			if (!seq.empty() && seq.back() == '\r') seq.pop_back();
+			patterns.push_back(seq);
+		}
+	}
+	else
+	{
+		std::cerr << "Unknown pattern file format: " << format << std::endl;
+		exit(1);
+	}
+
+	return patterns;
+}
+
 }; // namespace bri
\ No newline at end of file
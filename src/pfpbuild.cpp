@@ -1,10 +1,22 @@
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
+#include <chrono>
+#include <condition_variable>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
 #include "definitions.hpp"
 #include "rle_string.hpp"
 #include "sparse_sd_vector.hpp"
 #include "permuted_lcp.hpp"
 #include "br_index.hpp"
+#include "work_stealing_pool.hpp"
 extern "C" {
     #include "pfpbuilder/utils.h"
 }
@@ -21,6 +33,19 @@ void print_vec(std::vector<T> const& vec) {
 // index file extension
 const std::string EXTIDX = "bri";
 
+// MemAvailable of /proc/meminfo in bytes, 0 if unavailable
+bri::ulint available_memory()
+{
+    std::ifstream in("/proc/meminfo");
+    std::string key, unit;
+    bri::ulint value;
+    while (in >> key >> value >> unit)
+    {
+        if (key == "MemAvailable:") return value << 10;
+    }
+    return 0;
+}
+
 // struct containing command line parameters and other globals
 struct Args {
     std::string input_file = "";
@@ -28,37 +53,616 @@ struct Args {
     int bl = 8;
     int verbose=0;
     bool inmemory = false;
+    bool move = false;
+    bool psv = false;
+    bool thresholds = false;
+    int q = 0;
+    bool pfp = false;   // run Prefix-Free Parsing & stream its output
+    int wsize = 10;     // sliding window size of the parsing
+    int mod = 100;      // modulus of the parsing
+    int threads = 0;    // helper threads of the parsing, the final BWT & the PLCP/kmer steps
+    bool keep = false;  // keep the parsing files
+    bri::ulint mem_budget = available_memory(); // peak memory of concurrent stages
     FILE *tmp_parse_file, *last_file, *sa_file; 
 };
 
+// BWT runs & SA samples at the run boundaries, as written by pfbwt (.bwt, .ssa, .esa)
+struct pfp_output {
+    std::string heads;              // run heads (original characters)
+    std::vector<bri::ulint> lengths; // run lengths
+    std::vector<bri::ulint> freqs = std::vector<bri::ulint>(256,0);
+    std::vector<bri::ulint> ssa;    // SA value stored for the first position of each run
+    std::vector<bri::ulint> esa;    // SA value stored for the last position of each run
+
+    static constexpr bri::ulint bytes_per_run() { return 1 + 3 * sizeof(bri::ulint); }
+    bri::ulint bytes() const { return heads.size() * bytes_per_run(); }
+};
+
+FILE* open_input(std::string const& path)
+{
+    FILE* f = fopen(path.c_str(),"rb");
+    if (f == NULL) die(("Cannot open file " + path).c_str());
+    return f;
+}
+
+// runs & character frequencies of a .bwt file (or pipe) f, in one pass; f is closed
+void read_bwt_runs(FILE* f, std::string const& path, pfp_output& out)
+{
+    std::vector<uchar> buf(1 << 20);
+    size_t got;
+    int last = -1;
+    bri::ulint len = 0;
+    while ((got = fread(buf.data(),1,buf.size(),f)) > 0)
+    {
+        for (size_t i = 0; i < got; ++i)
+        {
+            uchar c = buf[i];
+            out.freqs[c]++;
+            if (c == last)
+            {
+                len++;
+                continue;
+            }
+            if (last >= 0)
+            {
+                out.heads.push_back((char)last);
+                out.lengths.push_back(len);
+            }
+            last = c;
+            len = 1;
+        }
+    }
+    if (last >= 0)
+    {
+        out.heads.push_back((char)last);
+        out.lengths.push_back(len);
+    }
+    if (ferror(f)) die((path + " read failed.").c_str());
+    fclose(f);
+}
+
+// SA values of the <position, SA value> pairs of a .ssa or .esa file (or pipe) f; f is closed
+void read_sa_samples(FILE* f, std::string const& path, std::vector<bri::ulint>& sa)
+{
+    const size_t pair_bytes = 2 * SABYTES;
+    std::vector<uchar> buf(pair_bytes << 16);
+    size_t got;
+    while ((got = fread(buf.data(),pair_bytes,buf.size()/pair_bytes,f)) > 0)
+    {
+        for (size_t i = 0; i < got; ++i)
+        {
+            // little endian, the second value of the pair
+            uchar const* p = buf.data() + i * pair_bytes + SABYTES;
+            bri::ulint v = 0;
+            for (int b = SABYTES-1; b >= 0; --b) v = (v << 8) | p[b];
+            sa.push_back(v);
+        }
+    }
+    if (ferror(f)) die((path + " read failed.").c_str());
+    fclose(f);
+}
+
+// .bwt, .ssa & .esa of basename, read concurrently: pfbwt writes them in lockstep, so pipes must be drained together
+// files: the three already opened (pipes), opened here if empty
+void read_pfp_output(std::string const& basename, pfp_output& out, std::vector<FILE*> files = {})
+{
+    std::vector<std::string> paths = {basename + ".bwt", basename + "." + EXTSSA, basename + "." + EXTESA};
+    if (files.empty()) for (auto const& path : paths) files.push_back(open_input(path));
+    std::thread ssa(read_sa_samples, files[1], paths[1], std::ref(out.ssa));
+    std::thread esa(read_sa_samples, files[2], paths[2], std::ref(out.esa));
+    read_bwt_runs(files[0], paths[0], out);
+    ssa.join();
+    esa.join();
+}
+
+// disk traffic (bytes handed to and read from the storage layer) of a process
+struct disk_io {
+    bri::ulint read = 0, written = 0;
+
+    disk_io& operator+=(disk_io const& other) { read += other.read; written += other.written; return *this; }
+    disk_io operator-(disk_io const& other) const { disk_io d; d.read = read - other.read; d.written = written - other.written; return d; }
+};
+
+// read_bytes & write_bytes of /proc/<pid>/io (pid 0: this process), zero if unavailable
+disk_io read_disk_io(pid_t pid)
+{
+    disk_io res;
+    std::ifstream in(pid == 0 ? "/proc/self/io" : "/proc/" + std::to_string(pid) + "/io");
+    std::string key;
+    bri::ulint value;
+    while (in >> key >> value)
+    {
+        if (key == "read_bytes:") res.read = value;
+        else if (key == "write_bytes:") res.written = value;
+    }
+    return res;
+}
+
+// peak resident set size so far of this process, in bytes
+bri::ulint self_peak_rss()
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return (bri::ulint)ru.ru_maxrss << 10;
+}
+
+// wall time, disk traffic & peak RSS of the build stages, printed as they end (stages may run concurrently)
+class stage_report {
+public:
+    struct timer {
+        std::chrono::steady_clock::time_point start;
+        disk_io self;
+    };
+
+    stage_report() : total(begin()) {}
+
+    timer begin() const
+    {
+        timer t;
+        t.start = std::chrono::steady_clock::now();
+        t.self = read_disk_io(0);
+        return t;
+    }
+
+    /*
+     * children: traffic of the processes that ran in the stage
+     * peak_rss: their peak, 0 for a stage run in this process (its peak so far is shown)
+     * log: messages of the stage, printed before its line
+     */
+    void end(timer const& t, std::string const& stage, disk_io children = disk_io(), bri::ulint peak_rss = 0, std::string const& log = "")
+    {
+        double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t.start).count();
+        disk_io io = read_disk_io(0) - t.self;
+        io += children;
+
+        std::lock_guard<std::mutex> lock(mtx);
+        children_io += children;
+        std::cout << log;
+        print(stage, sec, io, peak_rss > 0 ? peak_rss : self_peak_rss());
+    }
+
+    // wall time since the report was made, so concurrent stages count once
+    void print_total()
+    {
+        double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - total.start).count();
+        disk_io io = read_disk_io(0) - total.self;
+        io += children_io;
+
+        std::lock_guard<std::mutex> lock(mtx);
+        print("Total", sec, io, self_peak_rss());
+    }
+
+private:
+    static void print(std::string const& stage, double sec, disk_io const& io, bri::ulint peak_rss)
+    {
+        std::cout << "==== " << stage << ": " << std::fixed << std::setprecision(3) << sec << " s, disk read "
+                  << std::setprecision(1) << io.read / 1048576.0 << " MB, written " << io.written / 1048576.0
+                  << " MB, peak RSS " << peak_rss / 1048576.0 << " MB" << std::defaultfloat << std::endl;
+    }
+
+    std::mutex mtx;
+    timer total;
+    disk_io children_io;
+};
+
+/*
+ * peak memory budget of the stages of the two directions: a stage reserves
+ * its estimated peak and waits while it does not fit next to the running
+ * stages and the data kept between stages, so the directions run one at a
+ * time when both do not fit. A stage always runs when no other one is
+ * running, whatever its estimate.
+ */
+class memory_budget {
+public:
+    // budget: bytes, 0 runs the stages one at a time
+    memory_budget(bri::ulint budget) : budget(budget) {}
+
+    void acquire(bri::ulint bytes)
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        if (running > 0 && used + bytes > budget)
+        {
+            delayed++;
+            cv.wait(lock, [&]() { return running == 0 || used + bytes <= budget; });
+        }
+        used += bytes;
+        running++;
+    }
+
+    void release(bri::ulint bytes)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        used -= bytes;
+        running--;
+        cv.notify_all();
+    }
+
+    // memory kept between stages
+    void hold(bri::ulint bytes)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        used += bytes;
+    }
+
+    void drop(bri::ulint bytes)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        used -= bytes;
+        cv.notify_all();
+    }
+
+    inline bri::ulint size() const { return budget; }
+
+    // number of stages that waited for the budget
+    bri::ulint delayed_stages()
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        return delayed;
+    }
+
+private:
+    bri::ulint budget;
+    bri::ulint used = 0;
+    bri::ulint running = 0;
+    bri::ulint delayed = 0;
+
+    std::mutex mtx;
+    std::condition_variable cv;
+};
+
+/*
+ * runs the stages of Prefix-Free Parsing (as pfpbuilder/bigbwt -s -e does) and
+ * streams the .bwt, .ssa & .esa of pfbwt through named pipes into memory
+ * (regular files if the pipes cannot be made); the parse & dictionary files of
+ * the earlier stages are deleted unless keep. Both directions can run at once;
+ * the reversed parse is derived from the forward one.
+ */
+class pfp_pipeline {
+public:
+    pfp_pipeline(Args const& args, stage_report& stages, memory_budget& budget) : args(args), stages(stages), budget(budget)
+    {
+        char buf[4096];
+        ssize_t len = readlink("/proc/self/exe", buf, sizeof(buf)-1);
+        if (len < 0) die("Cannot locate the executable");
+        buf[len] = 0;
+        std::string exe(buf);
+        exe_dir = exe.substr(0, exe.rfind('/') + 1) + "pfpbuilder/";
+    }
+
+    // BWT runs & SA samples of the input (reversed: of the reversed input)
+    void run(bool reversed, pfp_output& out)
+    {
+        std::string dir = reversed ? "backwards" : "forwards";
+        std::string base = args.input_file + (reversed ? ".rev" : "");
+        struct stat st;
+
+        // ---- parsing: the dictionary is kept in memory, at most the text. The reversed
+        // parse is derived from the forward dictionary & parse without reading the text:
+        // the reversed words, in reversed order, are a prefix-free parse of the reversed text
+        if (stat(args.input_file.c_str(), &st) != 0) die("Cannot stat the input");
+        bri::ulint text_size = st.st_size;
+        std::vector<std::string> cmd;
+        if (!reversed)
+        {
+            cmd = {exe_dir + (args.threads > 0 ? "pscan.x" : "newscanNT.x"), args.input_file,
+                "-w", std::to_string(args.wsize), "-p", std::to_string(args.mod)};
+            if (args.threads > 0) { cmd.push_back("-t"); cmd.push_back(std::to_string(args.threads)); }
+            cmd.push_back("-s");
+            if (args.verbose) cmd.push_back("-v");
+            stage(cmd, "Parsing " + dir, text_size);
+            finished(forward_parsed);
+        }
+        else
+        {
+            wait_for(forward_parsed);
+            bri::ulint forward_size = 0;
+            for (std::string ext : {EXTDICT, EXTPARSE})
+            {
+                if (stat((args.input_file + "." + ext).c_str(), &st) != 0) die("Cannot stat the forward parse");
+                forward_size += st.st_size;
+            }
+            // the dictionary, its reversed words and the parse
+            cmd = {exe_dir + "revparse", args.input_file, "-w", std::to_string(args.wsize), "-s"};
+            stage(cmd, "Parsing " + dir + " (reversed forward parse)", 2 * forward_size);
+            finished(reverse_parsed);
+        }
+
+        // ---- BWT of the parse: suffix sorting of the parse, a few words per phrase
+        if (stat((base + "." + EXTPARSE).c_str(), &st) != 0) die("Cannot stat the parse");
+        bri::ulint parse_size = st.st_size / 4;
+        if (parse_size >= (1UL << 32) - 1) {
+            std::cerr << "The parse contains " << parse_size << " words, more than the limit 2^32-2. "
+                      << "Please re-run with a larger modulus (currently " << args.mod << ")" << std::endl;
+            exit(1);
+        }
+        cmd = {exe_dir + (parse_size >= (1UL << 31) - 1 ? "bwtparse64" : "bwtparse"), base, "-s"};
+        // with -t, bwtparse reads the per-thread .last & .sai of pscan; revparse writes single ones
+        if (args.threads > 0 && !reversed) { cmd.push_back("-t"); cmd.push_back(std::to_string(args.threads)); }
+        stage(cmd, "BWT of the parse " + dir, 16 * parse_size);
+
+        // ---- final BWT & SA samples, streamed: SA & LCP of the dictionary, the parse BWT,
+        // and the runs received (at most one per dictionary character or phrase)
+        if (stat((base + "." + EXTDICT).c_str(), &st) != 0) die("Cannot stat the dictionary");
+        bri::ulint dict_size = st.st_size;
+        bool dict64 = dict_size >= (1UL << 31) - 4;
+        if (args.threads > 0)
+            cmd = {exe_dir + (dict64 ? "pfbwt64.x" : "pfbwt.x"), "-w", std::to_string(args.wsize), base, "-s", "-e", "-t", std::to_string(args.threads)};
+        else
+            cmd = {exe_dir + (dict64 ? "pfbwtNT64.x" : "pfbwtNT.x"), "-w", std::to_string(args.wsize), base, "-s", "-e"};
+        bri::ulint estimate = 13 * dict_size + 9 * parse_size + pfp_output::bytes_per_run() * std::min(text_size, dict_size + parse_size);
+
+        std::vector<std::string> outputs = {base + ".bwt", base + "." + EXTSSA, base + "." + EXTESA};
+        bool piped = true;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            for (auto const& path : outputs)
+            {
+                unlink(path.c_str());
+                piped = piped && mkfifo(path.c_str(), 0600) == 0;
+            }
+            if (piped) pipe_paths.insert(pipe_paths.end(), outputs.begin(), outputs.end());
+            else for (auto const& path : outputs) unlink(path.c_str());
+        }
+
+        // the pipes are opened here before pfbwt starts, and a write end of each is
+        // held until it exits: the readers never wait in open for a writer that does
+        // not come (pfbwt failed before opening its outputs), nor see EOF too early
+        std::vector<FILE*> pipes;
+        std::vector<int> held;
+        if (piped)
+        {
+            for (auto const& path : outputs)
+            {
+                int rd = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+                int wr = rd >= 0 ? open(path.c_str(), O_WRONLY | O_CLOEXEC) : -1;
+                if (wr < 0 || fcntl(rd, F_SETFL, fcntl(rd, F_GETFL) & ~O_NONBLOCK) != 0)
+                    die(("Cannot open pipe " + path).c_str());
+                pipes.push_back(fdopen(rd, "rb"));
+                held.push_back(wr);
+            }
+        }
+
+        budget.acquire(estimate);
+        auto t = stages.begin();
+        pid_t pid = spawn(cmd);
+        bri::ulint peak_rss = 0;
+        disk_io io;
+        if (piped)
+        {
+            bool ok = true;
+            std::thread reader([&]() { read_pfp_output(base, out, pipes); });
+            io = wait(pid, cmd, peak_rss, &ok);
+            for (int fd : held) close(fd);
+            reader.join();
+            remove_pipes(outputs);
+            if (!ok) fail(cmd);
+        }
+        else
+        {
+            io = wait(pid, cmd, peak_rss);
+            read_pfp_output(base, out);
+        }
+        stages.end(t, "Final BWT " + dir + (piped ? " (piped into the builder)" : " (through files)"), io, peak_rss);
+        budget.release(estimate);
+
+        if (!piped && !args.keep) for (auto const& path : outputs) unlink(path.c_str());
+        if (!args.keep)
+        {
+            // the forward parse is still read by revparse
+            if (!reversed) wait_for(reverse_parsed);
+            remove_temp_files(base);
+        }
+    }
+
+private:
+    void finished(bool& done)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        done = true;
+        cv.notify_all();
+    }
+
+    void wait_for(bool& done)
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait(lock, [&]() { return done; });
+    }
+
+    // runs cmd as a stage of estimated peak memory
+    void stage(std::vector<std::string> const& cmd, std::string const& name, bri::ulint estimate)
+    {
+        budget.acquire(estimate);
+        auto t = stages.begin();
+        bri::ulint peak_rss = 0;
+        disk_io io = wait(spawn(cmd), cmd, peak_rss);
+        stages.end(t, name, io, peak_rss);
+        budget.release(estimate);
+    }
+
+    pid_t spawn(std::vector<std::string> const& cmd)
+    {
+        if (args.verbose) {
+            std::string line = "Command:";
+            for (auto const& a : cmd) line += " " + a;
+            std::cout << line + "\n";
+        }
+        std::cout << std::flush;
+
+        pid_t pid = fork();
+        if (pid < 0) die("fork");
+        if (pid == 0)
+        {
+            // messages of the stages go to the log file, as in bigbwt
+            int log = open((args.input_file + ".log").c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+            if (log >= 0) { dup2(log, 1); dup2(log, 2); close(log); }
+
+            std::vector<char*> argv;
+            for (auto const& a : cmd) argv.push_back(const_cast<char*>(a.c_str()));
+            argv.push_back(NULL);
+            execv(argv[0], argv.data());
+            perror(argv[0]);
+            _exit(127);
+        }
+        return pid;
+    }
+
+    // disk traffic & peak RSS of the finished child; exits on failure unless ok is given
+    disk_io wait(pid_t pid, std::vector<std::string> const& cmd, bri::ulint& peak_rss, bool* ok = NULL)
+    {
+        // read its /proc entry before reaping it
+        siginfo_t info;
+        if (waitid(P_PID, pid, &info, WEXITED | WNOWAIT) != 0) die("waitid");
+        disk_io io = read_disk_io(pid);
+
+        int status;
+        struct rusage ru;
+        if (wait4(pid, &status, 0, &ru) < 0) die("wait4");
+        peak_rss = (bri::ulint)ru.ru_maxrss << 10;
+        bool success = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        if (ok != NULL) *ok = success;
+        else if (!success) fail(cmd);
+        return io;
+    }
+
+    void fail(std::vector<std::string> const& cmd)
+    {
+        std::cerr << "Error executing command line:" << std::endl << "\t";
+        for (auto const& a : cmd) std::cerr << a << " ";
+        std::cerr << std::endl << "Check log file: " << args.input_file << ".log" << std::endl;
+        // the pipes of the other direction would block a later run reading the files
+        std::vector<std::string> paths;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            paths = pipe_paths;
+        }
+        remove_pipes(paths);
+        exit(1);
+    }
+
+    void remove_pipes(std::vector<std::string> const& paths)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (auto const& path : paths)
+        {
+            unlink(path.c_str());
+            pipe_paths.erase(std::remove(pipe_paths.begin(), pipe_paths.end(), path), pipe_paths.end());
+        }
+    }
+
+    // intermediate files of the parsing stages
+    void remove_temp_files(std::string const& base)
+    {
+        for (std::string ext : {EXTPARSE, EXTPARS0, EXTLST, EXTBWLST, EXTDICT, EXTILIST, EXTOCC, EXTSAI, EXTBWSAI})
+            unlink((base + "." + ext).c_str());
+        for (int i = 0; i < args.threads; ++i)
+            for (std::string ext : {EXTPARS0, EXTLST, EXTSAI})
+                unlink((base + "." + std::to_string(i) + "." + ext).c_str());
+    }
+
+    Args const& args;
+    stage_report& stages;
+    memory_budget& budget;
+    std::string exe_dir;
+
+    // the forward parse files are written, and read by revparse
+    bool forward_parsed = false;
+    bool reverse_parsed = false;
+    // named pipes currently on disk
+    std::vector<std::string> pipe_paths;
+    std::mutex mtx;
+    std::condition_variable cv;
+};
+
 namespace bri {
 
 class br_index_builder {
     br_index idx;
+
+    // character frequencies the alphabet was built from
+    std::vector<ulint> alphabet_freqs;
+    std::mutex alphabet_mutex;
+
+    // workers of the PLCP & kmer steps of each direction: the calling thread & the helper threads
+    ulint workers = 1;
+
 public:
     // input: file basename of Prefix-Free Parsing (.bwt, .ssa, .esa, .rev.bwt, .rev.ssa, .rev.esa are necessary)
     // bl: parameter
-    br_index_builder& build_from_pfp(std::string const& input, int bl) {
+    // threads: helper threads of the PLCP & kmer steps of each direction
+    br_index_builder& build_from_pfp(std::string const& input, int bl, ulint threads, memory_budget& budget, stage_report& stages) {
 
         std::cout << "Building br-index on " << input << std::endl;
         std::cout << "  using PFP parsing files." << std::endl;
 
+        build_directions([&](bool reversed, pfp_output& out) {
+            auto t = stages.begin();
+            read_pfp_output(input + (reversed ? ".rev" : ""), out);
+            stages.end(t, reversed ? "Reading backwards" : "Reading forwards");
+        }, bl, threads, budget, stages);
+
+        auto t = stages.begin();
+        finish();
+        stages.end(t, "PLCP samples");
+        return *this;
+    }
+
+    /*
+     * steps 1-9, the two directions on two threads: produce(reversed, out) gives the
+     * BWT runs & SA samples of a direction. Indexing a direction waits for the memory
+     * budget, so the directions are indexed one after the other when both do not fit.
+     */
+    template<class producer_t>
+    br_index_builder& build_directions(producer_t produce, int bl, ulint threads, memory_budget& budget, stage_report& stages) {
+
         idx = br_index();
-        idx.length = (ulint)bl;
+        alphabet_freqs.clear();
+        workers = threads + 1;
+
+        auto direction = [&](bool reversed) {
+            pfp_output out;
+            produce(reversed, out);
+            ulint streamed = out.bytes();
+            budget.hold(streamed);
+
+            // RLBWT, samples, PLCP & kmer vectors: a few words per run
+            ulint estimate = (96 + 8 * (ulint)bl) * out.heads.size();
+            budget.acquire(estimate);
+            std::ostringstream log;
+            auto t = stages.begin();
+            build_alphabet(out.freqs, bl, log);
+            if (reversed) build_reverse(out, log);
+            else build_forward(out, log);
+            stages.end(t, reversed ? "Index backwards" : "Index forwards", disk_io(), 0, log.str());
+            budget.release(estimate);
+            budget.drop(streamed);
+        };
+
+        std::thread backwards(direction, true);
+        direction(false);
+        backwards.join();
+
+        return *this;
+    }
 
-        std::cout << "bl: " << bl << std::endl;
+    // step 1 from the character frequencies of a BWT, once: the other direction only checks them
+    br_index_builder& build_alphabet(std::vector<ulint> const& freqs, int bl, std::ostream& log = std::cout) {
 
-        // read .bwt
-        std::ifstream fbwt(input + ".bwt", std::ifstream::ate);
-        if (!fbwt.is_open()) {
-            perror(__func__);
-            throw new std::runtime_error("Cannot open file " + input + ".bwt");
+        std::lock_guard<std::mutex> lock(alphabet_mutex);
+        if (!alphabet_freqs.empty()) {
+            if (freqs != alphabet_freqs) die("The BWT and the reversed BWT have different characters.");
+            return *this;
         }
-        long size = fbwt.tellg();
-        fbwt.seekg(0);
+        alphabet_freqs = freqs;
 
+        idx.length = (ulint)bl;
+
+        log << "bl: " << bl << std::endl;
 
-        std::cout << "(1/9) Remapping alphabet ... " << std::flush;
+        idx.n = 0;
+        for (auto f : freqs) idx.n += f;
+
+        log << "(1/9) Remapping alphabet ... " << std::flush;
+        auto t = std::chrono::steady_clock::now();
 
         // construct alphabet remapper (null character \0 is mapped to \1)
         idx.remap = std::vector<uchar>(256,0); idx.remap[0] = 1;
@@ -66,12 +670,11 @@ public:
         idx.sigma = 0;
         idx.F = std::vector<ulint>(256,0);
         {
-            std::vector<ulint> freqs(256,0);
-            for (size_t i = 0; i < size; ++i) {
-                if (freqs[(uchar)fbwt.get()]++ == 0) idx.sigma++;
-                if (idx.sigma >= 255) {
-                    die("Alphabet overflow");
-                }
+            for (ulint c = 0; c < 256; ++c) {
+                if (freqs[c] != 0) idx.sigma++;
+            }
+            if (idx.sigma >= 255) {
+                die("Alphabet overflow");
             }
             assert(freqs[0]==1);
             uchar new_c = 2;
@@ -90,40 +693,50 @@ public:
         assert(idx.remap[0] == 1);
         assert(idx.remap_inv[1] == 0);
 
-        std::cout << "done.\n(2/9) Building RLBWT ... " << std::flush;
+        log << "done. " << seconds_since(t) << " s" << std::endl;
+
+        return *this;
+    }
+
+    // steps 2-5 from the forward BWT runs & SA samples, after build_alphabet
+    br_index_builder& build_forward(pfp_output const& out, std::ostream& log = std::cout) {
 
-        // build RLBWT with remapper
-        fbwt.seekg(0);
-        idx.bwt.load_from_plain(fbwt,size,idx.remap);
-        fbwt.close();
-        assert(size==idx.bwt.size());
+        ulint size = idx.n;
+
+        log << "(2/9) Building RLBWT ... " << std::flush;
+        auto t = std::chrono::steady_clock::now();
+
+        // build RLBWT from the runs with remapper
+        {
+            std::string heads(out.heads);
+            for (auto& c : heads) c = idx.remap[(uchar)c];
+            idx.bwt.load_from_runs(heads,out.lengths);
+        }
+        if (size != idx.bwt.size()) die(".bwt length and character frequencies differ.");
 
         idx.r = idx.bwt.number_of_runs();
         ulint r = idx.r;
         int log_r = bitsize(r);
         int log_n = bitsize(size);
 
-        std::cout << "done.\nNumber of runs in BWT  r: " << r << std::endl;
+        log << "done. " << seconds_since(t) << " s\nNumber of runs in BWT  r: " << r << std::endl;
 
-        std::cout << "(3/9) Reading SA samples at run boundaries ... " << std::flush;
+        log << "(3/9) Sorting SA samples at run boundaries ... " << std::flush;
+        t = std::chrono::steady_clock::now();
 
-        // read .ssa
-        FILE* file_ssa = open_aux_file(input.c_str(),EXTSSA,"rb");
+        if (out.ssa.size() != r) die(".ssa read failed.");
+        if (out.esa.size() != r) die(".esa read failed.");
 
         idx.samples_first = sdsl::int_vector<>(r,0,log_n);
         idx.first_to_run = sdsl::int_vector<>(r,0,log_r);
         {
             auto pos_run_pairs = std::vector<std::pair<ulint,ulint>>(r);
-            ulint* buf = new ulint[1];
             for (ulint i = 0; i < r; ++i) {
-                if (fread(buf, SABYTES, 1, file_ssa) != 1) die(".ssa read failed.");
-                if (fread(buf, SABYTES, 1, file_ssa) != 1) die(".ssa read failed.");
-                ulint sa_val = buf[0] % (1UL << (8*SABYTES));
+                ulint sa_val = out.ssa[i];
                 sa_val = (sa_val > 0) ? (sa_val - 1) : (size-1);
                 idx.samples_first[i] = sa_val;
                 pos_run_pairs[i] = {sa_val,i};
             }
-            delete[] buf;
 
             std::sort(pos_run_pairs.begin(),pos_run_pairs.end());
 
@@ -134,28 +747,18 @@ public:
             }
             idx.first = br_index::sparse_bitvector_t(first_pos.cbegin(),first_pos.cend());
         }
-        fclose(file_ssa);
-
-        // read.esa
-        FILE* file_esa = open_aux_file(input.c_str(),EXTESA,"rb");
 
         idx.samples_last = sdsl::int_vector<>(r,0,log_n);
         idx.last_to_run = sdsl::int_vector<>(r,0,log_r);
         {
             auto pos_run_pairs = std::vector<std::pair<ulint,ulint>>(r);
-            
-            ulint* buf = new ulint[1];
             for (ulint i = 0; i < r; ++i) {
-                if (fread(buf, SABYTES, 1, file_esa) != 1) die(".esa read failed.");
-                if (fread(buf, SABYTES, 1, file_esa) != 1) die(".esa read failed.");
-                ulint sa_val = buf[0] % (1UL << (8*SABYTES));
+                ulint sa_val = out.esa[i];
                 sa_val = (sa_val > 0) ? (sa_val - 1) : (size-1);
                 idx.samples_last[i] = sa_val;
                 pos_run_pairs[i] = {sa_val,i};
             }
-            idx.last_SA_val = buf[0] % (1UL << (8*SABYTES));
-            delete[] buf;
-
+            idx.last_SA_val = out.esa[r-1];
 
             std::sort(pos_run_pairs.begin(),pos_run_pairs.end());
 
@@ -166,183 +769,64 @@ public:
             }
             idx.last = br_index::sparse_bitvector_t(last_pos.cbegin(),last_pos.cend());
         }
-        fclose(file_esa);
-
-        std::cout << "done.\n(4/9) Building run-length compressed PLCP ... " << std::flush;
-
-        // construct run-length encoded PLCP
-        {
-            std::vector<ulint> ones, zeros;
-
-            uchar c, c0;
-            ulint p, p0, pos, l, gap;
-            ulint prev_pos = 0;
-            ulint prev_l = 0;
-            ulint acc0=0, acc1=0;
-
-            for (ulint i = 0; i < r; ++i) {
-                // We encode PLCP by run-length manner
-                // For each bit of the idx.first (= run start bwt char),
-                // - get its PLCP value (by repeating FL(p) and bwt[p])
-                // - add gap between the bit and the preceding bit in idx.first to the PLCP value
-                // - difference between the value and the previous PLCP can be encoded
-                // Note that if idx.first[j]=0, PLCP[j+1]=PLCP[j]-1 holds.
-                pos = idx.first.select(i);
-
-                gap = i == 0 ? pos : (pos - prev_pos - 1);
-
-                l = 0;
-                ulint q = idx.bwt.run_start(idx.first_to_run[i]);
-                c = idx.bwt[q];
-                p = idx.F[c] + idx.bwt.rank(q,c);
-                if (p != 0) {
-                    p0 = p - 1;
-                    c0 = idx.F_at(p0);
-                    while (c == c0) {
-                        // compute FL(p) & FL(p0), compare BWT chars
-                        l++;
-                        ulint i = p - idx.F[c];
-                        p = idx.bwt.select(i,c);
-                        c = idx.F_at(p);
-                        ulint i0 = p0 - idx.F[c0];
-                        p0 = idx.bwt.select(i0,c0);
-                        c0 = idx.F_at(p0);
-                    }
-                }
-
-                if (i == 0) {
-                    if (l + gap > 0) {
-                        ones.push_back(acc1);
-                        acc0 += l + gap - 1;
-                        zeros.push_back(acc0);
-                        acc1 += gap + 1;
-                    } else {
-                        acc1 += gap + 1;
-                    }
-                } else if (l + gap + 1 - prev_l) {
-                    ones.push_back(acc1);
-                    acc0 += l + gap + 1 - prev_l;
-                    zeros.push_back(acc0);
-                    acc1 += gap + 1;
-                } else {
-                    acc1 += gap + 1;
-                }
-
-                prev_pos = pos;
-                prev_l = l;
-            }
-            ones.push_back(acc1);
-
-            idx.plcp = permuted_lcp<>(size,ones,zeros);
-        }
 
-        std::cout << "done.\n(5/9) Building kmer[0,bl) ... " << std::flush;
-        
-        // consruct kmer[0,bl) (contraction shortcut bitvector)
-        {
-            auto kmer_pos = std::vector<std::vector<ulint>>(bl);
-            // first run head
-            for (ulint i = 0; i < bl; ++i) kmer_pos[i].push_back(0);
+        log << "done. " << seconds_since(t) << " s\n(4/9) Building run-length compressed PLCP ... " << std::flush;
+        t = std::chrono::steady_clock::now();
 
-            ulint prev_run_start = 0;
-            ulint run_start, run_end;
-            ulint cur_sa, min_lcp_l, min_lcp_r;
+        idx.plcp = build_plcp(idx.bwt, idx.first, idx.first_to_run);
 
-            for (ulint i = 1; i < r; ++i) {
-                auto run_range = idx.bwt.run_range(i);
-                run_start = run_range.first;
-                run_end = run_range.second;
+        log << "done. " << seconds_since(t) << " s\n(5/9) Building kmer[0,bl) ... " << std::flush;
+        t = std::chrono::steady_clock::now();
 
-                ulint start_sa = idx.samples_first[i] < size-1 ? idx.samples_first[i]+1 : 0;
-                min_lcp_l = min_lcp_r = idx.plcp[start_sa];
-                if (min_lcp_l > bl) min_lcp_l = min_lcp_r = bl;
-                
-                for (ulint l = min_lcp_l; l < bl; ++l) kmer_pos[l].push_back(run_start);
+        idx.kmer = build_kmer(idx.bwt, idx.samples_first, idx.plcp,
+            [&](ulint i) { return idx.Phi(i); }, [&](ulint i) { return idx.PhiI(i); });
 
-                // backward scan from run head
-                cur_sa = start_sa;
-                for (ulint p = run_start-1; p > prev_run_start; --p) {
-                    if (min_lcp_l==0) break;
+        log << "done. " << seconds_since(t) << " s" << std::endl;
 
-                    cur_sa = idx.Phi(cur_sa);
-                    ulint lcp = idx.plcp[cur_sa];
-                    if (lcp < min_lcp_l) {
-                        for (ulint l = lcp; l < min_lcp_l; ++l) {
-                            if (kmer_pos[l].back() != p) kmer_pos[l].push_back(p);
-                        } 
-                        min_lcp_l = lcp;
-                    }
-                }
-                // forward scan from run head
-                cur_sa = start_sa;
-                for (ulint p = run_start+1; p <= run_end; ++p) {
-                    if (min_lcp_r==0) break;
+        return *this;
+    }
 
-                    cur_sa = idx.PhiI(cur_sa);
-                    ulint lcp = idx.plcp[cur_sa];
-                    if (lcp < min_lcp_r) {
-                        for (ulint l = lcp; l < min_lcp_r; ++l) kmer_pos[l].push_back(p);
-                        min_lcp_r = lcp;
-                    }
-                }
+    // steps 6-9 from the reversed BWT runs & SA samples, after build_alphabet
+    br_index_builder& build_reverse(pfp_output const& out, std::ostream& log = std::cout) {
 
-                prev_run_start = run_start;
-            }
-            // last run tail
-            for (ulint i = 0; i < bl; ++i) kmer_pos[i].push_back(size);
+        log << "Start building components for the reversed direction." << std::endl;
 
-            idx.kmer = std::vector<br_index::sparse_bitvector_t>(bl);
-            for (ulint i = 0; i < bl; ++i) {
-                idx.kmer[i] = br_index::sparse_bitvector_t(kmer_pos[i].cbegin(),kmer_pos[i].cend());
-            }
-        }
-        
-        std::cout << "done." << std::endl;
-        std::cout << "Start building components for the reversed direction." << std::endl;
+        ulint size = idx.n;
+        int log_n = bitsize(size);
 
-        // load from reversed files
-        std::string input_rev = input + ".rev";
+        log << "(6/9) Building RLBWT^R ... " << std::flush;
+        auto t = std::chrono::steady_clock::now();
 
-        // read .rev.bwt
-        std::ifstream fbwt_rev(input_rev + ".bwt");
-        if (!fbwt_rev.is_open()) {
-            perror(__func__);
-            throw new std::runtime_error("Cannot open file " + input_rev + ".bwt");
+        // build RLBWT^R from the runs with remapper
+        {
+            std::string heads(out.heads);
+            for (auto& c : heads) c = idx.remap[(uchar)c];
+            idx.bwtR.load_from_runs(heads,out.lengths);
         }
-
-        std::cout << "(6/9) Building RLBWT^R ... " << std::flush;
-
-        // build RLBWT^R with remapper
-        fbwt_rev.seekg(0);
-        idx.bwtR.load_from_plain(fbwt_rev,size,idx.remap);
-        fbwt_rev.close();
-        assert(size==idx.bwtR.size());
+        if (size != idx.bwtR.size()) die(".rev.bwt and .bwt lengths differ.");
 
         idx.rR = idx.bwtR.number_of_runs();
         ulint rR = idx.rR;
         int log_rR = bitsize(rR);
 
-        std::cout << "done.\nNumber of runs in BWT^R  rR: " << rR << std::endl;
+        log << "done. " << seconds_since(t) << " s\nNumber of runs in BWT^R  rR: " << rR << std::endl;
 
-        std::cout << "(7/9) Reading SA^R samples at run boundaries ... " << std::flush;
+        log << "(7/9) Sorting SA^R samples at run boundaries ... " << std::flush;
+        t = std::chrono::steady_clock::now();
 
-        // read .rev.ssa
-        FILE* file_ssa_rev = open_aux_file(input_rev.c_str(),EXTSSA,"rb");
+        if (out.ssa.size() != rR) die(".rev.ssa read failed.");
+        if (out.esa.size() != rR) die(".rev.esa read failed.");
 
         idx.samples_firstR = sdsl::int_vector<>(rR,0,log_n);
         idx.first_to_runR = sdsl::int_vector<>(rR,0,log_rR);
         {
             auto pos_run_pairs = std::vector<std::pair<ulint,ulint>>(rR);
-            ulint* buf = new ulint[1];
             for (ulint i = 0; i < rR; ++i) {
-                if (fread(buf, SABYTES, 1, file_ssa_rev) != 1) die(".rev.ssa read failed.");
-                if (fread(buf, SABYTES, 1, file_ssa_rev) != 1) die(".rev.ssa read failed.");
-                ulint sa_val = buf[0] % (1UL << (8*SABYTES));
+                ulint sa_val = out.ssa[i];
                 sa_val = (sa_val > 0) ? (sa_val - 1) : (size-1);
                 idx.samples_firstR[i] = sa_val;
                 pos_run_pairs[i] = {sa_val,i};
             }
-            delete[] buf;
 
             std::sort(pos_run_pairs.begin(),pos_run_pairs.end());
 
@@ -353,27 +837,17 @@ public:
             }
             idx.firstR = br_index::sparse_bitvector_t(first_pos.cbegin(),first_pos.cend());
         }
-        fclose(file_ssa_rev);
-
-        // read .rev.esa
-        FILE* file_esa_rev = open_aux_file(input_rev.c_str(),EXTESA,"rb");
 
         idx.samples_lastR = sdsl::int_vector<>(rR,0,log_n);
         idx.last_to_runR = sdsl::int_vector<>(rR,0,log_rR);
-        ulint last_SA_valR; // temporary
         {
             auto pos_run_pairs = std::vector<std::pair<ulint,ulint>>(rR);
-            ulint* buf = new ulint[1];
             for (ulint i = 0; i < rR; ++i) {
-                if (fread(buf, SABYTES, 1, file_esa_rev) != 1) die(".rev.esa read failed.");
-                if (fread(buf, SABYTES, 1, file_esa_rev) != 1) die(".rev.esa read failed.");
-                ulint sa_val = buf[0] % (1UL << (8*SABYTES));
+                ulint sa_val = out.esa[i];
                 sa_val = (sa_val > 0) ? (sa_val - 1) : (size-1);
                 idx.samples_lastR[i] = sa_val;
                 pos_run_pairs[i] = {sa_val,i};
             }
-            last_SA_valR = buf[0] % (1UL << (8*SABYTES));
-            delete[] buf;
 
             std::sort(pos_run_pairs.begin(),pos_run_pairs.end());
 
@@ -384,93 +858,206 @@ public:
             }
             idx.lastR = br_index::sparse_bitvector_t(last_pos.cbegin(),last_pos.cend());
         }
-        fclose(file_esa_rev);
 
-        std::cout << "done.\n(8/9) Building run-length compressed PLCP^R ... " << std::flush;
+        log << "done. " << seconds_since(t) << " s\n(8/9) Building run-length compressed PLCP^R ... " << std::flush;
+        t = std::chrono::steady_clock::now();
 
-        // construct run-length encoded PLCP^R
-        {
-            std::vector<ulint> ones, zeros;
+        idx.plcpR = build_plcp(idx.bwtR, idx.firstR, idx.first_to_runR);
 
-            uchar c, c0;
-            ulint p, p0, pos, l, gap;
-            ulint prev_pos = 0;
-            ulint prev_l = 0;
-            ulint acc0=0, acc1=0;
+        log << "done. " << seconds_since(t) << " s\n(9/9) Building kmer^R[0,bl) ... " << std::flush;
+        t = std::chrono::steady_clock::now();
 
+        idx.kmerR = build_kmer(idx.bwtR, idx.samples_firstR, idx.plcpR,
+            [&](ulint i) { return idx.PhiR(i); }, [&](ulint i) { return idx.PhiIR(i); });
 
-            for (ulint i = 0; i < rR; ++i) {
-                pos = idx.firstR.select(i);
+        log << "done. " << seconds_since(t) << " s" << std::endl;
+
+        return *this;
+    }
+
+    // after both directions
+    br_index_builder& finish() {
+        std::cout << "Sampling PLCP on Phi/Phi^{-1} intervals ... " << std::flush;
+
+        idx.build_plcp_samples();
+
+        std::cout << "done." << std::endl;
+        std::cout << "Completed br-index construction." << std::endl;
+        
+        return *this;
+    }
+
+    // optional move structures for Phi/PhiI (constant-time locate steps)
+    br_index_builder& build_move_structures() {
+        std::cout << "Building move structures for Phi/Phi^{-1} ... " << std::flush;
+        idx.use_move_structures(true);
+        std::cout << "done." << std::endl;
+        return *this;
+    }
 
-                gap = i == 0 ? pos : (pos - prev_pos - 1);
+    // optional table of the samples of all occurring q-grams
+    br_index_builder& build_qgram_table(ulint q) {
+        std::cout << "Building table of " << q << "-gram samples ... " << std::flush;
+        idx.use_qgram_table(q);
+        std::cout << "done." << std::endl;
+        return *this;
+    }
+
+    // optional thresholds for matching statistics
+    br_index_builder& build_ms_thresholds() {
+        std::cout << "Computing matching statistics thresholds ... " << std::flush;
+        idx.use_ms_thresholds(true);
+        std::cout << "done." << std::endl;
+        return *this;
+    }
+
+    // optional LCP smaller value samples (contractions beyond bl in O(n/r) steps)
+    br_index_builder& build_lcp_psv() {
+        std::cout << "Sampling LCP smaller values for contractions ... " << std::flush;
+        idx.use_lcp_psv(true);
+        std::cout << "done." << std::endl;
+        return *this;
+    }
+
+    ulint save_to_file(std::string const& output) {
+        std::cout << "Saving PFP built br-index to " << output + "." + EXTIDX << " ... " << std::flush;
+        std::ofstream f(output + "." + EXTIDX);
+        ulint bytes = idx.serialize(f);
+        std::cout << "done.\nTotal index size: " << bytes << " bytes." << std::endl << std::endl;
+        return bytes;
+    }
 
-                l = 0;
-                ulint q = idx.bwtR.run_start(idx.first_to_runR[i]);
-                c = idx.bwtR[q];
-                p = idx.F[c] + idx.bwtR.rank(q,c);
+private:
+    // seconds since t, for the step messages
+    static std::string seconds_since(std::chrono::steady_clock::time_point t) {
+        std::ostringstream ss;
+        ss << std::fixed << std::setprecision(3)
+           << std::chrono::duration<double>(std::chrono::steady_clock::now() - t).count();
+        return ss.str();
+    }
+
+    // the walks from some run heads are much longer than from others, so the runs are cut
+    // into more chunks than workers and the chunks are handed out by a work-stealing pool
+    ulint number_of_chunks(ulint runs) const {
+        return std::min(workers > 1 ? 16 * workers : (ulint)1, runs);
+    }
+
+    // func(b, e, chunk) for the consecutive runs [b,e) of each chunk of [begin,end)
+    template<class func_t>
+    void for_chunks(ulint begin, ulint end, ulint chunks, func_t func) {
+        std::vector<ulint> tasks(chunks);
+        for (ulint c = 0; c < chunks; ++c) tasks[c] = c;
+        work_stealing_pool<ulint> pool(workers);
+        pool.run(tasks, [&](ulint c, ulint) {
+            func(begin + (end - begin) * c / chunks, begin + (end - begin) * (c + 1) / chunks, c);
+        });
+    }
+
+    // run-length encoded PLCP from the PLCP values at the run heads (steps 4 & 8)
+    template<class rle_t>
+    permuted_lcp<> build_plcp(rle_t const& bwt, br_index::sparse_bitvector_t const& first, sdsl::int_vector<> const& first_to_run) {
+
+        ulint size = idx.n;
+        ulint r = first_to_run.size();
+
+        // PLCP value of each run head in text order (by repeating FL(p) and bwt[p])
+        std::vector<ulint> head_lcp(r);
+        for_chunks(0, r, number_of_chunks(r), [&](ulint begin, ulint end, ulint) {
+            for (ulint i = begin; i < end; ++i) {
+                ulint l = 0;
+                ulint q = bwt.run_start(first_to_run[i]);
+                uchar c = bwt[q];
+                ulint p = idx.F[c] + bwt.rank(q,c);
                 if (p != 0) {
-                    p0 = p - 1;
-                    c0 = idx.F_at(p0);
+                    ulint p0 = p - 1;
+                    uchar c0 = idx.F_at(p0);
                     while (c == c0) {
-                        // compute FLR(p) & FLR(p0), compare BWT chars
+                        // compute FL(p) & FL(p0), compare BWT chars
                         l++;
-                        ulint i = p - idx.F[c];
-                        p = idx.bwtR.select(i,c);
+                        p = bwt.select(p - idx.F[c],c);
                         c = idx.F_at(p);
-                        ulint i0 = p0 - idx.F[c0];
-                        p0 = idx.bwtR.select(i0,c0);
+                        p0 = bwt.select(p0 - idx.F[c0],c0);
                         c0 = idx.F_at(p0);
                     }
                 }
+                head_lcp[i] = l;
+            }
+        });
 
-                if (i == 0) {
-                    if (l + gap > 0) {
-                        ones.push_back(acc1);
-                        acc0 += l + gap - 1;
-                        zeros.push_back(acc0);
-                        acc1 += gap + 1;
-                    } else {
-                        acc1 += gap + 1;
-                    }
-                } else if (l + gap + 1 - prev_l) {
+        std::vector<ulint> ones, zeros;
+
+        ulint pos, l, gap;
+        ulint prev_pos = 0;
+        ulint prev_l = 0;
+        ulint acc0=0, acc1=0;
+
+        for (ulint i = 0; i < r; ++i) {
+            // We encode PLCP by run-length manner
+            // For each bit of first (= run start bwt char),
+            // - add gap between the bit and the preceding bit in first to its PLCP value
+            // - difference between the value and the previous PLCP can be encoded
+            // Note that if first[j]=0, PLCP[j+1]=PLCP[j]-1 holds.
+            pos = first.select(i);
+
+            gap = i == 0 ? pos : (pos - prev_pos - 1);
+
+            l = head_lcp[i];
+
+            if (i == 0) {
+                if (l + gap > 0) {
                     ones.push_back(acc1);
-                    acc0 += l + gap + 1 - prev_l;
+                    acc0 += l + gap - 1;
                     zeros.push_back(acc0);
                     acc1 += gap + 1;
                 } else {
                     acc1 += gap + 1;
                 }
-
-                prev_pos = pos;
-                prev_l = l;
+            } else if (l + gap + 1 - prev_l) {
+                ones.push_back(acc1);
+                acc0 += l + gap + 1 - prev_l;
+                zeros.push_back(acc0);
+                acc1 += gap + 1;
+            } else {
+                acc1 += gap + 1;
             }
-            ones.push_back(acc1);
 
-            idx.plcpR = permuted_lcp<>(size,ones,zeros);
+            prev_pos = pos;
+            prev_l = l;
         }
+        ones.push_back(acc1);
 
-        std::cout << "done.\n(9/9) Building kmer^R[0,bl) ... " << std::flush;
+        return permuted_lcp<>(size,ones,zeros);
+    }
 
+    // kmer[0,bl) (contraction shortcut bitvectors) from the LCP around each run head (steps 5 & 9)
+    template<class rle_t, class phi_t, class phii_t>
+    std::vector<br_index::sparse_bitvector_t> build_kmer(rle_t const& bwt, sdsl::int_vector<> const& samples_first,
+                                                         permuted_lcp<> const& plcp, phi_t Phi, phii_t PhiI) {
 
-        // consruct kmerR[0,bl) (contraction shortcut bitvector)
-        {
-            auto kmer_pos = std::vector<std::vector<ulint>>(bl);
-            // first run head
-            for (ulint i = 0; i < bl; ++i) kmer_pos[i].push_back(0);
+        ulint size = idx.n;
+        ulint bl = idx.length;
+        ulint r = bwt.number_of_runs();
+
+        // positions found from the run heads [1,r) of each chunk, merged in chunk order
+        ulint chunks = number_of_chunks(r - 1);
+        auto chunk_pos = std::vector<std::vector<std::vector<ulint>>>(chunks, std::vector<std::vector<ulint>>(bl));
 
-            ulint prev_run_start = 0;
+        for_chunks(1, r, chunks, [&](ulint begin, ulint end, ulint chunk) {
+            auto& kmer_pos = chunk_pos[chunk];
+
+            ulint prev_run_start = bwt.run_start(begin-1);
             ulint run_start, run_end;
             ulint cur_sa, min_lcp_l, min_lcp_r;
 
-            for (ulint i = 1; i < rR; ++i) {
-                auto run_range = idx.bwtR.run_range(i);
+            for (ulint i = begin; i < end; ++i) {
+                auto run_range = bwt.run_range(i);
                 run_start = run_range.first;
                 run_end = run_range.second;
 
-                ulint start_sa = idx.samples_firstR[i] < size-1 ? idx.samples_firstR[i]+1 : 0;
-                min_lcp_l = min_lcp_r = idx.plcpR[start_sa];
+                ulint start_sa = samples_first[i] < size-1 ? samples_first[i]+1 : 0;
+                min_lcp_l = min_lcp_r = plcp[start_sa];
                 if (min_lcp_l > bl) min_lcp_l = min_lcp_r = bl;
-                
+
                 for (ulint l = min_lcp_l; l < bl; ++l) kmer_pos[l].push_back(run_start);
 
                 // backward scan from run head
@@ -478,12 +1065,12 @@ public:
                 for (ulint p = run_start-1; p > prev_run_start; --p) {
                     if (min_lcp_l==0) break;
 
-                    cur_sa = idx.PhiR(cur_sa);
-                    ulint lcp = idx.plcpR[cur_sa];
+                    cur_sa = Phi(cur_sa);
+                    ulint lcp = plcp[cur_sa];
                     if (lcp < min_lcp_l) {
                         for (ulint l = lcp; l < min_lcp_l; ++l) {
-                            if (kmer_pos[l].back() != p) kmer_pos[l].push_back(p);
-                        } 
+                            if (kmer_pos[l].empty() || kmer_pos[l].back() != p) kmer_pos[l].push_back(p);
+                        }
                         min_lcp_l = lcp;
                     }
                 }
@@ -492,8 +1079,8 @@ public:
                 for (ulint p = run_start+1; p <= run_end; ++p) {
                     if (min_lcp_r==0) break;
 
-                    cur_sa = idx.PhiIR(cur_sa);
-                    ulint lcp = idx.plcpR[cur_sa];
+                    cur_sa = PhiI(cur_sa);
+                    ulint lcp = plcp[cur_sa];
                     if (lcp < min_lcp_r) {
                         for (ulint l = lcp; l < min_lcp_r; ++l) kmer_pos[l].push_back(p);
                         min_lcp_r = lcp;
@@ -502,27 +1089,26 @@ public:
 
                 prev_run_start = run_start;
             }
-            // last run tail
-            for (ulint i = 0; i < bl; ++i) kmer_pos[i].push_back(size);
+        });
 
-            idx.kmerR = std::vector<br_index::sparse_bitvector_t>(bl);
-            for (ulint i = 0; i < bl; ++i) {
-                idx.kmerR[i] = br_index::sparse_bitvector_t(kmer_pos[i].cbegin(),kmer_pos[i].cend());
+        auto kmer = std::vector<br_index::sparse_bitvector_t>(bl);
+        for (ulint l = 0; l < bl; ++l) {
+            // first run head
+            std::vector<ulint> kmer_pos(1,0);
+            for (auto& buffers : chunk_pos) {
+                auto& v = buffers[l];
+                // the backward scan from the first run head of a chunk can find the last
+                // position of the previous chunk again
+                auto from = !v.empty() && v.front() == kmer_pos.back() ? v.cbegin() + 1 : v.cbegin();
+                kmer_pos.insert(kmer_pos.end(), from, v.cend());
+                std::vector<ulint>().swap(v);
             }
-        }
-
-        std::cout << "done." << std::endl;
-        std::cout << "Completed br-index construction." << std::endl;
-        
-        return *this;
-    }
+            // last run tail
+            kmer_pos.push_back(size);
 
-    ulint save_to_file(std::string const& output) {
-        std::cout << "Saving PFP built br-index to " << output + "." + EXTIDX << " ... " << std::flush;
-        std::ofstream f(output + "." + EXTIDX);
-        ulint bytes = idx.serialize(f);
-        std::cout << "done.\nTotal index size: " << bytes << " bytes." << std::endl << std::endl;
-        return bytes;
+            kmer[l] = br_index::sparse_bitvector_t(kmer_pos.cbegin(),kmer_pos.cend());
+        }
+        return kmer;
     }
 };
 
@@ -532,12 +1118,29 @@ void print_help(char** argv, Args &args) {
     std::cout << "Usage: " << argv[ 0 ] << " <input filename> [options]" << std::endl;
     std::cout << "Build br-index from Prefix-Free Parsed files." << std::endl;
     std::cout << " .bwt, .ssa, .esa, .rev.bwt, .rev.ssa, .rev.esa are necessary" << std::endl;
-    std::cout << " unless you use -i option (in-memory construction, slow&memory consuming)." << std::endl << std::endl;
+    std::cout << " unless you use -P option (run the parsing from the text, its output is streamed)" << std::endl;
+    std::cout << " or -i option (in-memory construction, slow&memory consuming)." << std::endl;
+    std::cout << "With -P, the text is parsed once and the parse of the reversed text is derived from it;" << std::endl;
+    std::cout << " the final BWT & SA samples are read from named pipes, so only the parse and the dictionary" << std::endl;
+    std::cout << " touch the disk. Wall time, disk traffic and peak RSS of each stage are reported." << std::endl;
+    std::cout << "The output does not depend on -t or -M." << std::endl << std::endl;
     std::cout << "  Options: " << std::endl
         << "\t-h  \tshow help and exit" << std::endl
         << "\t-i  \tin-memory construction using constructor of br_index class" << std::endl
+        << "\t-k  \twith -P, keep the parsing files" << std::endl
         << "\t-l L\tparameter bl for contraction shortcut, def. " << args.bl << std::endl
-        << "\t-o O\tspecified output index file basename, def. <input filename> " << std::endl;
+        << "\t-m  \tstore move structures for Phi/Phi^{-1} (faster locate, more space)" << std::endl
+        << "\t-M M\tpeak memory budget in MB: both directions are built at once while their estimated" << std::endl
+        << "\t    \tpeaks fit, one after the other otherwise (0: always the latter), def. available memory" << std::endl
+        << "\t-o O\tspecified output index file basename, def. <input filename> " << std::endl
+        << "\t-p P\twith -P, modulus of the parsing, def. " << args.mod << std::endl
+        << "\t-P  \trun Prefix-Free Parsing on the text and stream the final BWT & SA samples" << std::endl
+        << "\t-q Q\tstore the samples of all q-grams (searches start at depth q), def. none" << std::endl
+        << "\t-s  \tstore LCP smaller value samples (faster contractions beyond bl, more space)" << std::endl
+        << "\t-t T\tnumber of helper threads of the PLCP & kmer steps of each direction and, with -P," << std::endl
+        << "\t    \tof the parsing & the final BWT, def. none" << std::endl
+        << "\t-T  \tstore matching statistics thresholds (bri-query ms), implies -s" << std::endl
+        << "\t-w W\twith -P, sliding window size of the parsing, def. " << args.wsize << std::endl;
     exit(1);
 }
 
@@ -554,7 +1157,7 @@ void parse_args( int argc, char** argv, Args& arg ) {
     puts("");
 
     std::string sarg;
-    while ((c = getopt( argc, argv, "hil:o:v") ) != -1) {
+    while ((c = getopt( argc, argv, "hikl:mM:o:p:Pq:sTt:vw:") ) != -1) {
         switch(c) {
             case 'l':
             sarg.assign( optarg );
@@ -568,6 +1171,31 @@ void parse_args( int argc, char** argv, Args& arg ) {
             print_help(argv, arg); exit(1);
             case 'i':
             arg.inmemory = true; break;
+            case 'k':
+            arg.keep = true; break;
+            case 'p':
+            sarg.assign( optarg );
+            arg.mod = stoi( sarg ); break;
+            case 'P':
+            arg.pfp = true; break;
+            case 't':
+            sarg.assign( optarg );
+            arg.threads = stoi( sarg ); break;
+            case 'w':
+            sarg.assign( optarg );
+            arg.wsize = stoi( sarg ); break;
+            case 'm':
+            arg.move = true; break;
+            case 'M':
+            sarg.assign( optarg );
+            arg.mem_budget = stoul( sarg ) << 20; break;
+            case 'q':
+            sarg.assign( optarg );
+            arg.q = stoi( sarg ); break;
+            case 's':
+            arg.psv = true; break;
+            case 'T':
+            arg.thresholds = arg.psv = true; break;
             case '?':
             std::cout << "Unknown option. Use -h for help." << std::endl;
             exit(1);
@@ -587,6 +1215,18 @@ void parse_args( int argc, char** argv, Args& arg ) {
         std::cout << "bl must be nonnegative integer\n";
         exit(1);
     }
+    if(arg.q < 0) {
+        std::cout << "q must be nonnegative integer\n";
+        exit(1);
+    }
+    if(arg.threads < 0) {
+        std::cout << "t must be nonnegative integer\n";
+        exit(1);
+    }
+    if(arg.pfp && (arg.wsize < 4 || arg.mod < 10)) {
+        std::cout << "invalid parsing parameters (w >= 4, p >= 10)\n";
+        exit(1);
+    }
 }
 
 int main(int argc, char** argv) {
@@ -603,6 +1243,10 @@ int main(int argc, char** argv) {
         input = buffer.str();
 
         br_index idx(input,arg.bl,false);
+        if (arg.move) idx.use_move_structures(true);
+        if (arg.psv) idx.use_lcp_psv(true);
+        if (arg.q > 0) idx.use_qgram_table(arg.q);
+        if (arg.thresholds) idx.use_ms_thresholds(true);
 
         std::cout << "Saving in-memory built br-index to " << arg.output_base + "." + EXTIDX << " ... " << std::flush;
         std::ofstream f(arg.output_base + "." + EXTIDX);
@@ -613,5 +1257,40 @@ int main(int argc, char** argv) {
     }
 
     br_index_builder builder;
-    ulint idx_size = builder.build_from_pfp(arg.input_file,arg.bl).save_to_file(arg.output_base);
+    stage_report stages;
+    memory_budget budget(arg.mem_budget);
+    std::cout << "Memory budget of concurrent stages: " << budget.size() / 1048576 << " MB" << std::endl;
+
+    if (!arg.pfp) {
+        builder.build_from_pfp(arg.input_file,arg.bl,arg.threads,budget,stages);
+    }
+    else {
+        std::cout << "Building br-index on " << arg.input_file << std::endl;
+        std::cout << "  running Prefix-Free Parsing (w=" << arg.wsize << ", p=" << arg.mod << "), log in "
+                  << arg.input_file << ".log" << std::endl;
+
+        pfp_pipeline pipeline(arg, stages, budget);
+        builder.build_directions([&](bool reversed, pfp_output& out) { pipeline.run(reversed, out); }, arg.bl, arg.threads, budget, stages);
+
+        auto t = stages.begin();
+        builder.finish();
+        stages.end(t, "PLCP samples");
+    }
+    if (budget.delayed_stages() > 0)
+        std::cout << budget.delayed_stages() << " stage(s) waited for the memory budget." << std::endl;
+
+    if (arg.move || arg.psv || arg.q > 0 || arg.thresholds) {
+        auto t = stages.begin();
+        if (arg.move) builder.build_move_structures();
+        if (arg.psv) builder.build_lcp_psv();
+        if (arg.q > 0) builder.build_qgram_table(arg.q);
+        if (arg.thresholds) builder.build_ms_thresholds();
+        stages.end(t, "Optional structures");
+    }
+    auto t = stages.begin();
+    builder.save_to_file(arg.output_base);
+    stages.end(t, "Saving");
+    stages.print_total();
+
+    return 0;
 }
\ No newline at end of file
@@ -69,7 +69,7 @@ void *mt_parse(void *dx)
     word.append(1,c);
     uint64_t hash = krw.addchar(c);
     d->parsed++;
-    if(hash%arg->p==0 && d->parsed>arg->w) {
+    if(hash%arg->p==0 && word.size()>(size_t)arg->w) { // as in save_update_word: the first word also holds Dollar
       // end of word, save it and write its full hash to the output file
       // pos is the ending position+1 of previous word and is updated in the next call
       save_update_word(*arg,word,*wordFreq,d->parse,d->last,d->sa,pos);
@@ -81,6 +81,7 @@ void *mt_parse(void *dx)
   // virtually add w null chars at the end of the file and add the last word in the dict
   word.append(arg->w,Dollar);
   save_update_word(*arg,word,*wordFreq,d->parse,d->last,d->sa,pos);
+  d->words++; // counted, or the chars of a thread with only this word are lost in the check
   // close input file and return 
   f.close();
   return NULL;
@@ -136,7 +137,7 @@ uint64_t mt_process_file(Args& arg, map<uint64_t,word_stats>& wf)
     if(td[i].sa) fclose(td[i].sa);
     if(td[i].words>0) {
       // extra check
-      assert(td[i].parsed>arg.w);
+      assert(td[i].parsed>=arg.w); // = w: only the final word, made of the last window
       tot_char += td[i].parsed - (i!=0? arg.w: 0); //parsed - overlapping 
     }
     else assert(i>0); // the first thread must produce some words
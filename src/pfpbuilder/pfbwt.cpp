@@ -383,7 +383,11 @@ int main(int argc, char** argv)
   e = fread(bwlast,1,psize,g);
   if(e!=psize) die("fread 4");
   fclose(g);
-  
+  // a Dollar precedes the text only when the first word is Dollar+trigger:
+  // the word is too short for the dictionary SA, so set the EOF char here
+  for(long i=0;i<psize;i++)
+    if(bwlast[i]==Dollar) bwlast[i]=0;
+
   // convert occ entries into starting positions inside ilist
   // ilist also contains the position of EOF but we don't care about it since it is not in dict 
   uint32_t last=1; // starting position in ilist of the smallest dictionary word  
@@ -193,6 +193,13 @@ typedef struct {
   int bwt_fd;                // file descriptor for the bwt output file  
   bool SA;                   // if true the full SA is required 
   int sa_fd;                 // file descriptor for the sa output file  
+  int sampledSA;             // START_RUN|END_RUN if sampled SA values are required
+  FILE *fbwt, *ssafile, *esafile; // sequential outputs used with sampledSA 
+  pthread_mutex_t write_m;   // with write_c, ranges wait their turn to be written
+  pthread_cond_t write_c;
+  long bwt_written;          // bwt chars written so far, access with write_m
+  int lastbwt;               // last bwt char written and its SA value
+  uint64_t lastSa;
   uint8_t *bwsainfo;         // positions in the origina text of parsed words
   long psize;                // size of bwsainfo
   long full_words;           // output parameters, access with a mutex_consumer
@@ -292,6 +299,42 @@ static void write_chars_same_suffix_sa(vector<uint32_t> &id2merge,  vector<uint8
 
 
 
+// write the bwt chars and the sampled SA values of a range to the sequential
+// outputs (possibly pipes). Ranges are written in bwt order since a run
+// can span the boundary between two of them: each one waits for its turn
+static void write_sampled_range(thread_data *d, da_range &r, uint8_t *local_bwt, uint8_t *local_sa)
+{
+  xpthread_mutex_lock(&d->write_m,__LINE__,__FILE__);
+  while(d->bwt_written!=r.bwt_start)
+    xpthread_cond_wait(&d->write_c,&d->write_m,__LINE__,__FILE__);
+  xpthread_mutex_unlock(&d->write_m,__LINE__,__FILE__);
+  // same (pos,SA[pos]) pairs as fwrite_chars_same_suffix_ssa()
+  if(fwrite(local_bwt,1,r.count,d->fbwt)!=(size_t) r.count) die("BWT write error (multi)");
+  for(long c=0;c<r.count;c++) {
+    uint64_t sa=0;
+    memcpy(&sa,local_sa + c*SABYTES,SABYTES);
+    if(local_bwt[c]!=d->lastbwt) {
+      uint64_t pos = r.bwt_start + c;
+      if(d->sampledSA & START_RUN) {
+        if(fwrite(&pos,SABYTES,1,d->ssafile)!=1) die("sampled SA write error 3a");
+        if(fwrite(&sa,SABYTES,1,d->ssafile)!=1) die("sampled SA write error 3b");
+      }
+      if((d->sampledSA & END_RUN) && pos>0) { // first BWT entry goes only to the ssa file
+        pos--;
+        if(fwrite(&pos,SABYTES,1,d->esafile)!=1) die("sampled SA write error 3c");
+        if(fwrite(&d->lastSa,SABYTES,1,d->esafile)!=1) die("sampled SA write error 3d");
+      }
+      d->lastbwt = local_bwt[c];
+    }
+    d->lastSa = sa;
+  }
+  xpthread_mutex_lock(&d->write_m,__LINE__,__FILE__);
+  d->bwt_written += r.count;
+  xpthread_cond_broadcast(&d->write_c,__LINE__,__FILE__);
+  xpthread_mutex_unlock(&d->write_m,__LINE__,__FILE__);
+}
+
+
 static void *merge_body(void *v)
 {
   thread_data *d = (thread_data *) v;
@@ -299,6 +342,7 @@ static void *merge_body(void *v)
   long i, next, c, full_words=0, easy_bwts=0, hard_bwts=0;
   uint8_t *local_bwt = NULL;
   uint8_t *local_sa = NULL;
+  bool sa_values = d->SA || d->sampledSA!=0; // SA value of every bwt entry needed 
   // main loop 
   while(true) {
     // --- get starting position from buffer 
@@ -312,7 +356,7 @@ static void *merge_body(void *v)
     // process range [start,end]
     local_bwt = (uint8_t *) realloc(local_bwt,r.count);
     assert(local_bwt!=NULL);
-    if(d->SA) { // if we need to compute the sa, alloc space for it
+    if(sa_values) { // if we need to compute the sa, alloc space for it
       local_sa = (uint8_t *) realloc(local_sa,SABYTES*r.count);
       assert(local_sa!=NULL);
     }
@@ -328,12 +372,16 @@ static void *merge_body(void *v)
         full_words++;
         for(long j=d->istart[seqid];j<d->istart[seqid+1];j++) {
           int nextbwt = d->last[d->ilist[j]]; // compute next bwt char
-          if(d->SA) {
+          if(sa_values) {
             uint64_t sa = 0;
             if(seqid>0) { // if not the first word in the parse output SA values
               sa = get_myint(d->bwsainfo,d->psize,d->ilist[j]) - d->suflen[i];
             }
-            else assert(j==1); // the first word in the parse is the 2nd lex smaller
+            else {
+              assert(j==1); // the first word in the parse is the 2nd lex smaller
+              if(d->sampledSA) // very first BWT char, its SA value is the length of the text 
+                sa = get_myint(d->bwsainfo,d->psize,0) - d->w;
+            }
             // if seqid==0 we are writing and invalid 0 value, but it will not be copied in the sa file
             // this is done to keep the number of items written to bwt_local and sa_local equals  
             memcpy(local_sa + c*SABYTES,&sa,SABYTES);
@@ -357,7 +405,7 @@ static void *merge_body(void *v)
         }
         else break;
       }
-      if(d->SA)
+      if(sa_values)
         write_chars_same_suffix_sa(id2merge, char2write, d->ilist,d->istart,local_bwt,local_sa,c,easy_bwts,hard_bwts,
         d->suflen[i],d->bwsainfo,d->psize);
       else
@@ -365,6 +413,10 @@ static void *merge_body(void *v)
     }
     assert(i==r.end);
     assert(c==r.count);
+    if(d->sampledSA) {
+      write_sampled_range(d,r,local_bwt,local_sa);
+      continue;
+    }
     // write local_bwt to file d->bwt_fd starting from position r.bwt_start
     fd_write(d->bwt_fd,local_bwt,r.count,r.bwt_start);
     // if requested write SA values to file d->sa_fd
@@ -406,10 +458,6 @@ void bwt_multi(Args &arg, uint8_t *d, long dsize, // dictionary and its size
 {  
   (void) psize; // used only in assertions
   assert(arg.th>0); 
-  if(arg.sampledSA) {
-    cout << "Mutithread version doesn't support computation of sampled SA values yet\n";
-    exit(1);
-  }
   // possibly read bwsa info file
   uint8_t *bwsainfo = load_bwsa_info(arg,psize);
   
@@ -437,9 +485,22 @@ void bwt_multi(Args &arg, uint8_t *d, long dsize, // dictionary and its size
   td.full_words = td.easy_bwts = td.hard_bwts = 0;
   td.cindex=0;
   pc_init(&td.free_slots,&td.data_items,&td.cons_m); 
-  td.bwt_fd = get_bwt_fd(arg.basename); // file descriptor of output bwt file
   td.SA = arg.SA;                       // fields possibly used for SA computation 
   td.sa_fd = arg.SA ? get_sa_fd(arg.basename) : -1; // sa_fd<0 means SA not requested  
+  td.sampledSA = arg.sampledSA;
+  td.fbwt = td.ssafile = td.esafile = NULL;
+  if(arg.sampledSA) { // written in order, so the outputs can be pipes 
+    td.bwt_fd = -1;
+    td.fbwt = open_aux_file(arg.basename,"bwt","wb");
+    if(arg.sampledSA & START_RUN) td.ssafile = open_aux_file(arg.basename,EXTSSA,"wb");
+    if(arg.sampledSA & END_RUN) td.esafile = open_aux_file(arg.basename,EXTESA,"wb");
+    xpthread_mutex_init(&td.write_m,NULL,__LINE__,__FILE__);
+    xpthread_cond_init(&td.write_c,NULL,__LINE__,__FILE__);
+    td.bwt_written = 0;
+    td.lastbwt = Dollar;  // this is certainly not a BWT char
+    td.lastSa = UINT64_MAX;
+  }
+  else td.bwt_fd = get_bwt_fd(arg.basename); // file descriptor of output bwt file
   td.bwsainfo = bwsainfo;
   td.psize = psize;
   // start consumer threads
@@ -501,13 +562,29 @@ void bwt_multi(Args &arg, uint8_t *d, long dsize, // dictionary and its size
   for(int i=0;i<arg.th;i++)
     xpthread_join(t[i],NULL,__LINE__,__FILE__);
 
+  if(arg.sampledSA) {
+    assert(td.bwt_written==written+entries);
+    if(arg.sampledSA & END_RUN) { // write very last Sa pair 
+      uint64_t pos = td.bwt_written-1;
+      if(fwrite(&pos,SABYTES,1,td.esafile)!=1) die("sampled SA write error 3e");
+      if(fwrite(&td.lastSa,SABYTES,1,td.esafile)!=1) die("sampled SA write error 3f");
+    }
+  }
   assert(td.full_words==dwords);  
   cout << "Full words: " << td.full_words << endl;
   cout << "Easy bwt chars: " << td.easy_bwts << endl;
   cout << "Hard bwt chars: " << td.hard_bwts << endl;
   cout << "Generating the final BWT took " << difftime(time(NULL),start) << " wall clock seconds (" << arg.th <<" threads, range "<< Min_bwt_range<<")\n";    
   pc_destroy(&td.free_slots,&td.data_items,&td.cons_m);
-  close(td.bwt_fd); // close bwt file
+  if(arg.sampledSA) {
+    if(fclose(td.fbwt)!=0) die("BWT file close");
+    if(td.ssafile && fclose(td.ssafile)!=0) die("ssa file close");
+    if(td.esafile && fclose(td.esafile)!=0) die("esa file close");
+    xpthread_cond_destroy(&td.write_c,__LINE__,__FILE__);
+    xpthread_mutex_destroy(&td.write_m,__LINE__,__FILE__);
+    free(bwsainfo);
+  }
+  else close(td.bwt_fd); // close bwt file
   delete[] lcp;
   delete[] sa;
   if(arg.SA) {
@@ -105,7 +105,7 @@ static void *mt_parse(void *dx)
     word.append(1,c);
     uint64_t hash = krw.addchar(c);
     d->parsed++;
-    if(hash%arg->p==0 && d->parsed>arg->w) {
+    if(hash%arg->p==0 && word.size()>(size_t)arg->w) { // as in save_update_word: the first word also holds Dollar
       // end of word, save it and write its full hash to the output file
       // pos is the ending position+1 of previous word and is updated in the next call
       mt_save_update_word(*arg,word,pos,d);
@@ -117,6 +117,7 @@ static void *mt_parse(void *dx)
   // virtually add w null chars at the end of the file and add the last word in the dict
   word.append(arg->w,Dollar);
   mt_save_update_word(*arg,word,pos,d);
+  d->words++; // counted, or the chars of a thread with only this word are lost in the check
   // close input file and return 
   f.close();
   return NULL;
@@ -171,7 +172,7 @@ static void *mt_parse_reverse(void *dx)
   // cout << "Skipped: " << d->skipped << endl;
   
   // there is some parsing to do
-  uint64_t pos = d->start;             // ending position+1 in text of previous word
+  uint64_t pos = size - d->end;        // ending position+1 in the reversed text of previous word
   if(pos>0) pos+= d->skipped+ arg->w;  // or 0 for the first word
   if(arg->SAinfo) assert(IBYTES<=sizeof(pos)); // IBYTES bytes of pos are written to the sa info file 
   while( (c = bf.get()) != EOF ) {
@@ -182,7 +183,7 @@ static void *mt_parse_reverse(void *dx)
     word.append(1,c);
     uint64_t hash = krw.addchar(c);
     d->parsed++;
-    if(hash%arg->p==0 && d->parsed>arg->w) {
+    if(hash%arg->p==0 && word.size()>(size_t)arg->w) { // as in save_update_word: the first word also holds Dollar
       // end of word, save it and write its full hash to the output file
       // pos is the ending position+1 of previous word and is updated in the next call
       mt_save_update_word(*arg,word,pos,d);
@@ -194,6 +195,7 @@ static void *mt_parse_reverse(void *dx)
   // virtually add w null chars at the end of the file and add the last word in the dict
   word.append(arg->w,Dollar);
   mt_save_update_word(*arg,word,pos,d);
+  d->words++; // counted, or the chars of a thread with only this word are lost in the check
   // close input file and return 
   bf.close();
   return NULL;
@@ -263,7 +265,7 @@ static uint64_t mt_process_file(Args& arg, MTmaps &mtmaps)
     if(td[i].sa_file) fclose(td[i].sa_file);
     if(td[i].words>0) {
       // extra check
-      assert(td[i].parsed>arg.w);
+      assert(td[i].parsed>=arg.w); // = w: only the final word, made of the last window
       tot_char += td[i].parsed - (i!=0? arg.w: 0); //parsed - overlapping 
     }
     else assert(i>0); // the first thread must produce some words
@@ -0,0 +1,233 @@
+/* ******************************************************************************
+ * revparse.c
+ *
+ * prefix-free parse of the reversed text computed from the parse of the
+ * text, without scanning the text again. The trigger strings of the parse
+ * of T, reversed, are trigger strings for T^R: the words of the parse of
+ * T^R are the words of the parse of T reversed, in reversed order. Only the
+ * ends of the text change, since T^R also starts with a single Dollar and
+ * ends with w Dollars.
+ *
+ * Usage:
+ *   revparse <basename> [options]
+ *
+ * reads basename.dict, .occ and .parse (written by newscan.x or pscan.x)
+ * and writes basename.rev.dict, .occ, .parse, .last and (option -s) .sai
+ * in the same formats as newscan.x -r, to be processed by bwtparse and
+ * pfbwt.x as usual.
+ * ****************************************************************************** */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <time.h>
+#include <sys/mman.h>
+#include "utils.h"
+
+// -------------------------------------------------------------
+// struct containing command line parameters and other globals
+typedef struct {
+   char *basename;
+   char *revname;
+   int w;        // window size
+   bool SAinfo;  // write the .sai file
+} Args;
+
+
+static void print_help(char *name)
+{
+  printf("Usage: %s <basename> [options]\n\n", name);
+  puts("Compute the prefix-free parse of the reversed text from files");
+  puts("."EXTDICT" ."EXTOCC" and ."EXTPARSE" of the text");
+  puts("  Options:");
+  puts("\t-w wsize     window size (def. 10)");
+  puts("\t-s           compute suffix array info");
+  puts("\t-h           show help and exit");
+  exit(1);
+}
+
+static void parseArgs(int argc, char** argv, Args *arg ) {
+  extern int optind, opterr, optopt;
+  extern char *optarg;
+  int c;
+
+  puts("==== Command line:");
+  for(int i=0;i<argc;i++)
+    printf(" %s",argv[i]);
+  puts("\n");
+
+  arg->w = 10;
+  arg->SAinfo = false;
+  while ((c = getopt( argc, argv, "hw:s") ) != -1) {
+    switch(c) {
+      case 's':
+        arg->SAinfo = true; break;
+      case 'h':
+         print_help(argv[0]); exit(1);
+      case 'w':
+        arg->w = atoi(optarg); break;
+      case '?':
+      puts("Unknown option. Use -h for help.");
+      exit(1);
+    }
+  }
+  // input base name is the only non-optional parameter
+  if (argc!=optind+1)
+    print_help(argv[0]);
+  if(arg->w<1) die("Invalid window size");
+  arg->basename = strdup(argv[optind]);
+  int e = asprintf(&arg->revname,"%s.rev",arg->basename);
+  if(e<0) die("Error creating output file name");
+}
+
+static void *mmap_fd(int fd, size_t *n)
+{
+  off_t off = lseek(fd,0,SEEK_END);
+  if(off<0) die("seek error on input file");
+  void *a = mmap(NULL,off,PROT_READ,MAP_PRIVATE,fd,0);
+  if(a==MAP_FAILED) die("mmap error on input file");
+  *n =off;
+  return a;
+}
+
+// reversed words, compared by qsort_r as std::string does in newscan.x
+typedef struct {
+  uint8_t *rev;
+  uint64_t *start;
+  uint64_t *len;
+} Words;
+
+static int cmp_words(const void *a, const void *b, void *v)
+{
+  Words *W = (Words *) v;
+  uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+  uint64_t lx = W->len[x], ly = W->len[y];
+  int e = memcmp(W->rev+W->start[x],W->rev+W->start[y],lx<ly ? lx : ly);
+  if(e!=0) return e;
+  return lx<ly ? -1 : (lx>ly ? 1 : 0);
+}
+
+int main(int argc, char *argv[])
+{
+  Args arg;        // command line arguments
+  uint8_t *Dict;   // dictionary
+  size_t n;        // length of dictionary
+
+  // read arguments
+  parseArgs(argc,argv,&arg);
+  // start measuring wall clock time
+  time_t start_wc = time(NULL);
+  int w = arg.w;
+
+  // mmap dictionary file to memory and count the words
+  int fd = fd_open_aux_file(arg.basename,EXTDICT,O_RDONLY);
+  Dict = mmap_fd(fd,&n);
+  if(close(fd)!=0) die("error closing dictionary file");
+  if(n<2 || Dict[0]!=Dollar || Dict[n-1]!=EndOfDict) die("invalid dictionary file");
+  long words = 0;
+  for(size_t i=0;i<n;i++)
+    if(Dict[i]==EndOfWord) words++;
+  if(words>0x7FFFFFFE) die("Too many words in the dictionary");
+  printf("Found %ld dictionary words\n",words);
+
+  // reverse each word: a leading Dollar (first word of the text) becomes w
+  // trailing Dollars and w trailing Dollars (last word) a leading Dollar.
+  // The two changes cancel out, so the total length does not change
+  Words W;
+  W.rev = malloc(n);
+  W.start = malloc(words*sizeof(*W.start));
+  W.len = malloc(words*sizeof(*W.len));
+  if(W.rev==NULL || W.start==NULL || W.len==NULL) die("Allocation error");
+  uint64_t s = 0, r = 0;
+  for(long i=0;i<words;i++) {
+    uint64_t e = s;
+    while(Dict[e]!=EndOfWord) e++;
+    uint64_t a = Dict[s]==Dollar ? 1 : 0;
+    uint64_t b = e-s>=(uint64_t) w+a && Dict[e-1]==Dollar ? w : 0;
+    assert(a==0 || i==0); // the first word is the only one starting with Dollar
+    W.start[i] = r;
+    if(b) W.rev[r++] = Dollar;
+    for(uint64_t j=e-b;j>s+a;j--)
+      W.rev[r++] = Dict[j-1];
+    for(uint64_t j=0;j<(a ? (uint64_t) w : 0);j++)
+      W.rev[r++] = Dollar;
+    if(r>n) die("invalid dictionary file (Dollars)");
+    W.len[i] = r-W.start[i];
+    if(W.len[i]<=(uint64_t) w) die("invalid dictionary file (short word)");
+    s = e+1;
+  }
+  assert(s==n-1);
+
+  // sort the reversed words and compute the new 1-based ranks
+  uint32_t *sorted = malloc(words*sizeof(*sorted));
+  uint32_t *rank = malloc(words*sizeof(*rank));
+  if(sorted==NULL || rank==NULL) die("Allocation error");
+  for(long i=0;i<words;i++) sorted[i] = i;
+  qsort_r(sorted,words,sizeof(*sorted),cmp_words,&W);
+  for(long i=0;i<words;i++) rank[sorted[i]] = i+1;
+
+  // dictionary and occ files
+  fd = fd_open_aux_file(arg.basename,EXTOCC,O_RDONLY);
+  size_t occsize;
+  uint32_t *occ = mmap_fd(fd,&occsize);
+  if(close(fd)!=0) die("error closing occ file");
+  if(occsize!=words*sizeof(*occ)) die("invalid occ file");
+  FILE *fdict = open_aux_file(arg.revname,EXTDICT,"wb");
+  FILE *focc = open_aux_file(arg.revname,EXTOCC,"wb");
+  for(long i=0;i<words;i++) {
+    uint32_t x = sorted[i];
+    if(fwrite(W.rev+W.start[x],1,W.len[x],fdict)!=W.len[x]) die("Error writing to DICT file");
+    if(fputc(EndOfWord,fdict)==EOF) die("Error writing EndOfWord to DICT file");
+    if(fwrite(&occ[x],sizeof(*occ),1,focc)!=1) die("Error writing to OCC file");
+  }
+  if(fputc(EndOfDict,fdict)==EOF) die("Error writing EndOfDict to DICT file");
+  if(fclose(fdict)!=0) die("Error closing DICT file");
+  if(fclose(focc)!=0) die("Error closing OCC file");
+  munmap(occ,occsize);
+
+  // parse, last and sa info files, reading the parse backwards
+  fd = fd_open_aux_file(arg.basename,EXTPARSE,O_RDONLY);
+  size_t psize;
+  uint32_t *parse = mmap_fd(fd,&psize);
+  if(close(fd)!=0) die("error closing parse file");
+  if(psize%4!=0 || psize==0) die("invalid parse file");
+  psize /= 4;
+  printf("Parsing size: %zu\n",psize);
+  FILE *fparse = open_aux_file(arg.revname,EXTPARSE,"wb");
+  FILE *flast = open_aux_file(arg.revname,EXTLST,"wb");
+  FILE *fsai = arg.SAinfo ? open_aux_file(arg.revname,EXTSAI,"wb") : NULL;
+  uint64_t pos = 0; // ending position +1 of previous word in the reversed text
+  assert(IBYTES<=sizeof(pos));
+  for(size_t k=psize;k>0;k--) {
+    uint32_t x = parse[k-1];
+    if(x==0 || x>words) die("Invalid word ID in the parse file");
+    x--;
+    if(k==psize && W.rev[W.start[x]]!=Dollar) die("invalid parse file (last word)");
+    if(fwrite(&rank[x],sizeof(*rank),1,fparse)!=1) die("Error writing to new parse file");
+    // char w+1 from the end and ending position+1 of the word, as in newscan.x
+    if(fputc(W.rev[W.start[x]+W.len[x]-w-1],flast)==EOF) die("Error writing to .last file");
+    if(pos==0) pos = W.len[x]-1; // -1 is for the initial $ of the first word
+    else pos += W.len[x]-w;
+    if(fsai) if(fwrite(&pos,IBYTES,1,fsai)!=1) die("Error writing to sa info file");
+  }
+  if(fclose(fparse)!=0) die("Error closing new parse file");
+  if(fclose(flast)!=0) die("Error closing last file");
+  if(fsai) if(fclose(fsai)!=0) die("Error closing SA file");
+  munmap(parse,psize*4);
+
+  free(rank);
+  free(sorted);
+  free(W.len);
+  free(W.start);
+  free(W.rev);
+  munmap(Dict,n);
+  free(arg.revname);
+  free(arg.basename);
+  printf("==== Elapsed time: %.0lf wall clock seconds\n", difftime(time(NULL),start_wc));
+  return 0;
+}
@@ -93,6 +93,52 @@ int xpthread_mutex_unlock(pthread_mutex_t *mutex, int linea, const char *file) {
 }
 
 
+// condition variables
+int xpthread_cond_init(pthread_cond_t *cond, const pthread_condattr_t *attr, int linea, const char *file) {
+  int e = pthread_cond_init(cond, attr);
+  if (e!=0) {
+    xperror(e, "Error in pthread_cond_init");
+    fprintf(stderr,"== %d == Line: %d, File: %s\n",getpid(),linea,file);
+    sleep(Thread_error_wait);  // do not kill immediately other threads 
+    exit(1);
+  }
+  return e;
+}
+
+int xpthread_cond_destroy(pthread_cond_t *cond, int linea, const char *file) {
+  int e = pthread_cond_destroy(cond);
+  if (e!=0) {
+    xperror(e, "Error in pthread_cond_destroy");
+    fprintf(stderr,"== %d == Line: %d, File: %s\n",getpid(),linea,file);
+    sleep(Thread_error_wait);  // do not kill immediately other threads 
+    exit(1);
+  }
+  return e;
+}
+
+int xpthread_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex, int linea, const char *file) {
+  int e = pthread_cond_wait(cond, mutex);
+  if (e!=0) {
+    xperror(e, "Error in pthread_cond_wait");
+    fprintf(stderr,"== %d == Line: %d, File: %s\n",getpid(),linea,file);
+    sleep(Thread_error_wait);  // do not kill immediately other threads 
+    exit(1);
+  }
+  return e;
+}
+
+int xpthread_cond_broadcast(pthread_cond_t *cond, int linea, const char *file) {
+  int e = pthread_cond_broadcast(cond);
+  if (e!=0) {
+    xperror(e, "Error in pthread_cond_broadcast");
+    fprintf(stderr,"== %d == Line: %d, File: %s\n",getpid(),linea,file);
+    sleep(Thread_error_wait);  // do not kill immediately other threads 
+    exit(1);
+  }
+  return e;
+}
+
+
 // semaphores
 int xsem_init(sem_t *sem, int pshared, unsigned int value, int linea, const char *file) {
   int e = sem_init(sem,pshared,value);
@@ -26,6 +26,12 @@ int xpthread_mutex_destroy(pthread_mutex_t *mutex, int linea, const char *file);
 int xpthread_mutex_lock(pthread_mutex_t *mutex, int linea, const char *file);
 int xpthread_mutex_unlock(pthread_mutex_t *mutex, int linea, const char *file);
 
+// condition variables
+int xpthread_cond_init(pthread_cond_t *cond, const pthread_condattr_t *attr, int linea, const char *file);
+int xpthread_cond_destroy(pthread_cond_t *cond, int linea, const char *file);
+int xpthread_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex, int linea, const char *file);
+int xpthread_cond_broadcast(pthread_cond_t *cond, int linea, const char *file);
+
 //semaphores
 int xsem_init(sem_t *sem, int pshared, unsigned int value, int linea, const char *file);
 int xsem_post(sem_t *sem, int linea, const char *file);
@@ -54,7 +54,7 @@ sparse_sd_vector& sparse_sd_vector::operator=(const sparse_sd_vector& other)
  * argument: ostream
  * returns: number of bytes written to ostream
  */
-ulint sparse_sd_vector::serialize(std::ostream& out) 
+ulint sparse_sd_vector::serialize(std::ostream& out) const
 {
     ulint w_bytes = 0;
 
@@ -1,9 +1,15 @@
 #include "iutest.hpp"
 #include <vector>
 #include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <random>
 #include <string>
 
 #include "br_index.hpp"
+#include "work_stealing_pool.hpp"
 
 using namespace bri;
 using namespace std;
@@ -177,4 +183,788 @@ IUTEST(BrIndexInmemoryTest, ExtensionContraction)
     s = idx.right_contraction(s);
     IUTEST_EXPECT_EQ(12,s.size());
     
-}
\ No newline at end of file
+}
+
+IUTEST(BrIndexInmemoryTest, AllExtensions)
+{
+    string input("abracadabracadabra");
+    br_index idx(input,1,false);
+    auto init = idx.get_initial_sample();
+
+    vector<br_sample> samples{init, idx.search("a"), idx.search("ab"), idx.search("abra"), idx.search("cad")};
+    for (auto const& s : samples)
+    {
+        auto rexts = idx.right_extensions(s);
+        ulint found = 0;
+        for (uchar c : string("abcdr"))
+        {
+            auto exp = idx.right_extension(s,c);
+            if (exp.is_invalid()) continue;
+            IUTEST_ASSERT(found < rexts.size());
+            IUTEST_ASSERT_EQ(c, rexts[found].first);
+            auto const& got = rexts[found].second;
+            IUTEST_ASSERT(exp.range == got.range);
+            IUTEST_ASSERT(exp.rangeR == got.rangeR);
+            IUTEST_ASSERT_EQ(exp.len, got.len);
+            vector<ulint> loc_exp(idx.locate_sample(exp));
+            vector<ulint> loc(idx.locate_sample(got));
+            IUTEST_ASSERT(equal_set<>(loc_exp,loc));
+            found++;
+        }
+        IUTEST_ASSERT_EQ(found, rexts.size());
+
+        auto lexts = idx.left_extensions(s);
+        found = 0;
+        for (uchar c : string("abcdr"))
+        {
+            auto exp = idx.left_extension(s,c);
+            if (exp.is_invalid()) continue;
+            IUTEST_ASSERT(found < lexts.size());
+            IUTEST_ASSERT_EQ(c, lexts[found].first);
+            auto const& got = lexts[found].second;
+            IUTEST_ASSERT(exp.range == got.range);
+            IUTEST_ASSERT(exp.rangeR == got.rangeR);
+            IUTEST_ASSERT_EQ(exp.len, got.len);
+            vector<ulint> loc_exp(idx.locate_sample(exp));
+            vector<ulint> loc(idx.locate_sample(got));
+            IUTEST_ASSERT(equal_set<>(loc_exp,loc));
+            found++;
+        }
+        IUTEST_ASSERT_EQ(found, lexts.size());
+    }
+
+    // children of the root: one per distinct character
+    IUTEST_ASSERT_EQ(5, idx.children(init).size());
+    IUTEST_ASSERT_EQ('a', idx.child_chars(init)[0]);
+}
+
+IUTEST(BrIndexInmemoryTest, MoveStructureLocate)
+{
+    string input("abracadabracadabrabbbbbbbbbbcaaaaaaaa");
+    br_index idx(input,1,false);
+    br_index idx_move(input,1,false);
+    idx_move.use_move_structures(true);
+    IUTEST_ASSERT(!idx.has_move_structures());
+    IUTEST_ASSERT(idx_move.has_move_structures());
+
+    // round trip through serialization
+    stringstream ss;
+    idx_move.serialize(ss);
+    br_index loaded;
+    loaded.load(ss);
+    IUTEST_ASSERT(loaded.has_move_structures());
+
+    for (ulint i = 0; i < input.size(); ++i)
+    {
+        for (ulint m = 1; i + m <= input.size() && m <= 6; ++m)
+        {
+            string p = input.substr(i,m);
+            vector<ulint> exp(idx.locate(p));
+            vector<ulint> got(idx_move.locate(p));
+            vector<ulint> got_loaded(loaded.locate(p));
+            IUTEST_ASSERT(equal_set<>(exp,got));
+            IUTEST_ASSERT(equal_set<>(exp,got_loaded));
+
+            // left_contraction beyond bl walks Phi/PhiI
+            auto s = idx.search(p), s_move = idx_move.search(p);
+            while (s.len > 0)
+            {
+                s = idx.left_contraction(s);
+                s_move = idx_move.left_contraction(s_move);
+                IUTEST_ASSERT(s.range == s_move.range);
+                IUTEST_ASSERT(s.rangeR == s_move.rangeR);
+            }
+        }
+    }
+
+    idx_move.use_move_structures(false);
+    IUTEST_ASSERT(!idx_move.has_move_structures());
+}
+
+IUTEST(BrIndexInmemoryTest, LocateCursor)
+{
+    string input("abracadabracadabrabbbbbbbbbbcaaaaaaaa");
+    br_index idx(input,1,false);
+
+    for (bool move : {false, true})
+    {
+        idx.use_move_structures(move);
+        for (string p : {"a", "ab", "abra", "b", "bb", "c", "ca", "aaaa", "x"})
+        {
+            auto sample = idx.search(p);
+            vector<ulint> exp(idx.locate(p));
+
+            // same order as locate_sample
+            vector<ulint> all;
+            auto cursor = idx.get_locate_cursor(sample);
+            ulint occ;
+            while (cursor.next(occ)) all.push_back(occ);
+            IUTEST_ASSERT(cursor.done());
+            IUTEST_ASSERT_EQ(exp.size(), cursor.reported());
+            IUTEST_ASSERT(exp == all);
+
+            // resumption in chunks of 2
+            vector<ulint> chunked;
+            cursor = idx.get_locate_cursor(sample);
+            while (cursor.next(chunked,2) == 2);
+            IUTEST_ASSERT(exp == chunked);
+
+            // early termination after 3 occurrences
+            vector<ulint> first;
+            ulint visited = idx.locate(p, [&first](ulint o) { first.push_back(o); return first.size() < 3; });
+            IUTEST_ASSERT_EQ(std::min<ulint>(3,exp.size()), visited);
+            IUTEST_ASSERT(vector<ulint>(exp.begin(),exp.begin()+visited) == first);
+        }
+    }
+}
+
+IUTEST(BrIndexInmemoryTest, SearchToehold)
+{
+    // count & locate skip the SA range and toehold updates of right_extension
+    string input("abracadabracadabrabbbbbbbbbbcaaaaaaaaabracadabra");
+    br_index idx(input,2,false);
+
+    for (ulint i = 0; i < input.size(); ++i)
+    {
+        for (ulint m = 1; i + m <= input.size() && m <= 12; ++m)
+        {
+            string p = input.substr(i,m);
+            auto s = idx.search(p);
+
+            IUTEST_ASSERT_EQ(idx.count_sample(s), idx.count(p));
+
+            ulint sa;
+            IUTEST_ASSERT_EQ(idx.count_sample(s), idx.search_toehold(p,sa));
+            IUTEST_ASSERT_EQ(s.j - s.d, sa);
+
+            vector<ulint> exp(idx.locate_sample(s));
+            vector<ulint> res(idx.locate(p));
+            IUTEST_ASSERT(exp == res);
+        }
+    }
+
+    ulint sa;
+    IUTEST_ASSERT_EQ(0, idx.count("abx"));
+    IUTEST_ASSERT_EQ(0, idx.search_toehold("abx",sa));
+    IUTEST_ASSERT(idx.locate("abx").empty());
+}
+
+IUTEST(BrIndexInmemoryTest, FullTaskThreads)
+{
+    string input("abracadabracadabrabbbbbbbbbbcaaaaaaaaabracadabra");
+    br_index idx(input,2,false);
+
+    for (ulint k = 1; k <= 8; ++k)
+    {
+        for (ulint t = 1; t <= 3; ++t)
+        {
+            // occurrences of the distinct substrings of length <= k occurring >= t times
+            ulint exp = 0;
+            for (ulint m = 1; m <= k; ++m)
+            {
+                vector<string> subs;
+                for (ulint i = 0; i + m <= input.size(); ++i) subs.push_back(input.substr(i,m));
+                sort(subs.begin(),subs.end());
+                for (ulint i = 0, j; i < subs.size(); i = j)
+                {
+                    for (j = i; j < subs.size() && subs[j] == subs[i]; ++j);
+                    if (j - i >= t) exp += j - i;
+                }
+            }
+
+            IUTEST_ASSERT_EQ(exp, idx.full_task(k,t));
+            for (ulint threads : {2, 4, 8})
+                IUTEST_ASSERT_EQ(exp, idx.full_task(k,t,threads));
+        }
+    }
+}
+
+IUTEST(BrIndexInmemoryTest, MaximalExactMatches)
+{
+    string input("abracadabracadabrabbbbbbbbbbcaaaaaaaaabracadabra");
+    br_index idx(input,2,false);
+
+    auto occs = [&input](string const& s) {
+        ulint cnt = 0;
+        for (ulint i = 0; i + s.size() <= input.size(); ++i)
+            if (input.compare(i,s.size(),s) == 0) cnt++;
+        return cnt;
+    };
+
+    mt19937 gen(15);
+    for (ulint iter = 0; iter < 100; ++iter)
+    {
+        string p;
+        ulint m = 1 + gen() % 40;
+        for (ulint i = 0; i < m; ++i) p += "abcdr"[gen() % 5];
+
+        for (ulint t = 1; t <= 3; ++t)
+        {
+            for (ulint min_len = 1; min_len <= 4; min_len += 3)
+            {
+                // longest match with >= t occurrences at each offset, left-maximal ones of length >= min_len
+                vector<pair<ulint,ulint> > exp;
+                ulint prev_end = 0;
+                for (ulint i = 0; i < m; ++i)
+                {
+                    ulint l = 0;
+                    while (i + l < m && occs(p.substr(i,l+1)) >= t) l++;
+                    if (l > 0 && (i == 0 || prev_end < i + l) && l >= min_len) exp.push_back({i,l});
+                    prev_end = i + l;
+                }
+
+                vector<pair<ulint,ulint> > res;
+                ulint reported = idx.maximal_exact_matches(p, min_len, t, [&](ulint offset, br_sample const& sample) {
+                    IUTEST_ASSERT_EQ(occs(p.substr(offset,sample.len)), idx.count_sample(sample));
+                    vector<ulint> loc(idx.locate_sample(sample));
+                    for (auto o : loc) IUTEST_ASSERT_EQ(0, input.compare(o,sample.len,p,offset,sample.len));
+                    res.push_back({offset,sample.len});
+                });
+
+                IUTEST_ASSERT_EQ(res.size(), reported);
+                IUTEST_ASSERT(exp == res);
+            }
+        }
+
+        ulint max_l = 0;
+        idx.maximal_exact_matches(p, 1, 1, [&](ulint, br_sample const& sample) { max_l = max(max_l, sample.len); });
+        IUTEST_ASSERT_EQ(max_l, idx.maximal_exact_match(p));
+    }
+}
+
+IUTEST(BrIndexInmemoryTest, MatchingStatistics)
+{
+    string input("abracadabracadabrabbbbbbbbbbcaaaaaaaaabracadabra");
+    br_index idx(input,2,false);
+    idx.use_ms_thresholds(true);
+    IUTEST_ASSERT(idx.has_ms_thresholds());
+    IUTEST_ASSERT(idx.has_lcp_psv());
+
+    // the same with blocks of 2 LCP positions, past which the walks stop
+    br_index idx2(input,2,false);
+    idx2.use_ms_thresholds(true);
+    idx2.use_lcp_psv(true,2);
+
+    mt19937 gen(16);
+    for (ulint iter = 0; iter < 200; ++iter)
+    {
+        string p;
+        ulint m = 1 + gen() % 40;
+        for (ulint i = 0; i < m; ++i) p += "abcdrx"[gen() % 6];
+
+        for (br_index const* index : {&idx, &idx2})
+        {
+            vector<ulint> lengths, pointers;
+            index->matching_statistics(p, lengths, pointers);
+            IUTEST_ASSERT_EQ(m, lengths.size());
+
+            for (ulint i = 0; i < m; ++i)
+            {
+                ulint l = 0;
+                while (i + l < m && input.find(p.substr(i,l+1)) != string::npos) l++;
+                IUTEST_ASSERT_EQ(l, lengths[i]);
+                if (l > 0) IUTEST_ASSERT_EQ(0, input.compare(pointers[i],l,p,i,l));
+            }
+        }
+    }
+
+    stringstream ss;
+    idx.serialize(ss);
+    br_index loaded;
+    loaded.load(ss);
+    IUTEST_ASSERT(loaded.has_ms_thresholds());
+
+    vector<ulint> lengths, pointers, lengths2, pointers2;
+    idx.matching_statistics("xabracadabrx", lengths, pointers);
+    loaded.matching_statistics("xabracadabrx", lengths2, pointers2);
+    IUTEST_ASSERT(lengths == lengths2);
+    IUTEST_ASSERT(pointers == pointers2);
+}
+
+IUTEST(BrIndexInmemoryTest, SlidingWindow)
+{
+    string input("abracadabracadabrabbbbbbbbbbcaaaaaaaaabracadabra");
+    br_index idx(input,2,false);
+
+    mt19937 gen(17);
+    for (ulint iter = 0; iter < 100; ++iter)
+    {
+        // pieces of the text with random characters in between
+        string q;
+        while (q.size() < 60)
+        {
+            ulint i = gen() % input.size();
+            q += input.substr(i, gen() % 12);
+            q += "abcdrx"[gen() % 6];
+        }
+
+        for (ulint k : {1, 2, 3, 5, 8, 13})
+        {
+            ulint next = 0, found = 0;
+            ulint res = idx.sliding_window(q, k, [&](ulint i, ulint cnt, br_sample const& sample) {
+                IUTEST_ASSERT_EQ(next, i);
+                next++;
+                IUTEST_ASSERT_EQ(idx.count(q.substr(i,k)), cnt);
+                if (cnt == 0) return;
+                found++;
+                vector<ulint> exp(idx.locate(q.substr(i,k)));
+                vector<ulint> loc;
+                auto cursor = idx.get_locate_cursor(sample);
+                cursor.next(loc, cnt);
+                IUTEST_ASSERT(equal_set(exp, loc));
+            });
+            IUTEST_ASSERT_EQ(q.size() - k + 1, next);
+            IUTEST_ASSERT_EQ(found, res);
+        }
+    }
+
+    IUTEST_ASSERT_EQ(0, idx.sliding_window("abra", 5, [](ulint, ulint, br_sample const&) {}));
+}
+
+IUTEST(BrIndexInmemoryTest, LocateSaOrder)
+{
+    // long SA ranges over many runs
+    mt19937 gen(18);
+    string input;
+    for (ulint i = 0; i < 20000; ++i) input += "aab"[gen() % 3];
+    br_index idx(input,4,false);
+
+    br_index idx_move(input,4,false);
+    idx_move.use_move_structures(true);
+
+    for (string p : {"a", "b", "ab", "ba", "aab", "bbab", "abaabba", "aaaaaaaaaaaaaaaaaaaaaaaa"})
+    {
+        vector<ulint> exp(idx.locate(p));
+        sort(exp.begin(), exp.end(), [&input](ulint a, ulint b) {
+            return input.compare(a, string::npos, input, b, string::npos) < 0;
+        });
+
+        for (ulint threads : {1, 3})
+        {
+            IUTEST_ASSERT(exp == idx.locate_sa_order(p, threads));
+            IUTEST_ASSERT(exp == idx_move.locate_sa_order(p, threads));
+        }
+    }
+
+    IUTEST_ASSERT(idx.locate_sa_order("c").empty());
+}
+
+IUTEST(BrIndexInmemoryTest, CountLocateBatch)
+{
+    mt19937 gen(19);
+    string input;
+    for (ulint i = 0; i < 20000; ++i) input += "aabc"[gen() % 4];
+    br_index idx(input,4,false);
+
+    vector<string> patterns = {"a", "d", "ab", "cad", "abcabcabcabcabc"};
+    for (ulint i = 0; i < 300; ++i)
+    {
+        ulint m = 1 + gen() % 12;
+        ulint pos = gen() % (input.size() - m);
+        patterns.push_back(input.substr(pos, m));
+        if (i % 5 == 0) patterns.back()[m / 2] = 'd';
+    }
+
+    br_index idx_move(input,4,false);
+    idx_move.use_move_structures(true);
+    br_index idx_qgram(input,4,false);
+    idx_qgram.use_qgram_table(3);
+
+    for (br_index const* x : {&idx, &idx_move, &idx_qgram})
+    {
+        for (ulint group : {1, 7, 64})
+        {
+            auto counts = x->count_batch(patterns, group);
+            auto locations = x->locate_batch(patterns, group);
+            IUTEST_ASSERT_EQ(patterns.size(), counts.size());
+            IUTEST_ASSERT_EQ(patterns.size(), locations.size());
+            for (ulint i = 0; i < patterns.size(); ++i)
+            {
+                IUTEST_ASSERT_EQ(idx.count(patterns[i]), counts[i]);
+                IUTEST_ASSERT(x->locate(patterns[i]) == locations[i]);
+            }
+        }
+    }
+
+    IUTEST_ASSERT(idx.count_batch({}).empty());
+}
+
+IUTEST(BrIndexInmemoryTest, QgramTable)
+{
+    string input("abracadabracadabrabbbbbbbbbbcaaaaaaaaabracadabra");
+    br_index idx(input,2,false);
+
+    stringstream ss;
+    idx.serialize(ss);
+    br_index tab;
+    tab.load(ss);
+    tab.use_qgram_table(3);
+    IUTEST_ASSERT_EQ(3, tab.qgram_length());
+
+    vector<string> patterns = {"a", "ab", "abx", "xab", "zzzz", "abrx", "bbbbbbbbbbbbbbbbbbbbbb"};
+    for (ulint i = 0; i < input.size(); ++i)
+        for (ulint m = 1; i + m <= input.size() && m <= 8; ++m)
+            patterns.push_back(input.substr(i,m));
+
+    for (string const& p : patterns)
+    {
+        auto exp = idx.search(p);
+        auto s = tab.search(p);
+        IUTEST_ASSERT_EQ(exp.is_invalid(), s.is_invalid());
+        if (!exp.is_invalid())
+        {
+            IUTEST_ASSERT(exp.range == s.range);
+            IUTEST_ASSERT(exp.rangeR == s.rangeR);
+            IUTEST_ASSERT_EQ(exp.j, s.j);
+            IUTEST_ASSERT_EQ(exp.d, s.d);
+            IUTEST_ASSERT_EQ(exp.len, s.len);
+        }
+
+        IUTEST_ASSERT_EQ(idx.count(p), tab.count(p));
+        vector<ulint> l1(idx.locate(p)), l2(tab.locate(p));
+        IUTEST_ASSERT(l1 == l2);
+    }
+
+    // stored in the index file and read by the count profile
+    stringstream ss2;
+    tab.serialize(ss2);
+    br_index counter;
+    counter.load(ss2, br_index::LOAD_COUNT);
+    IUTEST_ASSERT_EQ(3, counter.qgram_length());
+    IUTEST_ASSERT_EQ(idx.count("abra"), counter.count("abra"));
+    IUTEST_ASSERT_EQ(0, counter.count("abx"));
+
+    tab.use_qgram_table(0);
+    IUTEST_ASSERT_EQ(0, tab.qgram_length());
+    IUTEST_ASSERT_EQ(idx.count("abra"), tab.count("abra"));
+}
+
+// a stream that cannot seek, as a pipe
+struct unseekable_buf : std::streambuf
+{
+    unseekable_buf(string& data) { setg(&data[0], &data[0], &data[0] + data.size()); }
+};
+
+IUTEST(BrIndexInmemoryTest, LoadUnseekable)
+{
+    string input("abracadabracadabrabbbbbbbbbbcaaaaaaaaabracadabra");
+    br_index idx(input,2,false);
+    idx.use_qgram_table(3);
+
+    // the optional sections are read and the stream is left after the index
+    stringstream ss;
+    idx.serialize(ss);
+    ss << 'x';
+    string data = ss.str();
+    unseekable_buf buf(data);
+    istream in(&buf);
+
+    br_index loaded;
+    loaded.load(in);
+    IUTEST_ASSERT_EQ(3, loaded.qgram_length());
+    IUTEST_ASSERT_EQ('x', in.get());
+    IUTEST_ASSERT_EQ(idx.count("abra"), loaded.count("abra"));
+    vector<ulint> l1(idx.locate("abra")), l2(loaded.locate("abra"));
+    IUTEST_ASSERT(l1 == l2);
+}
+
+IUTEST(BrIndexInmemoryTest, ContractionBeyondBl)
+{
+    // bl=1: every contraction from length >= 2 walks Phi/PhiI (PhiR/PhiIR) chains with PLCP samples
+    string input("abracadabracadabrabbbbbbbbbbcaaaaaaaaabracadabra");
+    br_index idx(input,1,false);
+
+    for (bool move : {false, true})
+    {
+        idx.use_move_structures(move);
+        for (ulint i = 0; i < input.size(); ++i)
+        {
+            for (ulint m = 2; i + m <= input.size() && m <= 8; ++m)
+            {
+                string p = input.substr(i,m);
+                auto s = idx.search(p);
+
+                auto l = idx.left_contraction(s);
+                auto exp_l = idx.search(p.substr(1));
+                IUTEST_ASSERT(exp_l.range == l.range);
+                IUTEST_ASSERT(exp_l.rangeR == l.rangeR);
+
+                auto r = idx.right_contraction(s);
+                auto exp_r = idx.search(p.substr(0,m-1));
+                IUTEST_ASSERT(exp_r.range == r.range);
+                IUTEST_ASSERT(exp_r.rangeR == r.rangeR);
+            }
+        }
+    }
+}
+
+IUTEST(BrIndexInmemoryTest, ContractionLcpPsv)
+{
+    // bl=1 & small blocks: widening crosses many blocks of the smaller value samples
+    string input;
+    std::mt19937 engine(3);
+    for (int i = 0; i < 40; ++i)
+    {
+        input += "abracadabra";
+        input += "abc"[engine() % 3];
+    }
+    br_index idx(input,1,false);
+
+    for (bool move : {false, true})
+    {
+        idx.use_move_structures(move);
+        for (ulint block : {1, 2, 5, 16, 0})
+        {
+            idx.use_lcp_psv(false);
+            idx.use_lcp_psv(true, block);
+            IUTEST_ASSERT(idx.has_lcp_psv());
+
+            for (ulint i = 0; i + 12 <= input.size(); i += 7)
+            {
+                for (ulint m = 2; m <= 12; ++m)
+                {
+                    string p = input.substr(i,m);
+                    auto s = idx.search(p);
+
+                    auto l = idx.left_contraction(s);
+                    auto exp_l = idx.search(p.substr(1));
+                    IUTEST_ASSERT(exp_l.range == l.range);
+                    IUTEST_ASSERT(exp_l.rangeR == l.rangeR);
+
+                    auto r = idx.right_contraction(s);
+                    auto exp_r = idx.search(p.substr(0,m-1));
+                    IUTEST_ASSERT(exp_r.range == r.range);
+                    IUTEST_ASSERT(exp_r.rangeR == r.rangeR);
+                }
+            }
+        }
+    }
+
+    // stored in the index file
+    stringstream ss;
+    idx.serialize(ss);
+    br_index loaded;
+    loaded.load(ss);
+    IUTEST_ASSERT(loaded.has_lcp_psv());
+    string p = input.substr(5,10);
+    auto s = loaded.search(p);
+    IUTEST_ASSERT(loaded.left_contraction(s).range == loaded.search(p.substr(1)).range);
+    IUTEST_ASSERT(loaded.maximal_exact_match("abracadabxacadabraabcx") == idx.maximal_exact_match("abracadabxacadabraabcx"));
+}
+
+IUTEST(BrIndexInmemoryTest, SuffixTreeEdgeJumping)
+{
+    // with psv, parent/child/lca/nsibling jump over edges: same nodes as step by step
+    string input;
+    std::mt19937 engine(5);
+    for (int i = 0; i < 30; ++i)
+    {
+        input += "abracadabra";
+        input += "abc"[engine() % 3];
+    }
+    br_index idx(input,2,false);
+
+    stringstream ss;
+    idx.serialize(ss);
+    br_index jmp;
+    jmp.load(ss);
+
+    auto same = [](br_sample const& a, br_sample const& b) {
+        if (a.is_invalid() || b.is_invalid()) return a.is_invalid() == b.is_invalid();
+        return a.range == b.range && a.rangeR == b.rangeR && a.len == b.len
+            && a.j - a.d == b.j - b.d;
+    };
+
+    for (ulint block : {1, 3, 0})
+    {
+        jmp.use_lcp_psv(true,block);
+        for (ulint i = 0; i < input.size(); i += 5)
+        {
+            // a leaf, then its ancestors up to the root
+            br_sample v = idx.get_initial_sample();
+            for (ulint k = i; k < input.size() && !v.is_leaf(); ++k) v = idx.right_extension(v,input[k]);
+            br_sample w = idx.search(input.substr((i*7) % input.size(), 3));
+
+            while (v.len > 0)
+            {
+                auto par = idx.parent(v);
+                IUTEST_ASSERT(same(par, jmp.parent(v)));
+                IUTEST_ASSERT(same(idx.nsibling(v), jmp.nsibling(v)));
+                IUTEST_ASSERT(same(idx.fchild(v), jmp.fchild(v)));
+                IUTEST_ASSERT(same(idx.lca(v,w), jmp.lca(v,w)));
+                IUTEST_ASSERT(par.contains(v));
+
+                for (uchar c : idx.child_chars(par))
+                    IUTEST_ASSERT(same(idx.child(par,c), jmp.child(par,c)));
+                v = par;
+            }
+        }
+    }
+}
+
+IUTEST(BrIndexInmemoryTest, ConcurrentReaders)
+{
+    string input("abracadabracadabrabbbbbbbbbbcaaaaaaaaabracadabra");
+    br_index idx(input,2,false);
+
+    vector<string> patterns;
+    for (ulint i = 0; i + 4 <= input.size(); ++i) patterns.push_back(input.substr(i,1+i%4));
+
+    vector<ulint> exp_cnt, exp_mem;
+    vector<vector<ulint> > exp_loc;
+    for (auto const& p : patterns)
+    {
+        exp_cnt.push_back(idx.count(p));
+        exp_loc.push_back(idx.locate(p));
+        exp_mem.push_back(idx.maximal_exact_match(p + "x" + p));
+    }
+
+    vector<ulint> tasks;
+    for (ulint round = 0; round < 20; ++round)
+        for (ulint i = 0; i < patterns.size(); ++i) tasks.push_back(i);
+
+    std::atomic<ulint> mismatches(0);
+    work_stealing_pool<ulint> pool(8);
+    pool.run(tasks, [&](ulint i, ulint worker) {
+        if (idx.count(patterns[i]) != exp_cnt[i]) mismatches++;
+        if (idx.locate(patterns[i]) != exp_loc[i]) mismatches++;
+        if (idx.maximal_exact_match(patterns[i] + "x" + patterns[i]) != exp_mem[i]) mismatches++;
+    });
+    IUTEST_ASSERT_EQ(0, mismatches.load());
+}
+
+// extension, contraction and locate results along one pattern, through the const interface
+static vector<ulint> query_trace(br_index const& idx, string const& p)
+{
+    vector<ulint> res;
+    auto record = [&](br_sample const& s) {
+        res.push_back(idx.count_sample(s));
+        if (s.len == 0) return; // locate needs a non-empty pattern
+        auto occs = idx.locate_sample(s);
+        sort(occs.begin(),occs.end());
+        res.insert(res.end(),occs.begin(),occs.end());
+    };
+
+    br_sample sample(idx.get_initial_sample());
+    for (ulint i = p.size(); i-- > 0 && !sample.is_invalid();)
+    {
+        sample = idx.left_extension(sample,p[i]);
+        if (!sample.is_invalid()) record(sample);
+    }
+    while (!sample.is_invalid() && sample.len > 0)
+    {
+        sample = idx.left_contraction(sample);
+        record(sample);
+    }
+
+    sample = idx.get_initial_sample();
+    for (ulint i = 0; i < p.size() && !sample.is_invalid(); ++i)
+    {
+        sample = idx.right_extension(sample,p[i]);
+        if (!sample.is_invalid()) record(sample);
+    }
+    while (!sample.is_invalid() && sample.len > 0)
+    {
+        sample = idx.right_contraction(sample);
+        record(sample);
+    }
+
+    res.push_back(idx.count(p));
+    auto cursor = idx.get_locate_cursor(idx.search(p));
+    ulint occ;
+    while (cursor.next(occ)) res.push_back(occ);
+    return res;
+}
+
+IUTEST(BrIndexInmemoryTest, ConstQueryStress)
+{
+    string input("abracadabracadabrabbbbbbbbbbcaaaaaaaaabracadabra");
+    std::mt19937 engine(7);
+    for (ulint i = 0; i < 400; ++i) input.push_back("abcr"[engine()%4]);
+
+    for (bool move : {false, true})
+    {
+        br_index idx(input,3,false);
+        idx.use_move_structures(move);
+        br_index const& cidx = idx;
+
+        vector<string> patterns;
+        for (ulint i = 0; i + 8 <= input.size(); i += 3) patterns.push_back(input.substr(i,2+i%7));
+
+        vector<vector<ulint> > expected;
+        for (auto const& p : patterns) expected.push_back(query_trace(cidx,p));
+
+        vector<ulint> tasks;
+        for (ulint round = 0; round < 10; ++round)
+            for (ulint i = 0; i < patterns.size(); ++i) tasks.push_back(i);
+
+        std::atomic<ulint> mismatches(0);
+        work_stealing_pool<ulint> pool(8);
+        pool.run(tasks, [&](ulint i, ulint worker) {
+            if (query_trace(cidx,patterns[i]) != expected[i]) mismatches++;
+        });
+        IUTEST_ASSERT_EQ(0, mismatches.load());
+    }
+}
+
+IUTEST(BrIndexInmemoryTest, LoadProfiles)
+{
+    string input("abracadabracadabrabbbbbbbbbbcaaaaaaaaabracadabra");
+    std::mt19937 engine(11);
+    for (ulint i = 0; i < 300; ++i) input.push_back("abcr"[engine()%4]);
+
+    br_index idx(input,4,false);
+    idx.use_move_structures(true);
+    idx.save_to_file("test-tmp/br_index_profile");
+
+    // the same index without its section table, as written by older versions
+    string data;
+    {
+        ifstream in("test-tmp/br_index_profile.bri");
+        data.assign((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        ulint table_offset;
+        std::memcpy(&table_offset, data.data() + data.size() - 2*sizeof(ulint), sizeof(ulint));
+        ofstream out("test-tmp/br_index_profile_old.bri");
+        out.write(data.data(), table_offset);
+    }
+
+    vector<string> patterns;
+    for (ulint i = 0; i + 6 <= input.size(); i += 5) patterns.push_back(input.substr(i,1+i%6));
+    patterns.push_back("abcabcabcabc");
+
+    for (string file : {"test-tmp/br_index_profile.bri", "test-tmp/br_index_profile_old.bri"})
+    {
+        for (auto profile : {br_index::LOAD_COUNT, br_index::LOAD_LOCATE, br_index::LOAD_BIDIRECTIONAL, br_index::LOAD_FULL})
+        {
+            br_index idx2;
+            ifstream in(file);
+            idx2.load(in,profile);
+
+            br_index idx3;
+            ifstream in3(file);
+            idx3.load(in3,profile,2);
+            IUTEST_ASSERT_EQ(2, idx3.border_length());
+
+            for (auto const& p : patterns)
+            {
+                IUTEST_ASSERT_EQ(idx.count(p), idx2.count(p));
+                IUTEST_ASSERT_EQ(idx.count(p), idx3.count(p));
+                if (profile == br_index::LOAD_COUNT) continue;
+
+                IUTEST_ASSERT_EQ(idx.locate(p), idx2.locate(p));
+                IUTEST_ASSERT_EQ(idx.locate(p), idx3.locate(p));
+                if (profile == br_index::LOAD_LOCATE) continue;
+
+                br_sample s(idx2.get_initial_sample());
+                for (ulint i = p.size(); i-- > 0 && !s.is_invalid();) s = idx2.left_extension(s,p[i]);
+                IUTEST_ASSERT_EQ(idx.count(p), s.is_invalid() ? 0 : idx2.count_sample(s));
+                if (profile == br_index::LOAD_BIDIRECTIONAL) continue;
+
+                IUTEST_ASSERT_EQ(idx.maximal_exact_match(p+p), idx2.maximal_exact_match(p+p));
+                IUTEST_ASSERT_EQ(idx.maximal_exact_match(p+p), idx3.maximal_exact_match(p+p));
+            }
+
+            if (profile != br_index::LOAD_FULL) IUTEST_ASSERT_LT(idx2.get_space(), idx.get_space());
+        }
+    }
+}
@@ -113,7 +113,7 @@ map<ulint,ulint> kr_freqs(string const& text, ulint max_len)
     return hash_table;
 }
 
-bool verify(string const& text, br_index& idx, br_sample const& sample, string const& pattern, 
+bool verify(string const& text, br_index const& idx, br_sample const& sample, string const& pattern, 
     map<ulint, ulint>& freqs, 
     ulint frag_num, ulint step, string const& opname)
 {
@@ -0,0 +1,98 @@
+#include "iutest.hpp"
+#include <vector>
+#include <sstream>
+#include <random>
+#include <algorithm>
+
+#include "move_structure.hpp"
+
+using namespace bri;
+
+// piecewise linear permutation: [0,n) cut into blocks, blocks shuffled
+std::vector<range_t> random_intervals(ulint n, ulint blocks, ulint seed, std::vector<ulint>& perm)
+{
+    std::mt19937 engine(seed);
+    std::vector<ulint> cuts{0};
+    std::uniform_int_distribution<ulint> dist(1,n-1);
+    while (cuts.size() < blocks) cuts.push_back(dist(engine));
+    std::sort(cuts.begin(),cuts.end());
+    cuts.erase(std::unique(cuts.begin(),cuts.end()),cuts.end());
+    cuts.push_back(n);
+
+    std::vector<ulint> order(cuts.size()-1);
+    for (ulint i = 0; i < order.size(); ++i) order[i] = i;
+    std::shuffle(order.begin(),order.end(),engine);
+
+    // block order[0] goes first in the image, then order[1], ...
+    std::vector<range_t> intervals(order.size());
+    ulint img = 0;
+    for (auto b : order)
+    {
+        intervals[b] = range_t(cuts[b],img);
+        img += cuts[b+1] - cuts[b];
+    }
+
+    perm = std::vector<ulint>(n);
+    for (ulint b = 0; b < intervals.size(); ++b)
+        for (ulint i = cuts[b]; i < cuts[b+1]; ++i)
+            perm[i] = intervals[b].second + (i - cuts[b]);
+
+    return intervals;
+}
+
+IUTEST(MoveStructureTest, RandomPermutation)
+{
+    for (ulint seed = 0; seed < 10; ++seed)
+    {
+        std::vector<ulint> perm;
+        auto intervals = random_intervals(1000, 40, seed, perm);
+        move_structure ms(1000, intervals, 2);
+
+        IUTEST_ASSERT_EQ(1000,ms.size());
+        IUTEST_ASSERT_LE(intervals.size(),ms.number_of_intervals());
+
+        for (ulint i = 0; i < 1000; ++i)
+            IUTEST_ASSERT_EQ(perm[i],ms[i]);
+
+        // follow the cycle of 0 with interval indices carried over
+        ulint i = 0, t = ms.interval_of(0);
+        for (ulint k = 0; k < 1000; ++k)
+        {
+            ulint next = perm[i];
+            ms.move(i,t);
+            IUTEST_ASSERT_EQ(next,i);
+            IUTEST_ASSERT_EQ(ms.interval_of(i),t);
+        }
+    }
+}
+
+IUTEST(MoveStructureTest, WrappingImage)
+{
+    // f(i) = (i + 7) % 10 as a single interval
+    std::vector<range_t> intervals{range_t(0,7)};
+    move_structure ms(10, intervals);
+
+    for (ulint i = 0; i < 10; ++i)
+        IUTEST_ASSERT_EQ((i+7)%10,ms[i]);
+}
+
+IUTEST(MoveStructureTest, SerializeLoad)
+{
+    std::vector<ulint> perm;
+    auto intervals = random_intervals(500, 30, 42, perm);
+    move_structure ms(500, intervals);
+
+    std::stringstream ss;
+    ms.serialize(ss);
+
+    move_structure loaded;
+    loaded.load(ss);
+    IUTEST_ASSERT_EQ(ms.number_of_intervals(),loaded.number_of_intervals());
+    for (ulint i = 0; i < 500; ++i)
+        IUTEST_ASSERT_EQ(perm[i],loaded[i]);
+
+    // exhausted stream gives an empty structure
+    move_structure empty;
+    empty.load(ss);
+    IUTEST_ASSERT_EQ(0,empty.size());
+}
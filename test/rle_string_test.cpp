@@ -2,6 +2,7 @@
 #include <vector>
 #include <fstream>
 #include <string>
+#include <sstream>
 
 #include "rle_string.hpp"
 
@@ -266,4 +267,104 @@ IUTEST(RleStringTest, TwoCharTextOperations)
 
     }
 
-}
\ No newline at end of file
+}
+
+IUTEST(RleStringTest, CountSmaller)
+{
+    std::string s;
+    // runs of varying length over 'a'..'e'
+    for (ulint i = 0; i < 300; ++i)
+    {
+        for (ulint j = 0; j < i % 7 + 1; ++j)
+            s.push_back('a' + (i * 3) % 5);
+    }
+    rle_string<> rl(s);
+
+    for (ulint i = 0; i < s.size(); i += 13)
+    {
+        for (ulint j = i; j < s.size(); j += 17)
+        {
+            for (uchar c = 'a'; c <= 'f'; ++c)
+            {
+                ulint exp = 0;
+                for (ulint k = i; k <= j; ++k) exp += ((uchar)s[k] < c);
+                IUTEST_ASSERT_EQ(exp, rl.count_smaller({i,j},c));
+            }
+        }
+    }
+    IUTEST_ASSERT_EQ(0, rl.count_smaller({1,0},'f'));
+}
+
+IUTEST(RleStringTest, RunDirectory)
+{
+    std::string s;
+    // runs of varying length over 'a'..'e'
+    for (ulint i = 0; i < 500; ++i)
+    {
+        for (ulint j = 0; j < i % 11 + 1; ++j)
+            s.push_back('a' + (i * 3) % 5);
+    }
+    rle_string<> rl(s, 4);
+    rle_string<sparse_sd_vector, huffman_string, true> dir(s, 4);
+
+    std::stringstream ss;
+    dir.serialize(ss);
+    rle_string<sparse_sd_vector, huffman_string, true> loaded;
+    loaded.load(ss);
+
+    for (auto const* x : {&dir, &loaded})
+    {
+        IUTEST_ASSERT_EQ(rl.number_of_runs(), x->number_of_runs());
+        IUTEST_ASSERT_LT(rl.get_space(), x->get_space());
+
+        for (ulint j = 0; j < rl.number_of_runs(); ++j)
+        {
+            IUTEST_ASSERT_EQ(rl.run_at(j), x->run_at(j));
+            IUTEST_ASSERT_EQ(rl.run_start(j), x->run_start(j));
+            IUTEST_ASSERT_EQ(rl.run_end(j), x->run_end(j));
+            IUTEST_ASSERT(rl.run_range(j) == x->run_range(j));
+        }
+        for (ulint i = 0; i < s.size(); ++i)
+        {
+            IUTEST_ASSERT_EQ(rl[i], (*x)[i]);
+            IUTEST_ASSERT_EQ(rl.run_of_position(i), x->run_of_position(i));
+            IUTEST_ASSERT(rl.run_of(i) == x->run_of(i));
+            IUTEST_ASSERT(rl.run_and_offset(i) == x->run_and_offset(i));
+            for (uchar c = 'a'; c <= 'f'; ++c)
+                IUTEST_ASSERT_EQ(rl.rank(i,c), x->rank(i,c));
+            IUTEST_ASSERT_EQ(i, x->select(x->rank(i,s[i]),s[i]));
+        }
+    }
+}
+
+IUTEST(RleStringTest, LoadFromRuns)
+{
+    std::string s, heads;
+    std::vector<ulint> lengths;
+    for (ulint i = 0; i < 300; ++i)
+    {
+        char c = 'a' + (i * 7) % 4;
+        if (!heads.empty() && heads.back() == c) c = 'e';
+        heads.push_back(c);
+        lengths.push_back(i % 5 + 1);
+        s.append(lengths.back(), c);
+    }
+    for (ulint B : {1, 2, 4})
+    {
+        rle_string<> rl(s, B);
+        rle_string<> runs;
+        runs.load_from_runs(heads, lengths, B);
+
+        IUTEST_ASSERT_EQ(rl.size(), runs.size());
+        IUTEST_ASSERT_EQ(rl.number_of_runs(), runs.number_of_runs());
+        for (ulint j = 0; j < rl.number_of_runs(); ++j)
+            IUTEST_ASSERT(rl.run_range(j) == runs.run_range(j));
+        for (ulint i = 0; i < s.size(); ++i)
+        {
+            IUTEST_ASSERT_EQ(rl[i], runs[i]);
+            IUTEST_ASSERT(rl.run_and_offset(i) == runs.run_and_offset(i));
+            for (uchar c = 'a'; c <= 'e'; ++c)
+                IUTEST_ASSERT_EQ(rl.rank(i,c), runs.rank(i,c));
+        }
+    }
+}
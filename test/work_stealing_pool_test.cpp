@@ -0,0 +1,48 @@
+#include "iutest.hpp"
+#include <vector>
+#include <atomic>
+
+#include "work_stealing_pool.hpp"
+
+using namespace bri;
+
+IUTEST(WorkStealingPoolTest, InitialTasks)
+{
+    std::vector<ulint> tasks;
+    for (ulint i = 0; i < 1000; ++i) tasks.push_back(i);
+
+    std::vector<std::atomic<ulint> > executed(1000);
+    for (auto& e : executed) e = 0;
+
+    work_stealing_pool<ulint> pool(4);
+    IUTEST_ASSERT_EQ(4,pool.number_of_threads());
+    pool.run(tasks, [&executed](ulint task, ulint worker) {
+        executed[task]++;
+    });
+
+    for (ulint i = 0; i < 1000; ++i)
+        IUTEST_ASSERT_EQ(1,executed[i].load());
+}
+
+IUTEST(WorkStealingPoolTest, SpawnedTasks)
+{
+    // binary tree of depth 12 spawned from the root
+    std::atomic<ulint> visited(0);
+    std::atomic<ulint> depth_sum(0);
+
+    work_stealing_pool<range_t> pool(8);
+    pool.run(std::vector<range_t>{range_t(0,0)}, [&](range_t task, ulint worker) {
+        visited++;
+        depth_sum += task.second;
+        if (task.second < 12)
+        {
+            pool.push(worker, range_t(2*task.first, task.second+1));
+            pool.push(worker, range_t(2*task.first+1, task.second+1));
+        }
+    });
+
+    IUTEST_ASSERT_EQ((1ul<<13)-1, visited.load());
+    ulint exp = 0;
+    for (ulint d = 0; d <= 12; ++d) exp += d * (1ul << d);
+    IUTEST_ASSERT_EQ(exp, depth_sum.load());
+}